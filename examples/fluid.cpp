@@ -32,17 +32,20 @@ template <typename T>
 void bitonicMergeSort(Buffer &vec, uint_fast8_t keyOffset = 0) {
 	static ComputeShader bitonicMergeShader(YGL_RELATIVE_PATH "./shaders/fluid/bitonicMerge.comp");
 	static MutableBuffer stepsData(GL_UNIFORM_BUFFER, 10, GL_DYNAMIC_DRAW);
+	static Uniform<uint> sizeUniform("N");
+	static Uniform<uint> elementSizeUniform("elementSize");
+	static Uniform<uint> keyOffsetUniform("keyOffset");
+	static Uniform<uint> stepUniform("I");
 
 	bitonicMergeShader.bind();
 	bitonicMergeShader.setSSBO(vec.getID(), 0);
 	uint N = vec.getSize() / sizeof(T);
 
 	// dbLog(ygl::LOG_DEBUG, "Bitonic merge sort N: ", N);
-	if (bitonicMergeShader.hasUniform("N")) bitonicMergeShader.setUniform("N", N);
+	sizeUniform.set(&bitonicMergeShader, N);
 	assert(sizeof(T) % sizeof(uint) == 0 && "Data type size must be a multiple of uint size for bitonic sort");
-	if (bitonicMergeShader.hasUniform("elementSize"))
-		bitonicMergeShader.setUniform("elementSize", uint(sizeof(T) / sizeof(uint)));
-	if (bitonicMergeShader.hasUniform("keyOffset")) bitonicMergeShader.setUniform("keyOffset", uint(keyOffset));
+	elementSizeUniform.set(&bitonicMergeShader, sizeof(T) / sizeof(uint));
+	keyOffsetUniform.set(&bitonicMergeShader, keyOffset);
 
 	uint_fast32_t numPairs = nextPowerOf2(N) / 2;
 	// dbLog(ygl::LOG_DEBUG, "Bitonic merge sort numPairs: ", numPairs);
@@ -69,8 +72,7 @@ void bitonicMergeSort(Buffer &vec, uint_fast8_t keyOffset = 0) {
 	uint I = 0;
 	for (uint_fast32_t stageIndex = 0; stageIndex < numStages; ++stageIndex) {
 		for (uint_fast32_t stepIndex = 0; stepIndex < stageIndex + 1; ++stepIndex) {
-			// if(bitonicMergeShader.hasUniform("I"))
-			bitonicMergeShader.setUniform("I", I++);
+			stepUniform.set(&bitonicMergeShader, I++);
 
 			Renderer::compute(&bitonicMergeShader, numPairs, 1, 1);
 			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
@@ -131,6 +133,16 @@ class FluidSimulation {
 
 	bool drawGrid = false;
 
+	// the particles and the grid are drawn with different shaders, so each has its own handles
+	struct DrawUniforms {
+		Uniform<glm::mat4>	worldMatrix	   = Uniform<glm::mat4>("worldMatrix");
+		Uniform<uint>		materialIndex  = Uniform<uint>("material_index");
+		Uniform<int>		numParticles   = Uniform<int>("numParticles");
+		Uniform<float>		particleSize   = Uniform<float>("particleSize");
+		Uniform<float>		cellSize	   = Uniform<float>("cellSize");
+		Uniform<glm::ivec3>	gridResolution = Uniform<glm::ivec3>("gridResolution");
+	} particleUniforms, gridUniforms;
+
 	MutableBuffer spatialHashBuffer;
 	MutableBuffer spatialLookupBuffer;
 
@@ -227,14 +239,14 @@ class FluidSimulation {
 
 				renderer->bindTexturesForMaterial(materialIndex, shader);
 
-				shader->setUniformCond("worldMatrix", glm::mat4(1));
-				shader->setUniformCond("material_index", materialIndex);
-				shader->setUniformCond("numParticles", (int)numParticles);
-				shader->setUniformCond("particleSize", (float)particleSize);
+				particleUniforms.worldMatrix.set(shader, glm::mat4(1));
+				particleUniforms.materialIndex.set(shader, materialIndex);
+				particleUniforms.numParticles.set(shader, numParticles);
+				particleUniforms.particleSize.set(shader, particleSize);
 
 				mesh->bind();
 
-				if (renderer->renderMode == 6) { glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); }
+				if (renderer->renderMode == 6) { GLState::polygonMode(GL_LINE); }
 
 				mesh->draw();
 
@@ -246,30 +258,31 @@ class FluidSimulation {
 				shader->bind();
 				InstancedMesh<int> *mesh = &gridMesh;
 				renderer->bindTexturesForMaterial(materialIndex, shader);
-				shader->setUniformCond("worldMatrix", glm::mat4(1));
-				shader->setUniformCond("material_index", materialIndex);
-				shader->setUniformCond("numParticles", (int)numParticles);
-				shader->setUniformCond("particleSize", (float)particleSize);
-				shader->setUniformCond("cellSize", cellSize);
-				shader->setUniformCond("gridResolution", resolution);
+				gridUniforms.worldMatrix.set(shader, glm::mat4(1));
+				gridUniforms.materialIndex.set(shader, materialIndex);
+				gridUniforms.numParticles.set(shader, numParticles);
+				gridUniforms.particleSize.set(shader, particleSize);
+				gridUniforms.cellSize.set(shader, cellSize);
+				gridUniforms.gridResolution.set(shader, resolution);
 				copy.bindImage(17);
 				cellTypes.bindImage(18);
 				mesh->setCullFace(false);
 
-				glDepthMask(GL_FALSE);
+				GLState::depthMask(false);
 
 				mesh->bind();
-				if (renderer->renderMode == 6) { glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); }
+				if (renderer->renderMode == 6) { GLState::polygonMode(GL_LINE); }
 				mesh->draw(resolution.x * resolution.y * resolution.z);
 				mesh->unbind();
 				shader->unbind();
 
-				glDepthMask(GL_TRUE);
+				GLState::depthMask(true);
 			}
 		});
 	};
 
 	void generateSpatialHash() {
+		Profiler::Scope scope(renderer->getProfiler(), "spatial hash");
 		{
 			Bind b(spatialHashBuffer);
 			uint elem = -1;
@@ -301,6 +314,7 @@ class FluidSimulation {
 	}
 
 	void update() {
+		Profiler::Scope scope(renderer->getProfiler(), "fluid");
 		Shader::setSSBO(particleMeshFront->instanceData.getID(), 1);
 		Shader::setSSBO(spatialHashBuffer.getID(), 2);
 		Shader::setSSBO(spatialLookupBuffer.getID(), 3);
@@ -312,6 +326,7 @@ class FluidSimulation {
 		glClearTexImage(copy.getID(), 0, GL_RGBA, GL_FLOAT, nullptr);
 
 		{
+			Profiler::Scope scope(renderer->getProfiler(), "update particles");
 			ComputeShader *updateParticlesShader = asman->getShader<ComputeShader>(updateParticlesShaderIndex);
 			updateParticlesShader->bind();
 			glm::ivec2 _resolution = glm::ivec2((numParticles + 31) / 32, 32);
@@ -325,6 +340,7 @@ class FluidSimulation {
 		}
 
 		{
+			Profiler::Scope scope(renderer->getProfiler(), "repel particles");
 			ComputeShader *repelParticlesShader = asman->getShader<ComputeShader>(repelParticlesShaderIndex);
 			repelParticlesShader->bind();
 			repelParticlesShader->setUniformCond("N", numParticles);
@@ -348,6 +364,7 @@ class FluidSimulation {
 		generateSpatialHash();
 
 		{
+			Profiler::Scope scope(renderer->getProfiler(), "particles to grid");
 			ComputeShader *PGTransferShader = asman->getShader<ComputeShader>(PGTransferShaderIndex);
 			PGTransferShader->bind();
 			PGTransferShader->setUniformCond("N", numParticles);
@@ -362,6 +379,7 @@ class FluidSimulation {
 		}
 
 		{
+			Profiler::Scope scope(renderer->getProfiler(), "solve grid");
 			{
 				copyImage3dShader.bind();
 				copyImage3dShader.setUniformCond("resolution", resolution);
@@ -390,6 +408,7 @@ class FluidSimulation {
 		}
 
 		{
+			Profiler::Scope scope(renderer->getProfiler(), "grid to particles");
 			ComputeShader *GPTransferShader = asman->getShader<ComputeShader>(GPTransferShaderIndex);
 			GPTransferShader->bind();
 			GPTransferShader->setUniformCond("N", numParticles);
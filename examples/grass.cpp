@@ -112,6 +112,7 @@ void run() {
 		});
 	} catch (std::exception &e) { std::cerr << e.what() << std::endl; }
 
+	MeshFromFile::loadSceneIfNeeded("./res/models/medieval_knight/scene.gltf");
 	Animation idle(MeshFromFile::loadedScene, 0);
 
 	MeshFromFile::loadSceneIfNeeded("./res/models/medieval_knight/Falling Back Death.dae");
@@ -0,0 +1,85 @@
+#include <yoghurtgl.h>
+#include <window.h>
+#include <mesh.h>
+#include <shader.h>
+#include <renderer.h>
+#include <texture.h>
+#include <camera.h>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace ygl;
+
+// Renders a fixed number of frames without a display and saves the last one.
+// usage: headless [frames] [output.png]
+// Runs on machines with only Mesa installed, for example with LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe.
+
+int main(int argc, char **argv) {
+	int			framesCount = argc > 1 ? std::atoi(argv[1]) : 300;
+	const char *outputFile	= argc > 2 ? argv[2] : "./headless.png";
+
+	if (ygl::init(true)) {
+		dbLog(ygl::LOG_ERROR, "ygl failed to init");
+		exit(1);
+	}
+
+	{
+		Window window(800, 600, "headless", false);
+		window.setFrameCallback([](long, long, long) {});
+
+		AssetManager asman(nullptr);
+		uint		 shaderIndex =
+			asman.addShader(new VFShader("./shaders/simple.vs", "./shaders/simple.fs"), "shader");
+		Mesh		*mesh		 = new BoxMesh(2.);
+
+		PerspectiveCamera cam(glm::radians(70.f), window, 0.01, 1000);
+		cam.transform.position = glm::vec3(0, 0, 5);
+		cam.update();
+
+		Material mat =
+			Material(glm::vec3(1., 1., 0.), .2, glm::vec3(0.), 0.99, glm::vec3(0.1), 0.0, glm::vec3(1.), 0.0, 0.1, 0.);
+		GLuint matBuff = Renderer::loadMaterials(1, &mat);
+
+		Light  lights[2] = {Light(Transformation(glm::vec3(0), glm::vec3(1, -.3, 0), glm::vec3(1)),
+								  glm::vec3(1., 1., 1.), 3, Light::Type::DIRECTIONAL),
+							Light(Transformation(), glm::vec3(1., 1., 1.), 0.01, Light::Type::AMBIENT)};
+		GLuint lightBuff = Renderer::loadLights(2, lights);
+
+		Transformation boxTransform;
+		double		   minFrameTime = 1e9, maxFrameTime = 0;
+		for (int frame = 0; frame < framesCount; ++frame) {
+			// resizing goes through the same callbacks as with a visible window
+			if (frame == framesCount / 2) window.setSize(1024, 768);
+
+			window.beginFrame();
+
+			boxTransform.rotation = glm::vec3(0, window.globalTime, 0);
+			boxTransform.updateWorldMatrix();
+			Renderer::drawObject(boxTransform, asman.getShader(shaderIndex), mesh, 0);
+
+			window.swapBuffers();
+			if (frame > 0) {
+				minFrameTime = std::min(minFrameTime, window.deltaTime);
+				maxFrameTime = std::max(maxFrameTime, window.deltaTime);
+			}
+		}
+
+		dbLog(ygl::LOG_INFO, "frames: ", framesCount, " average: ", window.globalTime / framesCount * 1000,
+			  "ms min: ", minFrameTime * 1000, "ms max: ", maxFrameTime * 1000, "ms");
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+		window.getOffscreenFrameBuffer()->getColor()->save(outputFile);
+		dbLog(ygl::LOG_INFO, "saved the last frame to ", outputFile);
+#else
+		(void)outputFile;
+#endif
+
+		GLState::deleteBuffer(matBuff);
+		GLState::deleteBuffer(lightBuff);
+		delete mesh;
+	}
+
+	ygl::terminate();
+	return 0;
+}
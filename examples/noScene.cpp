@@ -77,8 +77,8 @@ void run() {
 	while (!window->shouldClose()) {
 		frame();
 	}
-	glDeleteBuffers(1, &matBuff);
-	glDeleteBuffers(1, &lightBuff);
+	GLState::deleteBuffer(matBuff);
+	GLState::deleteBuffer(lightBuff);
 
 	std::cerr << std::endl;
 	delete bunnyMesh;
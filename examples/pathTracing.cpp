@@ -70,6 +70,16 @@ ygl::TextureCubemap *skybox;
 
 ygl::AssetManager *asman;
 
+// uniforms set for every sample
+ygl::Uniform<glm::vec2>	resolutionUniform("resolution");
+ygl::Uniform<int>		imgOutputUniform("img_output");
+ygl::Uniform<float>		fovUniform("fov");
+ygl::Uniform<int>		maxBouncesUniform("max_bounces");
+ygl::Uniform<glm::mat4>	bvhMatrixUniform("bvh_matrix");
+ygl::Uniform<glm::mat4>	cameraMatrixUniform("cameraMatrix");
+ygl::Uniform<GLuint>	randomSeedUniform("random_seed");
+ygl::Uniform<int>		samplesUniform("samples");
+
 Sphere *spheres = nullptr;
 int		sphereCount;
 
@@ -355,15 +365,15 @@ int main() {
 				pathTracer->bind();
 				ygl::Transformation t = ygl::Transformation(camera->transform.position, -camera->transform.rotation,
 															camera->transform.scale);
-				pathTracer->setUniform("resolution", glm::vec2(window->getWidth(), window->getHeight()));
-				pathTracer->setUniform("img_output", 1);
-				pathTracer->setUniform("fov", camera->getFov());
-				pathTracer->setUniform("max_bounces", 12);
-				pathTracer->setUniform("fov", glm::radians(70.f));
-				pathTracer->setUniform("bvh_matrix", scene->getComponent<ygl::Transformation>(bunny).getWorldMatrix());
+				resolutionUniform.set(pathTracer, glm::vec2(window->getWidth(), window->getHeight()));
+				imgOutputUniform.set(pathTracer, 1);
+				fovUniform.set(pathTracer, camera->getFov());
+				maxBouncesUniform.set(pathTracer, 12);
+				fovUniform.set(pathTracer, glm::radians(70.f));
+				bvhMatrixUniform.set(pathTracer, scene->getComponent<ygl::Transformation>(bunny).getWorldMatrix());
 
-				pathTracer->setUniform("cameraMatrix", t.getWorldMatrix());
-				pathTracer->setUniform("random_seed", (GLuint)rand());
+				cameraMatrixUniform.set(pathTracer, t.getWorldMatrix());
+				randomSeedUniform.set(pathTracer, rand());
 
 				// pathTracer->unbind();
 
@@ -371,7 +381,7 @@ int main() {
 
 				sampleCount++;
 				normalizer->bind();
-				normalizer->setUniform("samples", sampleCount);
+				samplesUniform.set(normalizer, sampleCount);
 				// normalizer->unbind();
 
 				ygl::Renderer::compute(normalizer, window->getWidth(), window->getHeight(), 1);
@@ -3,6 +3,8 @@
 #include <vector>
 
 #include <yoghurtgl.h>
+#include <gl_state.h>
+#include <buffer.h>
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
@@ -68,6 +70,13 @@ class Bone {
 	tranformations*/
 	void Update(float animationTime);
 
+	/*interpolates the keys like Update, but does not change the bone, so one animation
+	can be sampled by any number of animators*/
+	void Sample(float animationTime, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale) const;
+
+	/*builds translation * rotation * scale without multiplying matrices*/
+	static glm::mat4 ComposeTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+
 	glm::mat4&	GetLocalTransform() { return m_LocalTransform; }
 	glm::vec3&	GetLocalTranslation() { return m_LocalTranslation; }
 	glm::quat&	GetLocalRotation() { return m_LocalRotation; }
@@ -89,19 +98,22 @@ class Bone {
 
    private:
 	/* Gets normalized value for Lerp & Slerp*/
-	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime);
+	static float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime);
+
+	/*wraps or clamps the time depending on the behaviour of the animation*/
+	float GetLocalTime(float animationTime) const;
 
 	/*figures out which position keys to interpolate b/w and performs the interpolation
 	and returns the translation matrix*/
-	glm::vec3 InterpolatePosition(float animationTime);
+	glm::vec3 InterpolatePosition(float animationTime) const;
 
 	/*figures out which rotations keys to interpolate b/w and performs the interpolation
 	and returns the rotation matrix*/
-	glm::quat InterpolateRotation(float animationTime);
+	glm::quat InterpolateRotation(float animationTime) const;
 
 	/*figures out which scaling keys to interpolate b/w and performs the interpolation
 	and returns the scale matrix*/
-	glm::vec3 InterpolateScaling(float animationTime);
+	glm::vec3 InterpolateScaling(float animationTime) const;
 };
 
 struct AssimpNodeData {
@@ -111,6 +123,16 @@ struct AssimpNodeData {
 	std::vector<AssimpNodeData> children;
 };
 
+/**
+ * @brief A node of the hierarchy of an Animation, stored in an array where every node comes after its parent.
+ */
+struct SkeletonNode {
+	glm::mat4	transformation;		///< transformation relative to the parent when the node is not animated
+	int			parent;				///< index of the parent node, -1 for the root
+	int			bone;				///< index of the animated Bone, -1 if the node is not animated
+	std::string name;
+};
+
 class Animation {
    public:
 	Animation() = default;
@@ -124,6 +146,7 @@ class Animation {
 		m_TicksPerSecond = animation->mTicksPerSecond;
 		ReadHeirarchyData(m_RootNode, scene->mRootNode);
 		ReadMissingBones(animation, behaviour);
+		FlattenHeirarchy(m_RootNode, -1);
 	}
 
 	Bone* FindBone(const std::string& name) {
@@ -132,12 +155,16 @@ class Animation {
 		return nullptr;
 	}
 
+	inline Bone& GetBone(uint index) { return m_Bones[index]; }
+
 	inline float GetTicksPerSecond() { return m_TicksPerSecond; }
 
 	inline float GetDuration() { return m_Duration; }
 
 	inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
 
+	inline const std::vector<SkeletonNode>& GetNodes() { return m_Nodes; }
+
 	inline const std::unordered_map<std::string, BoneInfo>& GetBoneIDMap() { return m_BoneInfoMap; }
 
 	inline uint GetBonesCount() { return m_Bones.size(); }
@@ -180,36 +207,49 @@ class Animation {
 		}
 	}
 
+	void FlattenHeirarchy(const AssimpNodeData& node, int parent) {
+		auto bone  = m_BoneInfoMap.find(node.name);
+		int	 index = m_Nodes.size();
+		m_Nodes.push_back({node.transformation, parent, bone != m_BoneInfoMap.end() ? (int)bone->second.id : -1,
+						   node.name});
+		for (const AssimpNodeData& child : node.children)
+			FlattenHeirarchy(child, index);
+	}
+
 	float									  m_Duration;
 	int										  m_TicksPerSecond;
 	std::vector<Bone>						  m_Bones;
 	AssimpNodeData							  m_RootNode;
+	std::vector<SkeletonNode>				  m_Nodes;
 	std::unordered_map<std::string, BoneInfo> m_BoneInfoMap;
 };
 
+/**
+ * @brief Plays an Animation on an AnimatedMesh and optionally blends it with a second one. The hierarchy of the
+ * animation is bound to the bones of the mesh once, when the animations change, so updating is a single pass over an
+ * array without any lookups or allocations.
+ */
 class Animator {
    public:
 	Animator(AnimatedMesh* mesh, Animation* currentAnimation) {
 		m_CurrentTimeCurrent = 0.0;
 		m_CurrentTimeBlended = 0.0;
 		m_CurrentAnimation	 = currentAnimation;
+		m_BlendedAnimation	 = nullptr;
 		this->mesh			 = mesh;
 
 		m_FinalBoneMatrices.reserve(200);
 		for (uint i = 0; i < 200; i++)
 			m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
 
-		glGenBuffers(1, &matricesBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, matricesBuffer);
-		glBufferData(GL_ARRAY_BUFFER, GetFinalBoneMatrices().size() * 4 * 16, nullptr, GL_DYNAMIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		BindAnimations();
 	}
 
 	void UpdateAnimation(float dt) {
 		m_DeltaTime = dt;
 		if (m_CurrentAnimation) {
 			m_CurrentTimeCurrent += m_CurrentAnimation->GetTicksPerSecond() * dt;
-			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+			CalculateBoneTransforms();
 		}
 		UpdateBoneBuffer();
 	}
@@ -219,103 +259,140 @@ class Animator {
 		if (m_CurrentAnimation) {
 			m_CurrentTimeCurrent += m_CurrentAnimation->GetTicksPerSecond() * dt;
 			m_CurrentTimeBlended += m_BlendedAnimation->GetTicksPerSecond() * dt;
-			CalculateBoneTransformBlended(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f), factor);
+			CalculateBoneTransformsBlended(factor);
 		}
 		UpdateBoneBuffer();
 	}
 
 	void UpdateBoneBuffer() {
-		glBindBuffer(GL_ARRAY_BUFFER, matricesBuffer);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, m_FinalBoneMatrices.size() * 64, m_FinalBoneMatrices.data());
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		Shader::setUBO(matricesBuffer, 3);
+		// written to a region the GPU is not reading from, so there is no stall on the draws of the last frame
+		matricesBuffer.nextFrame();
+		RingBuffer::Range range = matricesBuffer.write(m_FinalBoneMatrices.data(), m_FinalBoneMatrices.size() * 64,
+													   RingBuffer::getOffsetAlignment(GL_UNIFORM_BUFFER));
+		matricesBuffer.bindRange(GL_UNIFORM_BUFFER, 3, range);
 	}
 
 	void PlayAnimation(Animation* pAnimation) {
 		m_CurrentAnimation = pAnimation;
 		m_CurrentTimeCurrent	   = 0.0f;
+		BindAnimations();
 	}
 
 	void setBlendAnimation(Animation* animation) {
 		m_BlendedAnimation	 = animation;
+		BindAnimations();
 	}
 
-	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform) {
-		const std::string& nodeName = node->name;
-		glm::mat4		   nodeTransform;
-
-		Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
-
-		if (Bone) {
-			Bone->Update(m_CurrentTimeCurrent);
-			nodeTransform = Bone->GetLocalTransform();
-		} else {
-			nodeTransform = node->transformation;
-		}
-
-		glm::mat4 globalTransformation = parentTransform * nodeTransform;
+	/**
+	 * @brief Evaluates the current animation. Nodes are visited in the order of Animation::GetNodes(), so the
+	 * transformation of the parent of a node is always ready before the node.
+	 */
+	void CalculateBoneTransforms() {
+		const std::vector<SkeletonNode>& nodes = m_CurrentAnimation->GetNodes();
+		for (std::size_t i = 0; i < nodes.size(); ++i) {
+			const NodeBinding& binding = m_Bindings[i];
+			glm::mat4		   nodeTransform;
+
+			if (binding.current) {
+				glm::vec3 translation, scale;
+				glm::quat rotation;
+				binding.current->Sample(m_CurrentTimeCurrent, translation, rotation, scale);
+				nodeTransform = Bone::ComposeTransform(translation, rotation, scale);
+			} else {
+				nodeTransform = nodes[i].transformation;
+			}
 
-		auto& boneInfoMap = mesh->getBoneInfoMap();
-		auto  boneInfo	  = boneInfoMap.find(nodeName);
-		if (boneInfo != boneInfoMap.end()) {
-			int		  index			   = boneInfo->second.id;
-			glm::mat4 offset		   = boneInfo->second.offset;
-			m_FinalBoneMatrices[index] = globalTransformation * offset;
+			SetGlobalTransform(i, nodes[i].parent, nodeTransform);
 		}
-
-		for (int i = 0; i < node->childrenCount; i++)
-			CalculateBoneTransform(&node->children[i], globalTransformation);
 	}
 
-	void CalculateBoneTransformBlended(const AssimpNodeData* node, glm::mat4 parentTransform, float factor) {
+	/**
+	 * @brief Evaluates the current animation mixed with the blended one. Nodes that are animated by only one of them
+	 * keep their rest transformation, like before blending was set.
+	 *
+	 * @param factor - weight of the blended animation
+	 */
+	void CalculateBoneTransformsBlended(float factor) {
 		assert(m_BlendedAnimation != nullptr);
-		const std::string& nodeName = node->name;
-		glm::mat4		   nodeTransform;
-
-		Bone* Bone1 = m_CurrentAnimation->FindBone(nodeName);
-		Bone* Bone2 = m_BlendedAnimation->FindBone(nodeName);
-
-		if (Bone1 && Bone2) {
-			Bone1->Update(m_CurrentTimeCurrent);
-			Bone2->Update(m_CurrentTimeBlended);
-			glm::vec3 translation = glm::mix(Bone1->GetLocalTranslation(), Bone2->GetLocalTranslation(), factor);
-			glm::quat rotation	  = glm::slerp(Bone1->GetLocalRotation(), Bone2->GetLocalRotation(), factor);
-			rotation			  = glm::normalize(rotation);
-			glm::vec3 scale		  = glm::mix(Bone1->GetLocalScale(), Bone2->GetLocalScale(), factor);
-
-			glm::mat4 t	  = glm::translate(glm::mat4(1), translation);
-			glm::mat4 r	  = glm::toMat4(rotation);
-			glm::mat4 s	  = glm::scale(glm::mat4(1), scale);
-			nodeTransform = t * r * s;
-		} else {
-			nodeTransform = node->transformation;
+		const std::vector<SkeletonNode>& nodes = m_CurrentAnimation->GetNodes();
+		for (std::size_t i = 0; i < nodes.size(); ++i) {
+			const NodeBinding& binding = m_Bindings[i];
+			glm::mat4		   nodeTransform;
+
+			if (binding.current && binding.blended) {
+				glm::vec3 translation1, translation2, scale1, scale2;
+				glm::quat rotation1, rotation2;
+				binding.current->Sample(m_CurrentTimeCurrent, translation1, rotation1, scale1);
+				binding.blended->Sample(m_CurrentTimeBlended, translation2, rotation2, scale2);
+
+				glm::vec3 translation = glm::mix(translation1, translation2, factor);
+				glm::quat rotation	  = glm::normalize(glm::slerp(rotation1, rotation2, factor));
+				glm::vec3 scale		  = glm::mix(scale1, scale2, factor);
+				nodeTransform		  = Bone::ComposeTransform(translation, rotation, scale);
+			} else {
+				nodeTransform = nodes[i].transformation;
+			}
+
+			SetGlobalTransform(i, nodes[i].parent, nodeTransform);
 		}
+	}
 
-		glm::mat4 globalTransformation = parentTransform * nodeTransform;
+	const std::vector<glm::mat4>& GetFinalBoneMatrices() { return m_FinalBoneMatrices; }
 
-		auto& boneInfoMap = mesh->getBoneInfoMap();
-		auto  boneInfo	  = boneInfoMap.find(nodeName);
-		if (boneInfo != boneInfoMap.end()) {
-			int		  index			   = boneInfo->second.id;
-			glm::mat4 offset		   = boneInfo->second.offset;
-			m_FinalBoneMatrices[index] = globalTransformation * offset;
+   private:
+	/// what a node of the current animation is connected to
+	struct NodeBinding {
+		Bone*	  current;		///< channel of the current animation, nullptr if the node is not animated
+		Bone*	  blended;		///< channel of the blended animation, nullptr if the node is not animated
+		int		  meshBone;		///< index in the final bone matrices, -1 if the mesh has no such bone
+		glm::mat4 offset;		///< offset matrix of the bone in the mesh
+	};
+
+	/// resolves the names of the nodes of the current animation. Called when the animations change.
+	void BindAnimations() {
+		m_Bindings.clear();
+		m_GlobalTransforms.clear();
+		if (!m_CurrentAnimation) return;
+
+		const std::vector<SkeletonNode>& nodes		 = m_CurrentAnimation->GetNodes();
+		auto&							 boneInfoMap = mesh->getBoneInfoMap();
+		m_Bindings.resize(nodes.size());
+		m_GlobalTransforms.resize(nodes.size());
+		for (std::size_t i = 0; i < nodes.size(); ++i) {
+			NodeBinding& binding = m_Bindings[i];
+			binding.current		 = nodes[i].bone >= 0 ? &m_CurrentAnimation->GetBone(nodes[i].bone) : nullptr;
+			binding.blended		 = m_BlendedAnimation ? m_BlendedAnimation->FindBone(nodes[i].name) : nullptr;
+			binding.meshBone	 = -1;
+
+			auto boneInfo = boneInfoMap.find(nodes[i].name);
+			if (boneInfo == boneInfoMap.end()) continue;
+			if (boneInfo->second.id >= m_FinalBoneMatrices.size()) {
+				dbLog(ygl::LOG_WARNING, "the mesh has too many bones, ", nodes[i].name, " will not be animated");
+				continue;
+			}
+			binding.meshBone = boneInfo->second.id;
+			binding.offset	 = boneInfo->second.offset;
 		}
-
-		for (int i = 0; i < node->childrenCount; i++)
-			CalculateBoneTransformBlended(&node->children[i], globalTransformation, factor);
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices() { return m_FinalBoneMatrices; }
+	void SetGlobalTransform(std::size_t node, int parent, const glm::mat4& nodeTransform) {
+		glm::mat4 globalTransformation = parent < 0 ? nodeTransform : m_GlobalTransforms[parent] * nodeTransform;
+		m_GlobalTransforms[node]	   = globalTransformation;
 
-   private:
-	std::vector<glm::mat4> m_FinalBoneMatrices;
-	Animation*			   m_CurrentAnimation;
-	Animation*			   m_BlendedAnimation;
-	float				   m_CurrentTimeCurrent;
-	float				   m_CurrentTimeBlended;
-	float				   m_DeltaTime;
-	AnimatedMesh*		   mesh;
-	uint				   matricesBuffer;
+		const NodeBinding& binding = m_Bindings[node];
+		if (binding.meshBone >= 0) m_FinalBoneMatrices[binding.meshBone] = globalTransformation * binding.offset;
+	}
+
+	std::vector<glm::mat4>	 m_FinalBoneMatrices;
+	std::vector<NodeBinding> m_Bindings;
+	std::vector<glm::mat4>	 m_GlobalTransforms;	 ///< transformation of each node relative to the mesh
+	Animation*				 m_CurrentAnimation;
+	Animation*				 m_BlendedAnimation;
+	float					 m_CurrentTimeCurrent;
+	float					 m_CurrentTimeBlended;
+	float					 m_DeltaTime;
+	AnimatedMesh*			 mesh;
+	RingBuffer				 matricesBuffer = RingBuffer(200 * sizeof(glm::mat4));
 };
 
 class AnimationFSM {
@@ -208,7 +208,7 @@ class AssetManager : public ygl::ISystem {
 	AssetManager(Scene *scene) : ISystem(scene) {};
 	~AssetManager();
 
-	void init() override {}
+	void init() override { reads<>(); }
 	void doWork() override {}
 	void write(std::ostream &out) override;
 	void read(std::istream &in) override;
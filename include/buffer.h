@@ -1,12 +1,14 @@
 #pragma once
 #include <yoghurtgl.h>
+#include <gl_state.h>
+#include <vector>
 
 namespace ygl {
 class Buffer {
    public:
 	Buffer() = default;
 	Buffer(GLenum target, GLsizeiptr size) : target(target), size(size) { glGenBuffers(1, &buffer); }
-	~Buffer() { glDeleteBuffers(1, &buffer); }
+	~Buffer() { GLState::deleteBuffer(buffer); }
 
 	Buffer(const Buffer &) = delete;
 	Buffer(Buffer &&other);
@@ -75,4 +77,99 @@ class MutableBuffer : public Buffer {
 	GLenum usage;
 };
 
+/**
+ * @brief A buffer for data that the CPU writes again every frame, like uniforms and instance data. It is split in
+ * regions and the writes of a frame go one after the other in the current region. nextFrame() fences that region and
+ * moves to the next one, waiting only if the GPU still reads it. On desktop the buffer is persistently mapped, so a
+ * write is a memcpy and the driver never has to synchronize. Written data stays valid until the same region is used
+ * again, so everything that is bound from the buffer has to be written again after each nextFrame().
+ */
+class RingBuffer {
+   public:
+	/// a part of the buffer that was allocated in the current region
+	struct Range {
+		GLintptr   offset = 0;
+		GLsizeiptr size	  = 0;
+	};
+
+	/**
+	 * @param regionSize - size of a region in bytes, rounded up to getRegionAlignment()
+	 * @param regionsCount - number of regions, the frames that can be in flight at the same time
+	 */
+	RingBuffer(GLsizeiptr regionSize, uint regionsCount = 3);
+	~RingBuffer();
+
+	RingBuffer(const RingBuffer &)			  = delete;
+	RingBuffer &operator=(const RingBuffer &) = delete;
+
+	/**
+	 * @brief Allocates \a size bytes in the current region.
+	 *
+	 * @param size - size in bytes
+	 * @param alignment - alignment of the offset, see getOffsetAlignment()
+	 * @return Range - the allocated range, empty if it does not fit in the region
+	 */
+	Range allocate(GLsizeiptr size, GLsizeiptr alignment);
+	/**
+	 * @brief Copies \a data to \a range, starting \a offset bytes after its beginning.
+	 */
+	void  write(const Range &range, GLintptr offset, const void *data, GLsizeiptr size);
+	Range write(const void *data, GLsizeiptr size, GLsizeiptr alignment);
+	/**
+	 * @brief Binds \a range to an indexed binding point of \a target. Empty ranges are not bound.
+	 */
+	void bindRange(GLenum target, GLuint index, const Range &range) const;
+
+	/**
+	 * @brief Fences the current region and moves to the next one.
+	 */
+	void nextFrame();
+	/**
+	 * @brief Makes the regions at least \a regionSize bytes big, rounded up to getRegionAlignment(). Growing recreates
+	 * the buffer and drops everything that was written, so it should be done right after nextFrame().
+	 */
+	void reserve(GLsizeiptr regionSize);
+
+	GLuint	   getID() const { return buffer; }
+	GLsizeiptr getRegionSize() const { return regionSize; }
+
+	/**
+	 * @brief Get the alignment of offsets bound to \a target.
+	 *
+	 * @param target - GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+	 */
+	static GLsizeiptr getOffsetAlignment(GLenum target);
+	/**
+	 * @brief Get the alignment of the start of every region, the largest offset alignment of the targets that ranges
+	 * are bound to. Offsets aligned inside a region are then aligned in the buffer too.
+	 */
+	static GLsizeiptr getRegionAlignment();
+	/**
+	 * @brief Places \a size bytes in a region, the arithmetic behind allocate().
+	 *
+	 * @param region - index of the region
+	 * @param regionSize - size of a region, a multiple of \a alignment
+	 * @param head [in, out] - first free byte in the region, moved past the placed bytes
+	 * @param size - size in bytes
+	 * @param alignment - alignment of the offset, a power of two
+	 * @return GLintptr - offset in the buffer, -1 if the bytes do not fit in the region
+	 */
+	static GLintptr place(uint region, GLsizeiptr regionSize, GLsizeiptr &head, GLsizeiptr size, GLsizeiptr alignment);
+	/// rounds \a size up to a multiple of \a alignment
+	static GLsizeiptr alignSize(GLsizeiptr size, GLsizeiptr alignment) {
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+   private:
+	GLuint				buffer	   = 0;
+	GLsizeiptr			regionSize = 0;
+	uint				region	   = 0;
+	GLsizeiptr			head	   = 0;		///< first free byte in the current region
+	uint8_t			   *mapped	   = nullptr;
+	std::vector<GLsync>	fences;		///< fence of each region, null when it is not used by the GPU
+
+	void create();
+	void wait(uint region);
+};
+
 };	   // namespace ygl
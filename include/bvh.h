@@ -25,11 +25,13 @@ namespace ygl {
 namespace bvh {
 ///
 /// Data for an intersection between a ray and scene primitive
+struct Intersectable;
 struct Intersection {
-	float	  t = -1.f;				  ///< Position of the intersection along the ray
-	glm::vec3 p;					  ///< The intersection point
-	glm::vec3 normal;				  ///< The normal at the intersection
-	Material *material = nullptr;	  ///< Material of the intersected primitive
+	float		   t = -1.f;				///< Position of the intersection along the ray
+	glm::vec3	   p;						///< The intersection point
+	glm::vec3	   normal;					///< The normal at the intersection
+	Material	  *material	 = nullptr;		///< Material of the intersected primitive
+	Intersectable *primitive = nullptr;		///< The intersected primitive
 };
 
 ///
@@ -107,6 +109,17 @@ struct Intersectable {
 	/// @brief Get the center
 	virtual glm::vec3 getCenter() = 0;
 
+	/**
+	 * @brief Intersects a ray with the Intersectable.
+	 *
+	 * @param ray - the ray
+	 * @param tMin - intersections closer than that are ignored
+	 * @param tMax - intersections further than that are ignored
+	 * @param hit [out] - the intersection data, only written if there is an intersection
+	 * @return true - if there is an intersection between \a tMin and \a tMax
+	 */
+	virtual bool intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) = 0;
+
 	/**
 	 * @brief Writes the Intersectable to \a buff at position \a offset
 	 *
@@ -137,6 +150,9 @@ struct Primitive : Intersectable {
 	/// @brief Get the center
 	glm::vec3 getCenter() override { return box.center(); }
 
+	/// @brief Default implementation intersecting the bbox of the primitive
+	bool intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) override;
+
 	~Primitive() = default;
 };
 
@@ -180,6 +196,7 @@ struct Triangle : public Primitive {
 	bool	  boxIntersect(const BBox &box) override;
 	void	  expandBox(BBox &box) override;
 	glm::vec3 getCenter() override;
+	bool	  intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) override;
 	void	  writeTo(char *buff, std::size_t offset) override;
 	void	  print(std::ostream &os) override;
 };
@@ -199,6 +216,7 @@ struct SpherePrimitive : Primitive {
 	}
 
 	glm::vec3 getCenter() override { return position; }
+	bool	  intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) override;
 	void	  writeTo(char *buff, std::size_t offset) override;
 	void	  print(std::ostream &os) override;
 };
@@ -242,10 +260,8 @@ AcceleratorPtr									 makeDefaultAccelerator();
 
 /**
  * @brief A Binary Volume Hierarchy.
- * build() builds a tree that can then be optimised for GPU usage and sent to the VRAM with buildGPUTree()
- *
- * @note some comments may be misleading since now this structure is used to do stuff on the GPU, the CPU intersection
- * has been removed
+ * build() builds a tree that can then be optimised for GPU usage and sent to the VRAM with buildGPUTree(). The same
+ * flattened tree can be traversed on the CPU with intersect() and occluded().
  */
 class BVHTree : public IntersectionAccelerator {
 	// Node structure
@@ -260,12 +276,28 @@ class BVHTree : public IntersectionAccelerator {
 				Node *left, *right;
 			};
 		};
-		std::vector<Intersectable *> primitives;
-		char						 splitAxis;
-		Node() : left(nullptr), right(nullptr), splitAxis(-1) {}
+		std::size_t primOffset;		///< index of the first primitive of the node in allPrimitives
+		std::size_t primCount;		///< number of primitives in the node
+		char		splitAxis;
+		Node() : left(nullptr), right(nullptr), primOffset(0), primCount(0), splitAxis(-1) {}
 		bool isLeaf() { return children[0] == nullptr; }
 	};
 
+	// bounds of a primitive, computed once before the construction
+	struct BuildPrimitive {
+		BBox	  box;
+		glm::vec3 center;
+		uint32_t  index;	 ///< index in allPrimitives
+	};
+
+	// statistics for a subtree, collected separately by each build task
+	struct BuildStats {
+		int		 depth		 = 0;
+		int		 leafSize	 = 0;
+		long int leavesCount = 0;
+		long int nodeCount	 = 0;
+	};
+
 	// faster intersection tree node;
 	// left child will always be next in the array, right child is a index in the nodes array.
 	struct FastNode {
@@ -286,60 +318,73 @@ class BVHTree : public IntersectionAccelerator {
 		uint	  right;
 		uint	  primOffset;
 		uint	  primCount;
-		bool	  isLeaf() { return right == 0; }
+		bool	  isLeaf() const { return right == 0; }
+	};
+
+	// four triangles in a leaf, stored for SIMD Moller-Trumbore tests. Unused lanes are degenerate triangles.
+	struct alignas(16) TrianglePack {
+		float	 v0[3][4];	   ///< first vertex, x, y and z of the 4 triangles
+		float	 e1[3][4];	   ///< first edge
+		float	 e2[3][4];	   ///< second edge
+		uint32_t primitive[4];
+	};
+
+	// data for the CPU traversal of a leaf
+	struct CPULeaf {
+		uint32_t packOffset;	 ///< index of the first TrianglePack of the leaf
+		uint32_t packCount;
+		uint32_t otherOffset;	  ///< index in otherPrimitives of the first primitive that is not a Triangle
+		uint32_t otherCount;
 	};
 
-	// all primitives added
+	// all primitives added. After build() they are ordered so that the primitives of each leaf are consecutive
 	std::vector<Intersectable *> allPrimitives;
+	// precomputed bounds of all primitives, only used during construction
+	std::vector<BuildPrimitive> buildPrimitives;
 	// root of the construction tree
 	Node *root = nullptr;
 	// nodes of the fast traversal tree
 	std::vector<GPUNode> gpuNodes;
-	bool				 built = false;
+	// per node data for the CPU traversal, only meaningful for leaves
+	std::vector<CPULeaf>	  cpuLeaves;
+	std::vector<TrianglePack> trianglePacks;
+	std::vector<uint32_t>	  otherPrimitives;	   ///< indices in allPrimitives
+	bool					  built		  = false;
+	bool					  uploadToGPU = true;
 	// cost for traversing a parent node. It is assumed that the intersection cost with a primitive is 1.0
 	static constexpr float SAH_TRAVERSAL_COST = 0.125;
-	// the number of splits SAH will try.
-	static constexpr int SAH_TRY_COUNT		  = 5;
+	// the number of bins the centroids are sorted into on each axis when searching for the best SAH split
+	static constexpr int SAH_BINS_COUNT		  = 16;
 	static constexpr int MAX_DEPTH			  = 50;
 	static constexpr int MIN_PRIMITIVES_COUNT = 6;
-	// when a node has less than that number of primitives it will sort them and always split in the middle
-	//
-	// theoretically:
-	// the higher this is, the better the tree and the slower its construction
-	//
-	// practically:
-	// when setting this to something higher, the tree construction time changes by verry little
-	// and the render time goes up. When this is set to 1e6 (basically always sort), makes
-	// rendering about 30% slower than when it is 0 (never split perfectly). (on the instanced dragons scene)
-	// Perfect splits clearly produce shallower trees, which should make rendering faster ... but it doesn't.
-	//
-	// I guess SAH is too good
-	static constexpr int PERFECT_SPLIT_THRESHOLD = 20;
 
 	int		 depth			 = 0;	  ///< depth of the tree
 	int		 leafSize		 = 0;	  ///< size of the largest leaf
 	long int leavesCount	 = 0;	  ///< hOw MaNy LeAvEs
 	long int nodeCount		 = 0;	  ///< HoW mAnY nOdEs
 	long int primitivesCount = 0;	  ///< how many primitives are in the structure
+	float	 sahCost		 = 0;	  ///< SAH cost of the whole tree
 
-	void clear(Node *node);				   ///< clears the entire CPU tree starting from \a node
-	void clearConstructionTree();		   ///< clears the entire CPU tree
-	void build(Node *node, int depth);	   ///< builds the CPU tree
+	void clear(Node *node);			  ///< clears the entire CPU tree starting from \a node
+	void clearConstructionTree();	  ///< clears the entire CPU tree
 
-	bool isBuilt() const override { return built; }		///< checks if the tree is built
+	/// @brief builds the CPU subtree of \a node from \a count primitives starting at buildPrimitives[offset].
+	/// Reorders that range of buildPrimitives so that the primitives of every leaf are consecutive.
+	void build(Node *node, std::size_t offset, std::size_t count, int depth, BuildStats &stats);
 
-	/// @brief computes the SAH cost for a split on a given axis.
-	/// ratio equals the size of the left child on the chosen axis over
-	/// the size of the parent node size on that axis.
-	float costSAH(const Node *node, int axis, float ratio);
+	bool isBuilt() const override { return built; }		///< checks if the tree is built
 
 	/**
 	 * helper function for constructing the GPU tree.
 	 */
-	void buildGPUTree_h(BVHTree::Node *node, unsigned long int parent, std::vector<BVHTree::GPUNode> &gpuNodes,
-						std::vector<Intersectable *> &primitives);
+	void buildGPUTree_h(BVHTree::Node *node, unsigned long int parent, std::vector<BVHTree::GPUNode> &gpuNodes);
+
+	void buildGPUTree();	   ///< builds a tree for fast traversal on the GPU
+	void uploadGPUTree();	   ///< sends the GPU tree and the primitives to the VRAM
+	void buildCPULeaves();	   ///< packs the primitives in the leaves for the CPU traversal
 
-	void buildGPUTree();	 ///< builds a tree for fast traversal on the GPU
+	/// @brief traverses the tree, if \a anyHit is true stops at the first intersection found
+	bool traverse(const Ray &ray, float tMin, float tMax, Intersection &hit, bool anyHit) const;
 
    public:
 	void addPrimitive(Intersectable *prim) override;
@@ -352,6 +397,45 @@ class BVHTree : public IntersectionAccelerator {
 	void addPrimitive(Mesh *mesh, Transformation &transform);
 	void clear() override;
 	void build(Purpose purpose = Purpose::Generic) override;
+
+	/**
+	 * @brief Get the SAH cost of the built tree: the expected cost of intersecting a ray with it, relative to the cost
+	 * of intersecting a single primitive.
+	 *
+	 * @return float
+	 */
+	float getSAHCost() const { return sahCost; }
+
+	/**
+	 * @brief Sets if build() should send the tree to the GPU. Disable it to use the tree only on the CPU, without an
+	 * OpenGL context.
+	 *
+	 * @param upload - true by default
+	 */
+	void setUploadToGPU(bool upload) { uploadToGPU = upload; }
+
+	/**
+	 * @brief Finds the closest intersection of a ray with the primitives in the tree. Can be called from multiple
+	 * threads at once.
+	 *
+	 * @param ray - the ray, its direction does not have to be normalized
+	 * @param hit [out] - the closest intersection, only written if there is one
+	 * @param tMin - intersections closer than that are ignored
+	 * @param tMax - intersections further than that are ignored
+	 * @return true - if the ray intersects a primitive
+	 */
+	bool intersect(const Ray &ray, Intersection &hit, float tMin = 0, float tMax = FLT_MAX) const;
+
+	/**
+	 * @brief Checks if a ray intersects any primitive in the tree, without finding the closest intersection. Faster
+	 * than intersect().
+	 *
+	 * @param ray - the ray
+	 * @param tMin - intersections closer than that are ignored
+	 * @param tMax - intersections further than that are ignored
+	 * @return true - if the ray is occluded between \a tMin and \a tMax
+	 */
+	bool occluded(const Ray &ray, float tMin = 0, float tMax = FLT_MAX) const;
 	~BVHTree();
 };
 }	  // namespace bvh
@@ -5,6 +5,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <transformation.h>
 #include <window.h>
+#include <buffer.h>
+#include <cstddef>
+#include <cstdint>
 
 /**
  * @file camera.h
@@ -13,6 +16,43 @@
 
 namespace ygl {
 
+/**
+ * @brief The six planes of a view frustum. Each plane is stored as (normal, distance) with the normal pointing inwards,
+ * so a point p is inside when dot(normal, p) + distance >= 0 for all planes.
+ */
+struct Frustum {
+	glm::vec4 planes[6];	 ///< left, right, bottom, top, near and far
+
+	Frustum() = default;
+	/**
+	 * @brief Extracts the planes of a view-projection matrix with the method of Gribb and Hartmann.
+	 *
+	 * @param viewProjection - projection matrix multiplied by the view matrix
+	 */
+	Frustum(const glm::mat4 &viewProjection);
+
+	/**
+	 * @brief Checks if a sphere is at least partly inside the frustum. Spheres near the corners may be reported as
+	 * visible when they are not.
+	 *
+	 * @param sphere - center and radius
+	 */
+	bool intersectsSphere(const glm::vec4 &sphere) const;
+	/**
+	 * @brief Checks if an axis aligned box is at least partly inside the frustum.
+	 */
+	bool intersectsBox(const glm::vec3 &min, const glm::vec3 &max) const;
+	/**
+	 * @brief Tests many spheres at once, four at a time with SSE when it is available. Same results as
+	 * intersectsSphere().
+	 *
+	 * @param spheres - center and radius of each sphere
+	 * @param count - number of spheres
+	 * @param visible - set to 1 for each sphere that is at least partly inside and to 0 for the rest
+	 */
+	void cullSpheres(const glm::vec4 *spheres, std::size_t count, uint8_t *visible) const;
+};
+
 /**
  * @beief A Camera
  */
@@ -23,19 +63,27 @@ class Camera {
 		glm::mat4x4 viewMatrix;			  ///< the view matrix, defined by the camera's transform
 	} matrices;
 
-	GLuint uboMatrices;		///< a Uniform Bufffer Object that holds matrix data in VRAM
+	RingBuffer		 *matricesBuffer = nullptr;		///< the matrices of the last few updates, for use as a UBO
+	RingBuffer::Range matricesRange;				///< where the matrices of the last update are
+
+	static constexpr int  MAX_BINDINGS				   = 16;
+	inline static Camera *enabledCameras[MAX_BINDINGS] = {};	 ///< the camera enabled at each UBO binding
 
    public:
 	ygl::Transformation transform;	   ///< transformation of the view point
 
-	Camera() : uboMatrices(0), transform() {}
+	Camera() : transform() {}
 	Camera(const Transformation &transform) : transform(transform) {}
 	Camera(const Camera &other)			   = delete;
 	Camera &operator=(const Camera &other) = delete;
-	virtual ~Camera() = default;
+	virtual ~Camera();
 
 	glm::mat4x4 getProjectionMatrix();
 	glm::mat4x4 getViewMatrix();
+	/**
+	 * @brief Get the frustum of the current projection and view matrices. Works for any projection.
+	 */
+	Frustum		getFrustum();
 
 	void		 createMatricesUBO();
 	void		 enable(int binding = 0);
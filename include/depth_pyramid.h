@@ -0,0 +1,62 @@
+#pragma once
+
+#include <yoghurtgl.h>
+#include <shader.h>
+#include <texture.h>
+#include <glm/glm.hpp>
+
+/**
+ * @file depth_pyramid.h
+ * @brief Hierarchical depth for occlusion culling
+ */
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+namespace ygl {
+
+/**
+ * @brief A Hi-Z pyramid: a mip chain of a depth buffer where every texel holds the farthest depth of the texels it
+ * covers. The screen rectangle of a bounding volume is covered by a few texels of one level, so testing if it is
+ * hidden takes at most four reads. Built by a compute shader, one dispatch for each level.
+ */
+class DepthPyramid {
+	GLuint		   texture = 0;
+	GLsizei		   width   = 0;
+	GLsizei		   height  = 0;
+	uint		   levels  = 0;
+	ComputeShader *shader  = nullptr;
+	glm::mat4	   viewProjection;	   ///< of the camera the depth was drawn with
+	bool		   built = false;
+
+	void create(GLsizei width, GLsizei height);
+
+   public:
+	DepthPyramid();
+	~DepthPyramid();
+	DELETE_COPY_AND_ASSIGNMENT(DepthPyramid)
+
+	/**
+	 * @brief Builds the pyramid from a depth buffer. Grows or shrinks with it.
+	 *
+	 * @param depth - a depth or depth stencil texture
+	 * @param width - width of the depth texture
+	 * @param height - height of the depth texture
+	 * @param viewProjection - projection times view matrix of the camera the depth was drawn with
+	 */
+	void build(Texture2d *depth, GLsizei width, GLsizei height, const glm::mat4 &viewProjection);
+	/**
+	 * @brief Marks the pyramid as outdated, isBuilt() is false until it is built again.
+	 */
+	void invalidate() { built = false; }
+	bool isBuilt() const { return built; }
+
+	void bind(int textureUnit) const;
+	void unbind(int textureUnit) const;
+
+	GLsizei			 getWidth() const { return width; }
+	GLsizei			 getHeight() const { return height; }
+	uint			 getLevelsCount() const { return levels; }
+	const glm::mat4 &getViewProjection() const { return viewProjection; }
+};
+
+}	  // namespace ygl
+#endif
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <cstring>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
 #include <istream>
 #include <ostream>
 #include <stdexcept>
@@ -78,6 +85,11 @@ template <class T>
 concept IsComponent = std::is_base_of<ygl::Serializable, T>::value && IsNamed<T>;
 
 class ISystem;
+class ArchetypeStorage;
+
+template <class T>
+	requires IsComponent<T>
+class ComponentAccessor;
 
 /**
  * @brief A concept for types that are allowed to be Systems in the ECS structure.
@@ -150,19 +162,123 @@ class IComponentArray {
 };
 
 /**
- * @brief An array of component data for entities
+ * @brief A set of entities stored as a sparse set. The entities are packed contiguously in a dense array and a paged
+ * sparse table maps an Entity to its index in it. Insertion, removal and lookup are a couple of array accesses with
+ * no hashing.
+ */
+class EntitySet {
+	static constexpr std::size_t PAGE_SIZE	   = 1024;	   ///< entities per page of the sparse table
+	std::vector<Entity>			 dense;					   ///< the entities in the set
+	std::vector<std::unique_ptr<uint32_t[]>>
+		sparse;		///< pages that map an Entity to its index in the dense array, allocated on demand
+
+	/**
+	 * @brief Finds the sparse table slot of an Entity.
+	 *
+	 * @param e - an Entity
+	 * @return uint32_t* - pointer to the slot or nullptr if its page has not been allocated
+	 */
+	uint32_t *findSlot(Entity e) {
+		std::size_t page = e / PAGE_SIZE;
+		if (page >= sparse.size() || sparse[page] == nullptr) return nullptr;
+		return &sparse[page][e % PAGE_SIZE];
+	}
+
+	/**
+	 * @brief Gets the sparse table slot of an Entity, allocating its page if needed.
+	 *
+	 * @param e - an Entity
+	 * @return uint32_t& - the slot
+	 */
+	uint32_t &getSlot(Entity e) {
+		std::size_t page = e / PAGE_SIZE;
+		if (page >= sparse.size()) sparse.resize(page + 1);
+		if (sparse[page] == nullptr) {
+			sparse[page] = std::make_unique<uint32_t[]>(PAGE_SIZE);
+			std::fill_n(sparse[page].get(), PAGE_SIZE, INVALID_INDEX);
+		}
+		return sparse[page][e % PAGE_SIZE];
+	}
+
+   public:
+	static constexpr uint32_t INVALID_INDEX = UINT32_MAX;	  ///< index of an Entity that is not in the set
+
+	EntitySet() {}
+	DELETE_COPY_AND_ASSIGNMENT(EntitySet)
+
+	/**
+	 * @brief Finds the index of an Entity in the dense array.
+	 *
+	 * @param e - an Entity
+	 * @return uint32_t - the index or INVALID_INDEX if \a e is not in the set
+	 */
+	uint32_t indexOf(Entity e) {
+		uint32_t *slot = findSlot(e);
+		return slot == nullptr ? INVALID_INDEX : *slot;
+	}
+
+	bool contains(Entity e) { return indexOf(e) != INVALID_INDEX; }
+
+	/**
+	 * @brief Inserts an Entity at the end of the dense array.
+	 *
+	 * @param e - an Entity
+	 * @return true - if it was inserted, false if it was already in the set
+	 */
+	bool insert(Entity e) {
+		uint32_t &slot = getSlot(e);
+		if (slot != INVALID_INDEX) return false;
+		slot = dense.size();
+		dense.push_back(e);
+		return true;
+	}
+
+	/**
+	 * @brief Removes an Entity. The last Entity in the dense array is moved in its place.
+	 *
+	 * @param e - an Entity
+	 * @return uint32_t - the index \a e had, INVALID_INDEX if it was not in the set
+	 */
+	uint32_t erase(Entity e) {
+		uint32_t *slot = findSlot(e);
+		if (slot == nullptr || *slot == INVALID_INDEX) return INVALID_INDEX;
+
+		uint32_t index		 = *slot;
+		Entity	 last_entity = dense.back();
+		dense[index]		 = last_entity;
+		*findSlot(last_entity) = index;
+		*slot				 = INVALID_INDEX;
+		dense.pop_back();
+		return index;
+	}
+
+	void clear() {
+		for (Entity e : dense)
+			*findSlot(e) = INVALID_INDEX;
+		dense.clear();
+	}
+
+	std::size_t					size() { return dense.size(); }
+	const std::vector<Entity> &getEntities() { return dense; }
+	auto						begin() const { return dense.begin(); }
+	auto						end() const { return dense.end(); }
+};
+
+/**
+ * @brief An array of component data for entities, stored as a sparse set.
+ * Components are packed contiguously in a dense array in the same order as the entities in an EntitySet, so lookups,
+ * insertions and removals are a couple of array accesses with no hashing, and iterating the components touches only
+ * contiguous memory.
  *
  * @tparam T - Type of the component data stored
  */
 template <class T>
 	requires IsComponent<T>
 class ComponentArray : public IComponentArray {
-	std::vector<T> components;	   ///< the components of type T in the Scene
+	std::vector<T> components;	   ///< the components of type T in the Scene, packed densely
+	EntitySet	   entities;	   ///< the entities that own the components, in the same order
 	const char	  *type_name;	   ///< ponts to T::name
 
-	std::unordered_map<Entity, size_t> entityToIndexMap;	 ///< maps Entity to its component's index in the array
-	std::unordered_map<size_t, Entity> indexToEntityMap;	 ///< maps a component index to the Entity it belongs to
-
    public:
 	/**
 	 * @brief Construct a new ComponentArray.
@@ -185,14 +301,11 @@ class ComponentArray : public IComponentArray {
 	 * @return T& - a reference to the inserted data
 	 */
 	T &addComponent(Entity e, const T &component) {
-		if (entityToIndexMap.find(e) != entityToIndexMap.end()) {
+		if (!entities.insert(e)) {
 			dbLog(ygl::LOG_ERROR, "This entity already has that component: ", T::name);
-			return this->getComponent(e);
+			return components[entities.indexOf(e)];
 		}
 
-		int index				= components.size();
-		entityToIndexMap[e]		= index;
-		indexToEntityMap[index] = e;
 		components.push_back(component);
 		return components.back();
 	}
@@ -203,29 +316,21 @@ class ComponentArray : public IComponentArray {
 	 * @param e - the entity to check for the component
 	 * @return true - if the entity has a component of the array's type , false otherwise
 	 */
-	bool hasComponent(Entity e) { return entityToIndexMap.find(e) != entityToIndexMap.end(); }
+	bool hasComponent(Entity e) { return entities.contains(e); }
 
 	/**
-	 * @brief Removes a component from an Entity.
+	 * @brief Removes a component from an Entity. The last component in the array is moved in its place.
 	 *
 	 * @param e - The entity whose component is to be removed
 	 */
 	void removeComponent(Entity e) {
-		if (entityToIndexMap.find(e) == entityToIndexMap.end()) {
+		uint32_t index = entities.erase(e);
+		if (index == EntitySet::INVALID_INDEX) {
 			dbLog(ygl::LOG_ERROR, "cannot remove a non-existing component: ", T::name);
 			return;
 		}
 
-		size_t index	  = entityToIndexMap[e];
-		components[index] = components.back();
-
-		Entity last_entity			  = indexToEntityMap[count() - 1];
-		entityToIndexMap[last_entity] = index;
-		indexToEntityMap[index]		  = last_entity;
-
-		entityToIndexMap.erase(e);
-		indexToEntityMap.erase(count() - 1);
-
+		if (index != components.size() - 1) components[index] = std::move(components.back());
 		components.pop_back();
 	}
 
@@ -235,7 +340,7 @@ class ComponentArray : public IComponentArray {
 	 * @param e - an Entity
 	 */
 	void deleteEntity(Entity e) override {
-		if (entityToIndexMap.find(e) == entityToIndexMap.end()) {
+		if (!hasComponent(e)) {
 			dbLog(ygl::LOG_ERROR, "Cannot delete a non-existing entity: ", e);
 			return;
 		}
@@ -250,18 +355,296 @@ class ComponentArray : public IComponentArray {
 	 * @return T& - A reference to the component data
 	 */
 	T &getComponent(ygl::Entity e) {
-		if (entityToIndexMap.find(e) == entityToIndexMap.end()) {
+		uint32_t index = entities.indexOf(e);
+		if (index == EntitySet::INVALID_INDEX) {
 			THROW_RUNTIME_ERR("component " + std::string(T::name) + " not found on that entity.");
 		}
-		return components[entityToIndexMap[e]];
+		return components[index];
 	}
 
+	/**
+	 * @brief Pointer to the densely packed components. Component \a i belongs to the Entity getEntities()[i].
+	 *
+	 * @return T*
+	 */
 	T *data() { return components.data(); }
 
+	/**
+	 * @brief The entities that own the components, in the same order as data().
+	 *
+	 * @return const std::vector<Entity>&
+	 */
+	const std::vector<Entity> &getEntities() { return entities.getEntities(); }
+
 	void		  writeComponent(Entity e, std::ostream &out) override { getComponent(e).serialize(out); }
 	Serializable &readComponent(Entity e, std::istream &in, Scene *scene) override;
 };
 
+/**
+ * @brief Type-erased operations on a component type. They let an ArchetypeStorage move, destroy and serialize
+ * components that it knows only by their ComponentType.
+ */
+struct ComponentInfo {
+	const char *name	  = nullptr;	 ///< points to T::name
+	std::size_t size	  = 0;			 ///< sizeof(T)
+	std::size_t alignment = 1;			 ///< alignof(T)
+
+	void (*relocate)(void *dst, void *src)			= nullptr;	   ///< move-constructs *src into dst and destroys *src
+	void (*destroy)(void *ptr)						= nullptr;	   ///< destroys the component at ptr
+	void (*serialize)(void *ptr, std::ostream &out) = nullptr;	   ///< writes the component at ptr to out
+
+	/**
+	 * @brief Creates the ComponentInfo for a component type.
+	 *
+	 * @tparam T - component type
+	 * @return ComponentInfo
+	 */
+	template <class T>
+		requires IsComponent<T>
+	static ComponentInfo create() {
+		ComponentInfo info;
+		info.name	   = T::name;
+		info.size	   = sizeof(T);
+		info.alignment = alignof(T);
+		info.relocate  = [](void *dst, void *src) {
+			 new (dst) T(std::move(*(T *)src));
+			 ((T *)src)->~T();
+		};
+		info.destroy   = [](void *ptr) { ((T *)ptr)->~T(); };
+		info.serialize = [](void *ptr, std::ostream &out) { ((T *)ptr)->serialize(out); };
+		return info;
+	}
+};
+
+/**
+ * @brief All entities that have exactly the same Signature. Entities are stored in fixed-size chunks. Each chunk holds
+ * one array of entity IDs and one array per component type, so iterating a chunk is linear in memory.
+ * All chunks but the last one are always full.
+ */
+class Archetype {
+	struct Chunk {
+		std::byte *data;	  ///< memory of the chunk: the entity array followed by one array per component type
+		uint32_t   count;	  ///< how many entities are in the chunk
+	};
+
+	Signature							   signature;	   ///< the components that every Entity in the Archetype has
+	std::vector<ComponentType>			   types;		   ///< the component types in the signature
+	std::array<std::size_t, MAX_COMPONENTS> offsets;	   ///< offset of each component array within a chunk
+	const ComponentInfo					  *infos;		   ///< points to the ArchetypeStorage's component infos
+	std::vector<Chunk>					   chunks;		   ///< the chunks
+	uint32_t							   capacity;	   ///< how many entities fit in a chunk
+	std::size_t							   chunkBytes;	   ///< size of a chunk in bytes
+	std::size_t							   entitiesCount = 0;
+
+	friend class ArchetypeStorage;
+
+	/**
+	 * @brief Appends an Entity to the Archetype. The memory for its components is left uninitialized.
+	 *
+	 * @param e - an Entity
+	 * @return uint32_t - the row of the Entity
+	 */
+	uint32_t pushRow(Entity e);
+
+	/**
+	 * @brief Removes a row by moving the last row in its place. The components in the removed row must already be
+	 * destroyed or relocated.
+	 *
+	 * @param row - the row to remove
+	 * @return Entity - the Entity that has been moved to \a row. If \a row was the last one, this is its own Entity.
+	 */
+	Entity eraseRow(uint32_t row);
+
+   public:
+	static constexpr std::size_t CHUNK_SIZE		 = 16 * 1024;	  ///< preferred size of a chunk in bytes
+	static constexpr std::size_t CHUNK_ALIGNMENT = 64;			  ///< alignment of the memory of a chunk
+
+	/**
+	 * @brief Construct a new Archetype.
+	 *
+	 * @param signature - the Signature of the entities in it
+	 * @param infos - infos for all component types, indexed by ComponentType
+	 */
+	Archetype(Signature signature, const ComponentInfo *infos);
+	~Archetype();
+	DELETE_COPY_AND_ASSIGNMENT(Archetype)
+
+	Signature						  getSignature() { return signature; }
+	const std::vector<ComponentType> &getTypes() { return types; }
+	std::size_t						  size() { return entitiesCount; }
+	std::size_t						  getChunksCount() { return chunks.size(); }
+	uint32_t						  getCapacity() { return capacity; }
+
+	/**
+	 * @brief How many entities are in a chunk.
+	 *
+	 * @param chunk - index of the chunk
+	 * @return uint32_t
+	 */
+	uint32_t getChunkSize(std::size_t chunk) { return chunks[chunk].count; }
+
+	/**
+	 * @brief The entities in a chunk.
+	 *
+	 * @param chunk - index of the chunk
+	 * @return Entity* - getChunkSize(chunk) entities
+	 */
+	Entity *getEntities(std::size_t chunk) { return (Entity *)chunks[chunk].data; }
+
+	/**
+	 * @brief The array of components of type \a t in a chunk. The Archetype must have that component type.
+	 *
+	 * @param chunk - index of the chunk
+	 * @param t - component type
+	 * @return void* - pointer to the first component in the chunk
+	 */
+	void *getColumn(std::size_t chunk, ComponentType t) { return chunks[chunk].data + offsets[t]; }
+
+	/**
+	 * @brief Get the component of type \a t in a row.
+	 *
+	 * @param row - a row in the Archetype
+	 * @param t - component type
+	 * @return void* - pointer to the component
+	 */
+	void *getComponent(uint32_t row, ComponentType t) {
+		return (std::byte *)getColumn(row / capacity, t) + (row % capacity) * infos[t].size;
+	}
+};
+
+/**
+ * @brief Stores components grouped by the Signature of their entities in Archetypes. Adding or removing a component
+ * moves the Entity and all its components to another Archetype.
+ */
+class ArchetypeStorage {
+	/**
+	 * @brief Where an Entity is stored.
+	 */
+	struct Record {
+		Archetype *archetype = nullptr;		///< the Archetype of the Entity. nullptr if it has no components
+		uint32_t   row		 = 0;			///< the row in the Archetype
+	};
+
+	std::array<ComponentInfo, MAX_COMPONENTS>  infos;			  ///< infos for the registered component types
+	std::unordered_map<Signature, Archetype *> archetypes;		  ///< map from Signature to its Archetype
+	std::vector<Archetype *>				   archetypeList;	  ///< all archetypes, in order of creation
+	std::vector<Record>						   records;			  ///< where each Entity is stored
+
+	Archetype *getArchetype(Signature signature);
+	Record	  &getRecord(Entity e);
+
+	/**
+	 * @brief Moves an Entity to the Archetype with Signature \a signature. Components that are not in \a signature
+	 * are destroyed and components that are not in the Entity's current Archetype are left uninitialized.
+	 *
+	 * @param e - an Entity
+	 * @param signature - the new Signature of the Entity
+	 */
+	void moveEntity(Entity e, Signature signature);
+
+   public:
+	ArchetypeStorage() {}
+	~ArchetypeStorage();
+	DELETE_COPY_AND_ASSIGNMENT(ArchetypeStorage)
+
+	/**
+	 * @brief Registers a component type so it can be stored.
+	 *
+	 * @param t - ComponentType
+	 * @param info - type-erased operations on the type
+	 */
+	void registerComponent(ComponentType t, const ComponentInfo &info) { infos[t] = info; }
+
+	/**
+	 * @brief Adds a component to an Entity. The Entity is moved to its new Archetype.
+	 *
+	 * @param e - an Entity
+	 * @param t - component type
+	 * @return void* - uninitialized memory for the component. The caller must construct it.
+	 */
+	void *addComponent(Entity e, ComponentType t);
+
+	/**
+	 * @brief Removes and destroys a component of an Entity. The Entity is moved to its new Archetype.
+	 *
+	 * @param e - an Entity
+	 * @param t - component type
+	 */
+	void removeComponent(Entity e, ComponentType t);
+
+	/**
+	 * @brief Get a component of an Entity.
+	 *
+	 * @param e - an Entity
+	 * @param t - component type
+	 * @return void* - pointer to the component, nullptr if \a e does not have it
+	 */
+	void *getComponent(Entity e, ComponentType t);
+
+	bool hasComponent(Entity e, ComponentType t) { return getComponent(e, t) != nullptr; }
+
+	/**
+	 * @brief Destroys all components of an Entity.
+	 *
+	 * @param e - an Entity
+	 */
+	void destroyEntity(Entity e);
+
+	/**
+	 * @brief Serializes a component of an Entity. The Entity must have the component.
+	 *
+	 * @param e - an Entity
+	 * @param t - component type
+	 * @param out - stream to write to
+	 */
+	void writeComponent(Entity e, ComponentType t, std::ostream &out) { infos[t].serialize(getComponent(e, t), out); }
+
+	/**
+	 * @brief All archetypes that have been created, in order of creation.
+	 *
+	 * @return const std::vector<Archetype *>&
+	 */
+	const std::vector<Archetype *> &getArchetypes() { return archetypeList; }
+};
+
+/**
+ * @brief Reads the components of one type from either a ComponentArray or an ArchetypeStorage. The type's lookup is
+ * done once on construction, so each access is only an index lookup.
+ *
+ * @tparam T - component type
+ */
+template <class T>
+	requires IsComponent<T>
+class ComponentAccessor {
+	ComponentArray<T> *array   = nullptr;
+	ArchetypeStorage  *storage = nullptr;
+	ComponentType	   type	   = 0;
+
+   public:
+	ComponentAccessor() {}
+	ComponentAccessor(ComponentArray<T> *array) : array(array) {}
+	ComponentAccessor(ArchetypeStorage *storage, ComponentType type) : storage(storage), type(type) {}
+
+	/**
+	 * @brief Get the component of an Entity. The Entity must have it.
+	 *
+	 * @param e - an Entity
+	 * @return T& - the component
+	 */
+	T &get(Entity e) {
+		if (storage) return *(T *)storage->getComponent(e, type);
+		return array->getComponent(e);
+	}
+};
+
+/**
+ * @brief How a Scene stores the components of its entities.
+ */
+enum class ComponentStorage {
+	ARRAYS,			///< one ComponentArray per component type. Fast to add and remove components.
+	ARCHETYPES,		///< entities are grouped by their Signature in an ArchetypeStorage. Fast to iterate.
+};
+
 /**
  * @brief An object that manages the components in a Scene.
  */
@@ -271,6 +654,31 @@ class ComponentManager {
 				  componentArrays;	   ///< map from ComponentType to IComponentArray that holds components of that type
 	ComponentType componentTypeCounter =
 		0;	   ///< keeps track of component type count so IDs can be assigned correctly
+	std::unique_ptr<ArchetypeStorage>
+		archetypes;		///< stores the components when the Scene uses ComponentStorage::ARCHETYPES, nullptr otherwise
+
+	/**
+	 * @brief Calls \a f for every Entity that has all components \a T, going through the archetypes chunk by chunk.
+	 */
+	template <class... T, class F, std::size_t... I>
+	void forEachInArchetypes(F &f, std::index_sequence<I...>) {
+		ComponentType types[] = {getComponentType<T>()...};
+		Signature	  required;
+		for (ComponentType t : types)
+			required.set(t);
+
+		for (Archetype *archetype : archetypes->getArchetypes()) {
+			if ((archetype->getSignature() & required) != required) continue;
+			for (std::size_t chunk = 0; chunk < archetype->getChunksCount(); ++chunk) {
+				Entity			  *entities = archetype->getEntities(chunk);
+				std::tuple<T *...> columns((T *)archetype->getColumn(chunk, types[I])...);
+				uint32_t		   count = archetype->getChunkSize(chunk);
+				for (uint32_t i = 0; i < count; ++i) {
+					f(entities[i], std::get<I>(columns)[i]...);
+				}
+			}
+		}
+	}
 
    public:
 	ComponentManager() {}
@@ -300,8 +708,25 @@ class ComponentManager {
 		ComponentType type		 = componentTypeCounter++;
 		componentTypes[typeName] = type;
 		componentArrays[type]	 = new ygl::ComponentArray<T>();
+		if (archetypes) archetypes->registerComponent(type, ComponentInfo::create<T>());
 	}
 
+	/**
+	 * @brief Makes the manager store components in an ArchetypeStorage instead of ComponentArrays. Must be called
+	 * before any component is added.
+	 */
+	void useArchetypes() {
+		if (archetypes) return;
+		archetypes = std::make_unique<ArchetypeStorage>();
+	}
+
+	/**
+	 * @brief Checks if components are stored in an ArchetypeStorage.
+	 *
+	 * @return true - if useArchetypes() has been called
+	 */
+	bool usesArchetypes() { return archetypes != nullptr; }
+
 	/**
 	 * @brief Checks if a component has been registered.
 	 *
@@ -327,11 +752,12 @@ class ComponentManager {
 		requires IsComponent<T>
 	ComponentType getComponentType() {
 		const char *typeName = T::name;
-		if (!isComponentRegistered<T>()) {
+		auto		type	 = componentTypes.find(typeName);
+		if (type == componentTypes.end()) {
 			dbLog(ygl::LOG_ERROR, "component has not been registered: ", typeName);
 			return -1;
 		}
-		return componentTypes[typeName];
+		return type->second;
 	}
 
 	/**
@@ -344,13 +770,27 @@ class ComponentManager {
 	template <typename T>
 		requires IsComponent<T>
 	ComponentArray<T> *getComponentArray() {
-		const char	 *typeName = T::name;
-		ComponentType type	   = componentTypes[typeName];
-		if (componentArrays.find(type) == componentArrays.end()) {
+		const char *typeName = T::name;
+		auto		type	 = componentTypes.find(typeName);
+		if (type == componentTypes.end()) {
 			dbLog(ygl::LOG_ERROR, "component has not been registered: ", typeName);
 			return nullptr;
 		}
-		return static_cast<ComponentArray<T> *>(componentArrays[type]);
+		return static_cast<ComponentArray<T> *>(componentArrays.find(type->second)->second);
+	}
+
+	/**
+	 * @brief Get a ComponentAccessor for components of type \a T. It reads components without looking up their type
+	 * by name.
+	 *
+	 * @tparam T - component type
+	 * @return ComponentAccessor<T>
+	 */
+	template <typename T>
+		requires IsComponent<T>
+	ComponentAccessor<T> getAccessor() {
+		if (archetypes) return ComponentAccessor<T>(archetypes.get(), getComponentType<T>());
+		return ComponentAccessor<T>(getComponentArray<T>());
 	}
 
 	/**
@@ -378,6 +818,12 @@ class ComponentManager {
 	template <typename T>
 		requires IsComponent<T>
 	T &getComponent(Entity e) {
+		if (archetypes) {
+			T *component = (T *)archetypes->getComponent(e, getComponentType<T>());
+			if (component == nullptr)
+				THROW_RUNTIME_ERR("component " + std::string(T::name) + " not found on that entity.");
+			return *component;
+		}
 		return this->getComponentArray<T>()->getComponent(e);
 	}
 
@@ -392,6 +838,7 @@ class ComponentManager {
 	 */
 	template <typename T>
 	bool hasComponent(Entity e) {
+		if (archetypes) return archetypes->hasComponent(e, getComponentType<T>());
 		return this->getComponentArray<T>()->hasComponent(e);
 	}
 
@@ -406,6 +853,14 @@ class ComponentManager {
 	 */
 	template <typename T>
 	T &addComponent(Entity e, const T &component) {
+		if (archetypes) {
+			ComponentType type = getComponentType<T>();
+			if (T *existing = (T *)archetypes->getComponent(e, type)) {
+				dbLog(ygl::LOG_ERROR, "This entity already has that component: ", T::name);
+				return *existing;
+			}
+			return *new (archetypes->addComponent(e, type)) T(component);
+		}
 		return getComponentArray<T>()->addComponent(e, component);
 	}
 
@@ -417,6 +872,15 @@ class ComponentManager {
 	 */
 	template <typename T>
 	void removeComponent(Entity e) {
+		if (archetypes) {
+			ComponentType type = getComponentType<T>();
+			if (!archetypes->hasComponent(e, type)) {
+				dbLog(ygl::LOG_ERROR, "cannot remove a non-existing component: ", T::name);
+				return;
+			}
+			archetypes->removeComponent(e, type);
+			return;
+		}
 		getComponentArray<T>()->removeComponent(e);
 	}
 
@@ -426,11 +890,54 @@ class ComponentManager {
 	 * @param e - an Entity
 	 */
 	void deleteEntity(Entity e) {
+		if (archetypes) {
+			archetypes->destroyEntity(e);
+			return;
+		}
 		for (auto const &pair : componentArrays) {
 			pair.second->deleteEntity(e);
 		}
 	}
 
+	/**
+	 * @brief Writes the component of type \a t of the Entity \a e to \a out.
+	 *
+	 * @param t - component type
+	 * @param e - an Entity that has a component of type \a t
+	 * @param out - stream to write to
+	 */
+	void writeComponent(ComponentType t, Entity e, std::ostream &out) {
+		if (archetypes) archetypes->writeComponent(e, t, out);
+		else getComponentArray(t)->writeComponent(e, out);
+	}
+
+	/**
+	 * @brief Calls \a f(e, a, b, ...) for every Entity \a e that has components of all types \a T, where \a a, \a b,
+	 * ... are references to its components. With archetypes the iteration is linear in memory. Otherwise it goes
+	 * through the entities in the ComponentArray of the first type. Components must not be added or removed from
+	 * inside \a f.
+	 *
+	 * @tparam T - component types
+	 * @param f - a callable that accepts (Entity, T&...)
+	 */
+	template <class... T, class F>
+		requires(IsComponent<T> && ...)
+	void forEach(F &&f) {
+		static_assert(sizeof...(T) > 0, "at least one component type is required");
+		if (archetypes) {
+			forEachInArchetypes<T...>(f, std::index_sequence_for<T...>());
+			return;
+		}
+		std::tuple<ComponentArray<T> *...> arrays(getComponentArray<T>()...);
+		if (((std::get<ComponentArray<T> *>(arrays) == nullptr) || ...)) return;
+		auto *first = std::get<0>(arrays);
+		for (std::size_t i = 0; i < first->count(); ++i) {
+			Entity e = first->getEntities()[i];
+			if (!(std::get<ComponentArray<T> *>(arrays)->hasComponent(e) && ...)) continue;
+			f(e, std::get<ComponentArray<T> *>(arrays)->getComponent(e)...);
+		}
+	}
+
 	/**
 	 * @brief Writes all component types to \a out in binary format. Used for serialization of the Scene.
 	 *
@@ -461,11 +968,212 @@ class ComponentManager {
 	const auto &getComponentTypes() { return componentTypes; }
 };
 
+/**
+ * @brief Lists component types that a View must exclude.
+ * @see Scene::view() .
+ *
+ * @tparam T - component types
+ */
+template <class... T>
+struct Exclude {};
+
+/**
+ * @brief An instance of Exclude, to be passed to Scene::view(). Example: scene.view<A, B>(ygl::exclude<C>)
+ *
+ * @tparam T - component types
+ */
+template <class... T>
+inline constexpr Exclude<T...> exclude{};
+
+/**
+ * @brief The entities that match a query: they have all components in \a include and none of the components in
+ * \a exclude. It is kept up to date by the Scene whenever an Entity's Signature changes.
+ */
+struct CachedQuery {
+	Signature include;		///< components the entities must have
+	Signature exclude;		///< components the entities must not have
+	EntitySet entities;		///< the entities that match
+
+	CachedQuery(Signature include, Signature exclude) : include(include), exclude(exclude) {}
+
+	bool matches(Signature signature) { return (signature & include) == include && (signature & exclude).none(); }
+
+	/**
+	 * @brief Updates an Entity's membership when its Signature changes.
+	 *
+	 * @param e - an Entity
+	 * @param signature - the new Signature of \a e
+	 */
+	void update(Entity e, Signature signature) {
+		if (matches(signature)) entities.insert(e);
+		else entities.erase(e);
+	}
+};
+
+/**
+ * @brief An object that manages the cached queries of a Scene.
+ */
+class QueryManager {
+	std::vector<std::unique_ptr<CachedQuery>> queries;
+
+   public:
+	QueryManager() {}
+	DELETE_COPY_AND_ASSIGNMENT(QueryManager)
+
+	/**
+	 * @brief Finds a cached query.
+	 *
+	 * @param include - components the entities must have
+	 * @param exclude - components the entities must not have
+	 * @return CachedQuery* - the query or nullptr if it has not been created
+	 */
+	CachedQuery *find(Signature include, Signature exclude) {
+		for (auto &query : queries) {
+			if (query->include == include && query->exclude == exclude) return query.get();
+		}
+		return nullptr;
+	}
+
+	/**
+	 * @brief Creates a cached query. It starts empty, the caller must fill it.
+	 *
+	 * @param include - components the entities must have
+	 * @param exclude - components the entities must not have
+	 * @return CachedQuery* - the created query
+	 */
+	CachedQuery *create(Signature include, Signature exclude) {
+		queries.push_back(std::make_unique<CachedQuery>(include, exclude));
+		return queries.back().get();
+	}
+
+	/**
+	 * @brief Updates an Entity's Signature when it's components change
+	 *
+	 * @param e - an Entity
+	 * @param signature - a Signature
+	 */
+	void updateEntitySignature(Entity e, Signature signature) {
+		for (auto &query : queries) {
+			query->update(e, signature);
+		}
+	}
+
+	/**
+	 * @brief Destroys an Entity.
+	 *
+	 * @param e - an Entity
+	 */
+	void destroyEntity(Entity e) {
+		for (auto &query : queries) {
+			query->entities.erase(e);
+		}
+	}
+};
+
+/**
+ * @brief A range over the entities of a CachedQuery that yields each Entity together with references to its
+ * components. Example:
+ * @code
+ * for (auto [e, transform, renderer] : scene.view<Transformation, RendererComponent>()) { ... }
+ * @endcode
+ * Components must not be added or removed while iterating.
+ *
+ * @tparam T - the component types to yield
+ */
+template <class... T>
+class View {
+	CachedQuery							*query;
+	std::tuple<ComponentAccessor<T>...> accessors;
+
+	template <std::size_t... I>
+	std::tuple<Entity, T &...> get(Entity e, std::index_sequence<I...>) {
+		return std::tuple<Entity, T &...>(e, std::get<I>(accessors).get(e)...);
+	}
+
+   public:
+	class Iterator {
+		View								*view;
+		std::vector<Entity>::const_iterator it;
+
+	   public:
+		Iterator(View *view, std::vector<Entity>::const_iterator it) : view(view), it(it) {}
+
+		std::tuple<Entity, T &...> operator*() { return view->get(*it, std::index_sequence_for<T...>()); }
+		Iterator				  &operator++() {
+			 ++it;
+			 return *this;
+		}
+		bool operator!=(const Iterator &other) const { return it != other.it; }
+		bool operator==(const Iterator &other) const { return it == other.it; }
+	};
+
+	View(CachedQuery *query, ComponentAccessor<T>... accessors) : query(query), accessors(accessors...) {}
+
+	Iterator begin() { return Iterator(this, query->entities.begin()); }
+	Iterator end() { return Iterator(this, query->entities.end()); }
+
+	/**
+	 * @brief How many entities match the query.
+	 *
+	 * @return std::size_t
+	 */
+	std::size_t size() { return query->entities.size(); }
+
+	/**
+	 * @brief Calls \a f(e, components...) for every Entity in the View.
+	 *
+	 * @param f - a callable that accepts (Entity, T&...)
+	 */
+	template <class F>
+	void each(F &&f) {
+		for (Entity e : query->entities) {
+			std::apply(f, get(e, std::index_sequence_for<T...>()));
+		}
+	}
+};
+
 /**
  * @brief An Interface for a system in a scene
  *
  */
 class ISystem : public AppendableSerializable {
+	Signature			readAccess;				  ///< components the System reads in doWork()
+	Signature			writeAccess;			  ///< components the System writes in doWork()
+	std::set<ISystem *> readSystems;			  ///< other systems the System reads in doWork()
+	std::set<ISystem *> writeSystems;			  ///< other systems the System changes in doWork()
+	bool				accessDeclared = false;	  ///< if false, the System is assumed to access all components
+	bool				mainThreadOnly = true;	  ///< if the System must run on the main thread
+
+	template <class T>
+	void declareAccess(Signature &components, std::set<ISystem *> &systems);
+
+   protected:
+	/**
+	 * @brief Declares that doWork() reads components or systems of types \a T. The types must be registered in the
+	 * Scene. Systems that declare their access can run in parallel with systems whose access does not conflict with
+	 * theirs. Call this and writes<T...>() in init(). Calling it with no types declares that nothing is read.
+	 *
+	 * @tparam T - component or System types
+	 */
+	template <class... T>
+	void reads();
+
+	/**
+	 * @brief Declares that doWork() writes components or changes systems of types \a T, for example adds assets to the
+	 * AssetManager. The types must be registered in the Scene.
+	 * @see reads<T...>() .
+	 *
+	 * @tparam T - component or System types
+	 */
+	template <class... T>
+	void writes();
+
+	/**
+	 * @brief Allows doWork() to be called from a worker thread. Only for systems that do not use the OpenGL context and
+	 * do not create or destroy entities or components.
+	 */
+	void runOnWorkerThreads() { mainThreadOnly = false; }
+
    public:
 	std::set<Entity> entities;			  ///< entities that the System has access to
 	Scene			*scene = nullptr;	  ///< points to the Scene the System is assigned to
@@ -495,6 +1203,35 @@ class ISystem : public AppendableSerializable {
 	 * @brief prints all the entities that the system has access to.
 	 */
 	void printEntities();
+
+	Signature getReadAccess() { return readAccess; }
+	Signature getWriteAccess() { return writeAccess; }
+	bool	  hasDeclaredAccess() { return accessDeclared; }
+	bool	  isMainThreadOnly() { return mainThreadOnly; }
+
+	/**
+	 * @brief Checks if two systems must not run at the same time: one of them writes components or systems that the
+	 * other one reads or writes, one of them accesses the other one, or one of them has not declared its access.
+	 *
+	 * @param other - another System
+	 * @return true - if the systems conflict
+	 */
+	bool conflictsWith(ISystem *other) {
+		if (!accessDeclared || !other->accessDeclared) return true;
+		if ((writeAccess & (other->readAccess | other->writeAccess)).any() || (other->writeAccess & readAccess).any())
+			return true;
+		// a System may change its own state in doWork()
+		if (readSystems.contains(other) || writeSystems.contains(other) || other->readSystems.contains(this) ||
+			other->writeSystems.contains(this))
+			return true;
+		for (ISystem *system : writeSystems) {
+			if (other->readSystems.contains(system) || other->writeSystems.contains(system)) return true;
+		}
+		for (ISystem *system : other->writeSystems) {
+			if (readSystems.contains(system)) return true;
+		}
+		return false;
+	}
 };
 
 /**
@@ -502,8 +1239,10 @@ class ISystem : public AppendableSerializable {
  *
  */
 class SystemManager {
-	std::unordered_map<const char *, ISystem *> systems;		///< map system type name to a system
-	std::unordered_map<const char *, Signature> signatures;		///< map system type name to its Signature
+	std::unordered_map<const char *, ISystem *> systems;			 ///< map system type name to a system
+	std::unordered_map<const char *, Signature> signatures;			 ///< map system type name to its Signature
+	std::vector<ISystem *>						order;				 ///< the systems in order of registration
+	bool										parallel = true;	 ///< run systems on the ThreadPool if possible
 
    public:
 	SystemManager() {}
@@ -531,6 +1270,7 @@ class SystemManager {
 
 		T *sys = new T(scene, args...);
 		systems.insert({type, sys});
+		order.push_back(sys);
 		return sys;
 	}
 
@@ -648,13 +1388,20 @@ class SystemManager {
 	}
 
 	/**
-	 * @brief Makes all systems do their work
+	 * @brief Makes all systems do their work. Systems run after all conflicting systems that were registered before
+	 * them. Non-conflicting systems that allow it run in parallel on the default ThreadPool, all others run on the
+	 * calling thread.
+	 * @see ISystem::conflictsWith() .
 	 */
-	void doWork() {
-		for (auto &t : this->systems) {
-			t.second->doWork();
-		}
-	}
+	void doWork();
+
+	/**
+	 * @brief Enables or disables running systems on worker threads. When disabled, systems run one after another in
+	 * order of registration.
+	 *
+	 * @param parallel - true to enable
+	 */
+	void setParallel(bool parallel) { this->parallel = parallel; }
 };
 
 /**
@@ -669,6 +1416,19 @@ class Scene : public ygl::AppendableSerializable {
 	ComponentManager componentManager;
 	EntityManager	 entityManager;
 	SystemManager	 systemManager;
+	QueryManager	 queryManager;
+
+	/**
+	 * @brief Notifies the systems and the cached queries that an Entity's Signature has changed.
+	 *
+	 * @param e - an Entity
+	 * @param signature - the new Signature of \a e
+	 */
+	void updateEntitySignature(Entity e, Signature signature) {
+		entityManager.setSignature(e, signature);
+		systemManager.updateEntitySignature(e, signature);
+		queryManager.updateEntitySignature(e, signature);
+	}
 
    public:
 	Scene(const Scene &other)			 = delete;
@@ -683,6 +1443,15 @@ class Scene : public ygl::AppendableSerializable {
 	 */
 	Scene() {}
 
+	/**
+	 * @brief Construct an empty Scene that stores its components in a specific way.
+	 *
+	 * @param storage - how the components are stored
+	 */
+	explicit Scene(ComponentStorage storage) {
+		if (storage == ComponentStorage::ARCHETYPES) componentManager.useArchetypes();
+	}
+
 	/**
 	 * @brief Create an Entity.
 	 *
@@ -703,6 +1472,7 @@ class Scene : public ygl::AppendableSerializable {
 		componentManager.deleteEntity(e);
 		entityManager.destroyEntity(e);
 		systemManager.destroyEntity(e);
+		queryManager.destroyEntity(e);
 		entities.erase(e);
 	}
 
@@ -755,8 +1525,7 @@ class Scene : public ygl::AppendableSerializable {
 
 		auto signature = entityManager.getSignature(e);
 		signature.set(componentManager.getComponentType<T>(), true);
-		entityManager.setSignature(e, signature);
-		systemManager.updateEntitySignature(e, signature);
+		updateEntitySignature(e, signature);
 
 		return res;
 	}
@@ -787,10 +1556,54 @@ class Scene : public ygl::AppendableSerializable {
 
 		auto signature = entityManager.getSignature(e);
 		signature.set(componentManager.getComponentType<T>(), false);
-		entityManager.setSignature(e, signature);
-		systemManager.updateEntitySignature(e, signature);
+		updateEntitySignature(e, signature);
+	}
+
+	/**
+	 * @brief Calls \a f(e, a, b, ...) for every Entity \a e that has components of all types \a T.
+	 * @see ComponentManager::forEach() .
+	 *
+	 * @tparam T - component types
+	 * @param f - a callable that accepts (Entity, T&...)
+	 */
+	template <class... T, class F>
+	void forEach(F &&f) {
+		componentManager.forEach<T...>(std::forward<F>(f));
 	}
 
+	/**
+	 * @brief Get a View over all entities that have components \a T and none of the components \a E. The matching
+	 * entities are cached on the first call and kept up to date as components are added and removed, so getting a
+	 * View again is cheap.
+	 *
+	 * @tparam T - component types the entities must have
+	 * @tparam E - component types the entities must not have
+	 * @return View<T...> - a range that yields (Entity, T&...)
+	 */
+	template <class... T, class... E>
+		requires(IsComponent<T> && ...)
+	View<T...> view(Exclude<E...> = {}) {
+		Signature include, exclude;
+		(include.set(componentManager.getComponentType<T>()), ...);
+		(exclude.set(componentManager.getComponentType<E>()), ...);
+
+		CachedQuery *query = queryManager.find(include, exclude);
+		if (query == nullptr) {
+			query = queryManager.create(include, exclude);
+			for (Entity e : entities) {
+				query->update(e, entityManager.getSignature(e));
+			}
+		}
+		return View<T...>(query, componentManager.getAccessor<T>()...);
+	}
+
+	/**
+	 * @brief Checks if the Scene stores its components in archetypes.
+	 *
+	 * @return true - if the Scene was constructed with ComponentStorage::ARCHETYPES
+	 */
+	bool usesArchetypes() { return componentManager.usesArchetypes(); }
+
 	/**
 	 * @brief Get the Signature of an Entity.
 	 *
@@ -895,9 +1708,18 @@ class Scene : public ygl::AppendableSerializable {
 
 	/**
 	 * @brief Makes all Systems do their work
+	 * @see SystemManager::doWork() .
 	 */
 	void doWork();
 
+	/**
+	 * @brief Enables or disables running systems in parallel.
+	 * @see SystemManager::setParallel() .
+	 *
+	 * @param parallel - true to enable
+	 */
+	void setParallelSystems(bool parallel) { systemManager.setParallel(parallel); }
+
 	/**
 	 * @brief How many entities does the Scene have
 	 *
@@ -911,7 +1733,28 @@ class Scene : public ygl::AppendableSerializable {
 	}
 };
 
-// this definition is outside the class because it uses a method from Scene
+// these definitions are outside the class because they use methods from Scene
+template <class T>
+void ygl::ISystem::declareAccess(Signature &components, std::set<ISystem *> &systems) {
+	if constexpr (IsSystem<T>) {
+		if (ISystem *system = scene->getSystem<T>()) systems.insert(system);
+	} else {
+		components.set(scene->getComponentType<T>());
+	}
+}
+
+template <class... T>
+void ygl::ISystem::reads() {
+	accessDeclared = true;
+	(declareAccess<T>(readAccess, readSystems), ...);
+}
+
+template <class... T>
+void ygl::ISystem::writes() {
+	accessDeclared = true;
+	(declareAccess<T>(writeAccess, writeSystems), ...);
+}
+
 template <class T>
 	requires IsComponent<T>
 Serializable &ygl::ComponentArray<T>::readComponent(Entity e, std::istream &in, Scene *scene) {
@@ -53,6 +53,28 @@ class GrassSystem : public ygl::ISystem {
 
 	unsigned int materialIndex = -1;
 
+	// set for every grass holder each frame
+	struct {
+		Uniform<float>		time			  = Uniform<float>("time");
+		Uniform<glm::ivec2>	resolution		  = Uniform<glm::ivec2>("resolution");
+		Uniform<glm::vec2>	size			  = Uniform<glm::vec2>("size");
+		Uniform<glm::mat4>	anchorWorldMatrix = Uniform<glm::mat4>("anchorWorldMatrix");
+		Uniform<uint>		LOD				  = Uniform<uint>("LOD");
+	} computeUniforms;
+	struct {
+		Uniform<float>	   time			  = Uniform<float>("time");
+		Uniform<bool>	   useSkybox	  = Uniform<bool>("use_skybox");
+		Uniform<bool>	   useShadow	  = Uniform<bool>("use_shadow");
+		Uniform<glm::mat4> worldMatrix	  = Uniform<glm::mat4>("worldMatrix");
+		Uniform<uint>	   renderMode	  = Uniform<uint>("renderMode");
+		Uniform<uint>	   materialIndex  = Uniform<uint>("material_index");
+		Uniform<float>	   curvature	  = Uniform<float>("curvature");
+		Uniform<float>	   facingOffset	  = Uniform<float>("facingOffset");
+		Uniform<float>	   height		  = Uniform<float>("height");
+		Uniform<float>	   width		  = Uniform<float>("width");
+		Uniform<uint>	   bladeTriangles = Uniform<uint>("blade_triangles");
+	} renderUniforms;
+
    public:
 	static const char *name;
 	struct GrassHolder : public ygl::Serializable {
@@ -103,7 +125,9 @@ class GrassSystem : public ygl::ISystem {
 std::ostream &operator<<(std::ostream &out, const ygl::GrassSystem::GrassHolder &rhs);
 
 class FXAAEffect : public IScreenEffect {
-	int fxaaShader;
+	int				   fxaaShader;
+	Uniform<bool>	   fxaaOn	 = Uniform<bool>("u_fxaaOn");
+	Uniform<glm::vec2> texelStep = Uniform<glm::vec2>("u_texelStep");
 
    public:
 	FXAAEffect(Renderer *renderer) : IScreenEffect() {
@@ -120,13 +144,37 @@ class FXAAEffect : public IScreenEffect {
 
 		Shader *shader = renderer->getAssetManager()->getShader(fxaaShader);
 		shader->bind();
-		shader->setUniform("u_fxaaOn", enabled);
-		shader->setUniform(
-			"u_texelStep",
-			glm::vec2(1.f / renderer->getWindow()->getWidth(), 1.f / renderer->getWindow()->getHeight()) * 1.f);
+		fxaaOn.set(shader, enabled);
+		Window *window = renderer->getWindow();
+		texelStep.set(shader, glm::vec2(1.f / window->getWidth(), 1.f / window->getHeight()));
 		Renderer::drawObject(shader, renderer->getScreenQuad());
 		front->getColor()->unbind(GL_TEXTURE7);
 	}
 };
 
+/**
+ * @brief Darkens the screen towards its corners. Exists only as a part of the fused shader.
+ */
+class VignetteEffect : public IScreenEffect {
+	Uniform<float> strengthUniform = Uniform<float>("vignetteStrength");
+	Uniform<float> radiusUniform   = Uniform<float>("vignetteRadius");
+	Uniform<float> softnessUniform = Uniform<float>("vignetteSoftness");
+
+   public:
+	float strength = 0.5;	  ///< how dark the corners get, 1 for black
+	float radius   = 0.5;	  ///< distance from the center where it starts getting darker, 1 is a corner
+	float softness = 0.5;	  ///< distance over which it gets darker
+
+	VignetteEffect(Renderer *renderer) : IScreenEffect() { setRenderer(renderer); }
+	void apply(FrameBuffer *front, FrameBuffer *back) override { applyFused(front, back); }
+
+	FusedStage getFusedStage() override { return VIGNETTE; }
+
+	void setFusedUniforms(Shader *shader) override {
+		strengthUniform.set(shader, strength);
+		radiusUniform.set(shader, radius);
+		softnessUniform.set(shader, softness);
+	}
+};
+
 }	  // namespace ygl
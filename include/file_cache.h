@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @file file_cache.h
+ * @brief On-disk cache for data that is expensive to produce, like imported meshes.
+ */
+
+namespace ygl {
+/**
+ * @brief Helpers for storing files in the cache directory. Each kind of data has its own subdirectory and every entry
+ * is a file named after a 64-bit key. Users are responsible for validating the contents of the entries they read.
+ */
+namespace cache {
+
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;	  ///< initial value for hash()
+
+/**
+ * @brief FNV-1a hash of a block of memory.
+ *
+ * @param data - the data to hash
+ * @param size - size of \a data in bytes
+ * @param seed - the result of a previous hash() call to combine with
+ * @return uint64_t
+ */
+uint64_t hash(const void *data, std::size_t size, uint64_t seed = HASH_SEED);
+
+/**
+ * @brief FNV-1a hash of a string.
+ * @see hash(const void *, std::size_t, uint64_t) .
+ */
+uint64_t hash(const std::string &str, uint64_t seed = HASH_SEED);
+
+/**
+ * @brief Hashes the contents of a file. The hash is remembered with the size and modification time of the file, so
+ * the file is read again only when one of them changes.
+ *
+ * @param path - path to the file
+ * @param result [out] - the hash combined with \a result
+ * @return true - if the file could be read
+ */
+bool hashFile(const std::string &path, uint64_t &result);
+
+/**
+ * @brief Enables or disables the cache. When disabled getFilePath() returns an empty string. Enabled by default, except
+ * on the web where there is no persistent file system.
+ *
+ * @param enabled - true to enable
+ */
+void setEnabled(bool enabled);
+bool isEnabled();
+
+/**
+ * @brief Sets the directory that holds the cache. Defaults to "./.ygl_cache/".
+ *
+ * @param directory - path to the directory
+ */
+void setDirectory(const std::string &directory);
+
+/**
+ * @brief Get the path to the cache entry for \a key. Creates the directory for \a category if it does not exist.
+ *
+ * @param category - name of the subdirectory, for example "meshes"
+ * @param key - the key of the entry
+ * @param extension - file extension, including the dot
+ * @return std::string - the path, or an empty string if the cache is disabled or the directory can't be created
+ */
+std::string getFilePath(const std::string &category, uint64_t key, const std::string &extension);
+
+/**
+ * @brief Moves a fully written temporary file to its place in the cache, so that other processes never read a
+ * partially written entry.
+ *
+ * @param tempPath - the written file
+ * @param path - path returned by getFilePath()
+ * @return true - on success
+ */
+bool commitFile(const std::string &tempPath, const std::string &path);
+
+}	  // namespace cache
+}	  // namespace ygl
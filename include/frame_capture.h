@@ -0,0 +1,97 @@
+#pragma once
+
+#include <yoghurtgl.h>
+#include <thread_pool.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+/**
+ * @file frame_capture.h
+ * @brief Reading back the framebuffer without stalling the GPU
+ */
+
+namespace ygl {
+
+/**
+ * @brief Captures parts of the framebuffer asynchronously. glReadPixels writes to one of a ring of pixel buffer
+ * objects, which returns immediately, and the buffer is read a frame or two later when the GPU is done with it. The
+ * pixels are then passed to a callback on an encoder thread, so writing image files does not slow down rendering
+ * either. A capture waits only when all buffers are still in flight or too many frames wait to be encoded, so no
+ * frames are dropped when capturing every frame.
+ */
+class FrameCapture {
+   public:
+	/// receives the RGBA8 pixels of a capture on the encoder thread, bottom row first as OpenGL reads them
+	using Callback = std::function<void(uint width, uint height, std::vector<uint8_t> &pixels)>;
+
+   private:
+	struct Slot {
+		GLuint	   buffer = 0;
+		GLsizeiptr size	  = 0;
+		GLsync	   fence  = nullptr;	 ///< signaled when the pixels are in the buffer
+		uint	   width  = 0;
+		uint	   height = 0;
+		uint	   age	  = 0;			 ///< polls since the capture, used when there are no fences
+		bool	   busy	  = false;
+		Callback   callback;
+	};
+
+	std::vector<Slot>			  slots;
+	uint						  next = 0;		///< the slot of the next capture, the oldest one when all are busy
+	ThreadPool					  encoder;
+	std::deque<std::future<void>> encoding;
+	std::size_t					  maxEncoding = 2;	   ///< encodes that can be pending before a capture waits
+
+	bool isReady(Slot &slot, bool wait);
+	void finish(Slot &slot);
+
+   public:
+	/**
+	 * @param buffersCount - number of captures that can be in flight at the same time
+	 */
+	FrameCapture(uint buffersCount = 3);
+	~FrameCapture();
+	DELETE_COPY_AND_ASSIGNMENT(FrameCapture)
+
+	/**
+	 * @brief Starts reading a rectangle of the framebuffer that is bound for reading.
+	 *
+	 * @param callback - called with the pixels on the encoder thread once they have been read
+	 */
+	void capture(GLint x, GLint y, GLsizei width, GLsizei height, Callback callback);
+	/**
+	 * @brief Starts reading a rectangle of the framebuffer that is bound for reading and saves it to an image file.
+	 *
+	 * @param fileName - the file to write, .jpg, .bmp and .tga files are written in their format, all others as PNG
+	 */
+	void capture(GLint x, GLint y, GLsizei width, GLsizei height, const std::string &fileName);
+	/**
+	 * @brief Passes the captures that the GPU has finished to the encoder. Never waits, should be called once every
+	 * frame.
+	 */
+	void poll();
+	/**
+	 * @brief Waits for all captures to be read and encoded.
+	 */
+	void flush();
+
+	/**
+	 * @brief Get the number of captures that have not been passed to their callback yet.
+	 */
+	std::size_t getPendingCount();
+
+	/**
+	 * @brief Writes RGBA8 pixels with the bottom row first to an image file. Safe to call from any thread.
+	 *
+	 * @param fileName - the file to write, the format is chosen by its extension like in capture()
+	 * @param pixels - the pixels, their rows are flipped in place to the top row first
+	 * @return true - if the file has been written
+	 */
+	static bool writeImage(const std::string &fileName, uint width, uint height, std::vector<uint8_t> &pixels);
+};
+
+}	  // namespace ygl
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <yoghurtgl.h>
+#include <cstdint>
+
+/**
+ * @file gl_state.h
+ * @brief A cache of the OpenGL state that skips redundant calls
+ */
+
+namespace ygl {
+
+/**
+ * @brief Shadows the OpenGL state that changes between draws: the program, the VAO and the attributes enabled in it,
+ * buffer and texture bindings, blending, depth testing, face culling, polygon mode and line width. A call that would
+ * set the value that is already set never reaches the driver. All code in the engine changes this state through
+ * GLState, code that calls OpenGL directly has to call invalidate() afterwards. Assumes a single GL context.
+ */
+class GLState {
+   public:
+	/// counts of requests since the last resetStats()
+	struct Stats {
+		uint64_t issued	 = 0;	  ///< requests that reached OpenGL
+		uint64_t skipped = 0;	  ///< requests that would not have changed anything
+	};
+
+	static constexpr GLuint MAX_TEXTURE_UNITS = 32;
+
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vao);
+	/**
+	 * @brief Enables an attribute of the bound VAO. The enabled attributes are remembered for each VAO, so enabling the
+	 * same ones on every bind costs nothing.
+	 *
+	 * @param location - location of the attribute
+	 */
+	static void enableVertexAttribArray(GLuint location);
+	static void disableVertexAttribArray(GLuint location);
+	/**
+	 * @brief Binds \a buffer to \a target. GL_ELEMENT_ARRAY_BUFFER belongs to the VAO and is always bound.
+	 */
+	static void bindBuffer(GLenum target, GLuint buffer);
+	/**
+	 * @brief Binds \a buffer to an indexed binding point. Always issued, only the generic binding of \a target, which
+	 * glBindBufferBase changes too, is cached.
+	 */
+	static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	/**
+	 * @brief Binds a range of \a buffer to an indexed binding point, see bindBufferBase().
+	 */
+	static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	/**
+	 * @brief Makes \a unit the active texture unit. Has to be called before functions that work on the bound texture,
+	 * since bindTexture() leaves the active unit unchanged when it skips the bind.
+	 *
+	 * @param unit - GL_TEXTURE0 + index of the unit
+	 */
+	static void activeTexture(GLenum unit);
+	/**
+	 * @brief Binds \a texture to \a target of a texture unit.
+	 *
+	 * @param unit - GL_TEXTURE0 + index of the unit
+	 * @param target - GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, etc.
+	 * @param texture - the texture, 0 to unbind
+	 */
+	static void bindTexture(GLenum unit, GLenum target, GLuint texture);
+
+	/**
+	 * @brief glEnable or glDisable. GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_STENCIL_TEST are cached, other
+	 * capabilities are always set.
+	 */
+	static void setCapability(GLenum capability, bool enabled);
+	static void enable(GLenum capability) { setCapability(capability, true); }
+	static void disable(GLenum capability) { setCapability(capability, false); }
+	static void depthFunc(GLenum func);
+	static void depthMask(bool mask);
+	static void blendFunc(GLenum sfactor, GLenum dfactor);
+	static void polygonMode(GLenum mode);
+	static void lineWidth(GLfloat width);
+
+	// deleting an object unbinds it and its name can be reused, so the cache has to forget it
+	static void deleteProgram(GLuint program);
+	static void deleteVertexArray(GLuint vao);
+	static void deleteBuffer(GLuint buffer);
+	static void deleteTexture(GLuint texture);
+
+	/**
+	 * @brief Forgets the cached state, the next request for each value reaches OpenGL. The attributes enabled in each
+	 * VAO are kept, only the engine changes them.
+	 */
+	static void invalidate();
+
+	static const Stats &getStats();
+	static void			resetStats();
+};
+
+}	  // namespace ygl
@@ -6,10 +6,12 @@
 #include <ostream>
 #include <vector>
 #include <unordered_map>
+#include <cmath>
 
 #include <glm/glm.hpp>
 #include <string>
 #include <buffer.h>
+#include <gl_state.h>
 #include <material.h>
 #include <serializable.h>
 
@@ -43,8 +45,20 @@ class IMesh : public ISerializable {
 	bool   cullFace	   = true;
 	uint   lineWidth   = 1;
 
+	glm::vec3 boundsMin		 = glm::vec3(-INFINITY);			 ///< minimum corner of the local-space AABB
+	glm::vec3 boundsMax		 = glm::vec3(INFINITY);				 ///< maximum corner of the local-space AABB
+	glm::vec4 boundingSphere = glm::vec4(0, 0, 0, INFINITY);	 ///< center and radius in local space
+
 	GLuint createVAO();
 	GLuint createIBO(GLuint *data, int size);
+	/**
+	 * @brief Computes the local-space AABB and bounding sphere from the vertex positions. Meshes that never call it
+	 * have infinite bounds and are never culled.
+	 *
+	 * @param positions - \a count tightly packed vec3 positions
+	 * @param count - number of vertices
+	 */
+	void computeBounds(const GLfloat *positions, GLuint count);
 
 	IMesh() {};		// protected constructor so that noone can instantiate this
 	IMesh(std::istream &in);
@@ -71,6 +85,10 @@ class IMesh : public ISerializable {
 	bool   getCullFace() const;
 	uint   getLineWidth() const;
 
+	const glm::vec3 &getBoundsMin() const { return boundsMin; }
+	const glm::vec3 &getBoundsMax() const { return boundsMax; }
+	const glm::vec4 &getBoundingSphere() const { return boundingSphere; }
+
 	void setDrawMode(GLenum drawMode);
 	void setCullFace(bool cullFace);
 	void setDepthFunc(GLenum depthFunc);
@@ -125,7 +143,7 @@ void MultiBufferMesh::addVBO(GLuint attrLocation, GLuint coordSize, T *data, GLe
 							 GLuint indexDivisor) {
 	GLuint buff;
 	glGenBuffers(1, &buff);
-	glBindBuffer(GL_ARRAY_BUFFER, buff);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, buff);
 	glBufferData(GL_ARRAY_BUFFER, count * sizeof(T) * coordSize, data, GL_STATIC_DRAW);
 	addVBO(attrLocation, coordSize, buff, type, indexDivisor);
 }
@@ -262,9 +280,48 @@ class PlaneMesh : public Mesh {
 class AssetManager;
 
 class MeshFromFile : public AnimatedMesh {
-	std::string path;
-	uint		index;
-	void		init(const std::string &path, uint index);
+	/// texture maps of a material: normal, roughness, ao, metallic, diffuse, emissive, opacity
+	static constexpr uint MATERIAL_MAPS = 7;
+
+	/**
+	 * @brief The properties of a material as read from the file. Creating the Material also loads its textures.
+	 */
+	struct MaterialData {
+		bool		present = false;	 ///< false if the file has no materials
+		glm::vec3	albedo, emission, specular, transparent;
+		float		roughness = 1, ior = 1;
+		std::string maps[MATERIAL_MAPS];	 ///< file of each texture map, empty if the material does not use it
+	};
+
+	/**
+	 * @brief The final vertex streams of a mesh, ready to be sent to the GPU. Missing streams are empty.
+	 */
+	struct Data {
+		uint32_t									  verticesCount = 0;
+		std::vector<GLfloat>						  vertices, normals, texCoords, colors, tangents;
+		std::vector<GLint>							  boneIDs;
+		std::vector<GLfloat>						  weights;
+		std::vector<GLuint>							  indices;
+		std::vector<std::pair<std::string, BoneInfo>> bones;
+		uint32_t									  meshesCount = 0;	   ///< in the whole file
+		MaterialData								  material;
+	};
+
+	/// version of the mesh cache file format, increment it when the format or the import code changes
+	static constexpr uint32_t CACHE_VERSION = 2;
+
+	std::string	 path;
+	uint		 index;
+	uint		 meshesCount = 0;
+	MaterialData material;
+	void		 init(const std::string &path, uint index);
+
+	static void			importData(const std::string &path, uint index, Data &data);
+	static uint64_t		getCacheKey(const std::string &path, uint index);
+	static bool			readCache(const std::string &cacheFile, uint64_t key, Data &data);
+	static void			writeCache(const std::string &cacheFile, uint64_t key, const Data &data);
+	static MaterialData readMaterial(const aiScene *, const std::string &filePath, uint i);
+	static Material		createMaterial(const MaterialData &data, AssetManager *asman);
 
 	static const aiScene	*loadScene(const std::string &file, unsigned int flags);
 	static const aiScene	*loadScene(const std::string &file);
@@ -283,6 +340,15 @@ class MeshFromFile : public AnimatedMesh {
 
 	void serialize(std::ostream &out) override;
 
+	/// number of meshes in the file this mesh was loaded from, 0 if loading failed
+	uint getMeshesCount() const { return meshesCount; }
+	/**
+	 * @brief Creates the material of this mesh. Works without importing the file when the mesh came from the cache.
+	 *
+	 * @param asman - AssetManager to load the textures of the material in
+	 */
+	Material getMaterial(AssetManager *asman) const;
+
 	static int import_flags;
 };
 
@@ -429,7 +495,7 @@ class InstancedMesh : public IMesh {
 		int location	 = std::max(maxAttribLocation + 1, 7);
 		int buffersCount = (sizeof(InstanceData) + 15) / 16;	 // assuming InstanceData is 16-byte aligned
 		instanceData.bind(GL_ARRAY_BUFFER);
-		glBindVertexArray(this->getVAO());
+		GLState::bindVertexArray(this->getVAO());
 		for (int i = 0; i < buffersCount; ++i) {
 			glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
 								  (void *)(i * 4 * sizeof(GLfloat)));
@@ -438,7 +504,7 @@ class InstancedMesh : public IMesh {
 			dbLog(ygl::LOG_DEBUG, "InstancedMesh: added VBO with location ", location + i, " and buffer ID ",
 				  instanceData.getID(), " for InstanceData.");
 		}
-		glBindVertexArray(0);
+		GLState::bindVertexArray(0);
 		instanceData.unbind();
 	};
 
@@ -448,12 +514,12 @@ class InstancedMesh : public IMesh {
 
 	void enableVBOs() const override {
 		for (VBO vbo : vbos) {
-			glEnableVertexAttribArray(vbo.location);
+			GLState::enableVertexAttribArray(vbo.location);
 		}
 	}
 	void disableVBOs() const override {
 		for (VBO vbo : vbos) {
-			glDisableVertexAttribArray(vbo.location);
+			GLState::disableVertexAttribArray(vbo.location);
 		}
 	}
 
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <yoghurtgl.h>
+#include <buffer.h>
+#include <mesh.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @file mesh_pool.h
+ * @brief Vertex and index storage shared by many meshes
+ */
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+namespace ygl {
+
+/**
+ * @brief Copies the vertex attributes and indices of meshes into shared buffers, so that all of them can be drawn with
+ * a single VAO and glMultiDrawElementsIndirect. Only the attributes of Mesh are kept (position, normal, texture
+ * coordinates, color and tangent). Meshes that are not triangle meshes with the default render state are not accepted
+ * and have to be drawn on their own.
+ */
+class MeshPool {
+   public:
+	/// a mesh in the pool, laid out the way the culling shader reads it
+	struct Entry {
+		GLuint	  indicesCount;
+		GLuint	  firstIndex;
+		GLint	  baseVertex;
+		GLuint	  padding;
+		glm::vec4 boundingSphere;	  ///< center in model space and radius
+	};
+
+	/// layout of the commands read by glMultiDrawElementsIndirect
+	struct DrawCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint  baseVertex;
+		GLuint baseInstance;
+	};
+
+	static constexpr GLuint INVALID = -1;
+
+   private:
+	static constexpr uint ATTRIBUTES_COUNT = 5;
+
+	GLuint			   vao = 0;
+	MutableBuffer	   attributes[ATTRIBUTES_COUNT];
+	MutableBuffer	   indices;
+	MutableBuffer	   entriesBuffer;
+	std::vector<Entry> entries;
+
+	GLuint verticesCount	= 0;
+	GLuint verticesCapacity = 0;
+	GLuint indicesCount		= 0;
+	GLuint indicesCapacity	= 0;
+	bool   entriesChanged	= false;
+
+	void reserve(GLuint newVerticesCapacity, GLuint newIndicesCapacity);
+	void attachAttributes();
+
+   public:
+	DELETE_COPY_AND_ASSIGNMENT(MeshPool)
+
+	MeshPool(GLuint initialVertices = 1 << 16, GLuint initialIndices = 1 << 18);
+	~MeshPool();
+
+	/**
+	 * @brief Checks if \a mesh can be added to the pool.
+	 */
+	static bool canAdd(IMesh *mesh);
+
+	/**
+	 * @brief Copies \a mesh into the pool. The copy is done on the GPU and the bounding sphere is taken from the mesh.
+	 * The pool grows when it runs out of space.
+	 *
+	 * @param mesh - the mesh to copy
+	 * @return GLuint - index of the entry of the mesh, or INVALID if the mesh can't be pooled
+	 */
+	GLuint add(IMesh *mesh);
+
+	const Entry &getEntry(GLuint index) const { return entries[index]; }
+	std::size_t	 size() const { return entries.size(); }
+
+	/**
+	 * @brief Get the buffer with all entries, for use as an SSBO. Uploads entries added since the last call.
+	 */
+	GLuint getEntriesBuffer();
+
+	/**
+	 * @brief Binds the shared VAO and index buffer and sets the render state that all pooled meshes use.
+	 */
+	void bind() const;
+	void unbind() const;
+};
+
+}	  // namespace ygl
+#endif
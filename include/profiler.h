@@ -0,0 +1,161 @@
+#pragma once
+
+#include <yoghurtgl.h>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @file profiler.h
+ * @brief Measuring what the parts of a frame cost on the CPU and on the GPU
+ */
+
+namespace ygl {
+
+/**
+ * @brief Measures named scopes of a frame on the CPU with a clock and on the GPU with timestamp queries. The queries
+ * of a frame are read a few frames later, when the GPU is done with them, so measuring does not make the CPU wait.
+ * Scopes can be nested, the GPU time of a scope is the time between the commands issued before and after it. Keeps
+ * the times of the last frames for each scope name and can record a trace for chrome://tracing or Perfetto.
+ */
+class Profiler {
+   public:
+	/// number of frames the statistics are over
+	static constexpr uint HISTORY_SIZE = 120;
+
+	struct Stats {
+		std::string name;
+		uint		depth			  = 0;		///< nesting depth of the scope when it was last seen
+		float		cpu[HISTORY_SIZE] = {};		///< milliseconds of the last frames, the oldest at \a next
+		float		gpu[HISTORY_SIZE] = {};
+		uint		next			  = 0;
+		uint		count			  = 0;		///< number of frames in the history, up to HISTORY_SIZE
+		uint64_t	lastFrame		  = 0;
+
+		float getCpuAverage() const;
+		float getGpuAverage() const;
+		float getCpuMax() const;
+		float getGpuMax() const;
+	};
+
+   private:
+	struct Sample {
+		const char *name;
+		uint		depth;
+		uint64_t	cpuBegin, cpuEnd;
+		uint		queries[2];		///< indices of the timestamps at the begin and the end in the frame
+	};
+
+	struct Frame {
+		std::vector<Sample> samples;
+		std::vector<GLuint> queries;
+		uint				usedQueries = 0;
+		int64_t				gpuOffset	= 0;		 ///< CPU time minus GPU time when the frame began, for traces
+		uint64_t			index		= 0;
+		bool				pending		= false;	 ///< ended and not collected yet
+		bool				traced		= false;
+	};
+
+	struct TraceEvent {
+		std::string name;
+		bool		gpu;
+		int64_t		begin;	   ///< nanoseconds on the CPU clock
+		uint64_t	duration;
+	};
+
+	bool								  gpuTimers;
+	std::vector<Frame>					  frames;
+	uint								  current	 = 0;
+	uint64_t							  frameIndex = 0;
+	std::vector<uint>					  open;		 ///< samples of the current frame that have not ended
+	std::vector<Stats>					  stats;	 ///< in the order in which the scopes were first seen
+	std::unordered_map<std::string, uint> statsIndices;
+
+	bool					tracing	   = false;
+	uint64_t				traceBegin = 0;
+	std::vector<TraceEvent> trace;
+
+	void beginFrame();
+	void syncClocks(Frame &frame);
+	uint issueTimestamp(Frame &frame);
+	bool isReady(Frame &frame, bool wait);
+	void collect(Frame &frame);
+
+   public:
+	/**
+	 * @param gpuTimers - whether to measure on the GPU too, needs timestamp queries and a context
+	 * @param framesInFlight - number of frames of queries that can wait for the GPU at the same time
+	 */
+	Profiler(bool gpuTimers = true, uint framesInFlight = 3);
+	~Profiler();
+	DELETE_COPY_AND_ASSIGNMENT(Profiler)
+
+	/**
+	 * @brief Starts measuring a scope. Every begin() needs an end() in the same frame.
+	 *
+	 * @param name - name of the scope, has to outlive the profiler, a string literal for example. Scopes with the same
+	 * name in one frame are added together.
+	 */
+	void begin(const char *name);
+	/**
+	 * @brief Ends the scope that began last.
+	 */
+	void end();
+	/**
+	 * @brief Ends the frame and adds the earlier frames that the GPU has finished to the statistics. Never waits,
+	 * unless all frames are still in flight.
+	 */
+	void endFrame();
+	/**
+	 * @brief Waits for the GPU and adds all ended frames to the statistics.
+	 */
+	void flush();
+
+	const std::vector<Stats> &getStats() const { return stats; }
+	/**
+	 * @brief Get the statistics of a scope, nullptr if it has not been measured yet.
+	 */
+	const Stats *getStats(const std::string &name) const;
+	bool		 hasGpuTimers() const { return gpuTimers; }
+
+	/**
+	 * @brief Starts recording all scopes of the following frames for a trace. Clears an earlier recording.
+	 */
+	void startTrace();
+	/**
+	 * @brief Stops recording. The frames that the GPU has not finished yet are still added to the trace.
+	 */
+	void stopTrace() { tracing = false; }
+	bool isTracing() const { return tracing; }
+	/**
+	 * @brief Writes the recorded trace in the Chrome trace event format, CPU and GPU times on separate threads.
+	 */
+	void writeTrace(std::ostream &out) const;
+	/**
+	 * @brief Writes the recorded trace to a file that chrome://tracing and Perfetto can open.
+	 *
+	 * @return true - if the file has been written
+	 */
+	bool saveTrace(const std::string &fileName) const;
+
+	/**
+	 * @brief Draws a window with a table of the average and maximum time of each scope.
+	 */
+	void drawGui();
+
+	/**
+	 * @brief Measures from its construction to the end of its block.
+	 */
+	class Scope {
+		Profiler &profiler;
+
+	   public:
+		Scope(Profiler &profiler, const char *name) : profiler(profiler) { profiler.begin(name); }
+		~Scope() { profiler.end(); }
+		DELETE_COPY_AND_ASSIGNMENT(Scope)
+	};
+};
+
+}	  // namespace ygl
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @file render_queue.h
+ * @brief A list of draws sorted so that draws which share GPU state are submitted together.
+ */
+
+namespace ygl {
+
+class Transformation;
+
+/**
+ * @brief Collects the draws of a frame with a 64-bit sort key each and sorts them with a radix sort. From the most
+ * significant bits the key holds the pass, the shader, the material, the mesh and the depth, so draws of the same pass
+ * come together, then draws with the same shader and so on. Indices that do not fit in their field only make the order
+ * less optimal, since the draws keep the full indices.
+ */
+class RenderQueue {
+   public:
+	/// everything needed to submit a draw
+	struct Draw {
+		Transformation *transform;
+		uint32_t		shader;
+		uint32_t		material;
+		uint32_t		mesh;
+		bool			animated;
+		bool			prepassed;	   ///< its depth is drawn in DEPTH_PASS, so the color pass tests for GL_EQUAL
+	};
+
+	/// shadow cascade i is drawn in pass SHADOW_PASS + i
+	enum Pass : uint32_t {
+		SHADOW_PASS = 0,
+		COLOR_PASS	= 4,
+		DEPTH_PASS	= 5,	 ///< depth only, before the color pass
+	};
+
+	static constexpr uint32_t PASS_BITS		= 4;
+	static constexpr uint32_t SHADER_BITS	= 12;
+	static constexpr uint32_t MATERIAL_BITS = 16;
+	static constexpr uint32_t MESH_BITS		= 16;
+	static constexpr uint32_t DEPTH_BITS	= 16;
+
+   private:
+	std::vector<Draw>	  draws;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+	std::vector<uint64_t> tempKeys;
+	std::vector<uint32_t> tempOrder;
+
+   public:
+	/**
+	 * @brief Builds a sort key.
+	 *
+	 * @param pass - the pass the draw belongs to
+	 * @param shader - index of the shader
+	 * @param material - index of the material
+	 * @param mesh - index of the mesh
+	 * @param depth - distance from the camera, draws that are closer come first
+	 * @return uint64_t
+	 */
+	static uint64_t makeKey(uint32_t pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth);
+	static uint32_t getPass(uint64_t key) { return key >> (64 - PASS_BITS); }
+
+	/**
+	 * @brief Removes all draws. Keeps the allocated memory for the next frame.
+	 */
+	void clear();
+	void add(uint64_t key, const Draw &draw);
+	/**
+	 * @brief Sorts the draws by their keys. The sort is stable, so draws with equal keys keep the order they were added
+	 * in.
+	 */
+	void sort();
+
+	std::size_t size() const { return order.size(); }
+	/**
+	 * @brief Get the \a i -th draw in sorted order.
+	 */
+	const Draw &operator[](std::size_t i) const { return draws[order[i]]; }
+	uint64_t	getKey(std::size_t i) const { return keys[i]; }
+
+	/**
+	 * @brief Get the range of sorted draws that belong to \a pass. Only valid after sort().
+	 *
+	 * @return std::pair<std::size_t, std::size_t> - the first draw and one past the last
+	 */
+	std::pair<std::size_t, std::size_t> getPassRange(uint32_t pass) const;
+};
+
+}	  // namespace ygl
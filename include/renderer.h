@@ -14,6 +14,13 @@
 #include <camera.h>
 #include <imgui.h>
 #include <asset_manager.h>
+#include <render_queue.h>
+#include <mesh_pool.h>
+#include <gl_state.h>
+#include <shadow_cascades.h>
+#include <frame_capture.h>
+#include <profiler.h>
+#include <unordered_map>
 
 /**
  * @file renderer.h
@@ -25,6 +32,8 @@ namespace ygl {
 struct Material;
 struct Light;
 class FrameBuffer;
+class MeshPool;
+class DepthPyramid;
 class IScreenEffect;
 class ACESEffect;
 class BloomEffect;
@@ -47,11 +56,24 @@ struct alignas(16) Light {
 
 std::ostream &operator<<(std::ostream &out, const Light &l);
 
+/// start of the lights SSBO, laid out the way lights.glsl reads it. The lights follow it.
+struct LightsHeader {
+	glm::mat4  inverseProjection;	  ///< of the camera the clusters are built for
+	glm::vec4  clusterDepth;		  ///< near and far depth, scale and bias from log(depth) to a depth slice
+	glm::uvec3 clusterCount;		  ///< clusters along each axis, 0 when the lights are not clustered
+	uint	   lightsCount;
+	glm::vec2  screenSize;
+	glm::vec2  padding;
+};
+static_assert(sizeof(LightsHeader) % alignof(Light) == 0, "the lights after the header have to stay aligned");
+
 class FrameBuffer {
 	GLuint				   id;
 	FrameBufferAttachable *color;
 	FrameBufferAttachable *depth_stencil;
 
+	inline static GLuint defaultID = 0;
+
    public:
 	FrameBuffer(FrameBufferAttachable *buff1, GLenum attachment1, FrameBufferAttachable *buff2, GLenum attachment2,
 				const char *name = nullptr);
@@ -69,47 +91,125 @@ class FrameBuffer {
 	int	 getID() { return id; }
 	void resize(uint width, uint height);
 
+	/**
+	 * @brief Binds the framebuffer that is shown on the screen, or the offscreen one of a headless Window.
+	 */
 	static void bindDefault();
+	/**
+	 * @brief Replaces the framebuffer bound by bindDefault() and unbind().
+	 *
+	 * @param fb - the new default framebuffer, nullptr for the one of the window
+	 */
+	static void setDefault(FrameBuffer *fb);
 };
 
+/**
+ * @brief A pass over the whole screen after the scene is drawn. Effects that only change each pixel by itself can be
+ * fused: the renderer draws a run of such effects in one pass with a variant of fused.fs instead of calling apply()
+ * for each of them, which saves reading and writing the whole screen for every effect.
+ */
 class IScreenEffect {
    protected:
 	Renderer *renderer;
 	IScreenEffect() {}
 
+	/**
+	 * @brief Applies the effect alone with the fused shader, for fused effects that have no shader of their own.
+	 */
+	void applyFused(FrameBuffer *front, FrameBuffer *back);
+
    public:
+	/// the parts of fused.fs, in the order in which they are applied
+	enum FusedStage {
+		NOT_FUSED,
+		BLOOM,
+		VIGNETTE,
+		TONEMAP,
+		FUSED_STAGES_COUNT
+	};
+
 	DELETE_COPY_AND_ASSIGNMENT(IScreenEffect)
 
 	bool		 enabled = true;
 	void		 setRenderer(Renderer *renderer) { this->renderer = renderer; }
 	virtual void apply(FrameBuffer *front, FrameBuffer *back) = 0;
 	virtual ~IScreenEffect() {};
+
+	/**
+	 * @brief Get the part of the fused shader that does this effect, NOT_FUSED if it needs a pass of its own.
+	 */
+	virtual FusedStage getFusedStage() { return NOT_FUSED; }
+	/**
+	 * @brief Does the work of a fused effect that is not per pixel, before the fused pass.
+	 */
+	virtual void prepareFused(FrameBuffer *) {}
+	/**
+	 * @brief Sets the uniforms and binds the textures of the effect for the fused pass.
+	 *
+	 * @param shader - the bound fused shader
+	 */
+	virtual void setFusedUniforms(Shader *) {}
 };
 
 // TODO: this must go to the effects header
 class ACESEffect : public IScreenEffect {
-	uint colorGrader;
+	Uniform<float> exposureUniform = Uniform<float>("exposure");
 
    public:
+	float exposure = 1.0;
+
 	DELETE_COPY_AND_ASSIGNMENT(ACESEffect)
 
 	ACESEffect(Renderer *renderer);
 	~ACESEffect();
-	void apply(FrameBuffer *front, FrameBuffer *back);
+	void apply(FrameBuffer *front, FrameBuffer *back) override { applyFused(front, back); }
+
+	FusedStage getFusedStage() override { return TONEMAP; }
+	void	   setFusedUniforms(Shader *shader) override;
 };
 
+/**
+ * @brief Glow around bright parts of the screen. The bright parts are filtered down a chain of textures, each half the
+ * size of the previous one starting at half the screen, then blurred back up the chain, adding every level to the one
+ * above it. This gives a wide glow for the cost of a few passes over small textures.
+ */
 class BloomEffect : public IScreenEffect {
-	ComputeShader *blurShader, *filterShader;
+	struct Level {
+		Texture2d *texture;
+		GLsizei	   width, height;
+	};
+
+	ComputeShader *downsampleShader, *upsampleShader;
 	VFShader	  *onScreen;
 
-	Texture2d *tex1, *tex2;
+	Uniform<bool>  firstLevelUniform = Uniform<bool>("firstLevel");
+	Uniform<float> thresholdUniform	 = Uniform<float>("threshold");
+	Uniform<float> weightUniform	 = Uniform<float>("bloomWeight");
+
+	std::vector<Level> levels;
+
+	void createLevels(uint width, uint height);
+	void deleteLevels();
+	/**
+	 * @brief Fills the chain from the screen. The top level then holds the sum of all levels.
+	 */
+	void blur(FrameBuffer *front);
 
    public:
+	static constexpr uint MAX_LEVELS = 6;
+
+	float threshold = 1.0;	   ///< brightness from which colors start to glow
+	float intensity = 1.0;	   ///< strength of the glow
+
 	DELETE_COPY_AND_ASSIGNMENT(BloomEffect)
 
 	BloomEffect(Renderer *renderer);
 	~BloomEffect();
 	void apply(FrameBuffer *front, FrameBuffer *back);
+
+	FusedStage getFusedStage() override { return BLOOM; }
+	void	   prepareFused(FrameBuffer *front) override { blur(front); }
+	void	   setFusedUniforms(Shader *shader) override;
 };
 
 struct RendererComponent : ygl::Serializable {
@@ -130,18 +230,25 @@ class Renderer : public ygl::ISystem {
 	std::vector<Material> materials;
 	std::vector<Light>	  lights;
 
-	GLuint materialsBuffer = 0;
-	GLuint lightsBuffer	   = 0;
+	RingBuffer frameData = RingBuffer(1 << 16);		///< materials, lights and draw data, written again every frame
 
 	uint		   defaultShader	   = -1;
 	uint		   defaultShadowShader = -1;
 	Texture2d	   defaultTexture	   = Texture2d(1, 1, TextureType::RGBA16F, nullptr);
 	TextureCubemap defaultCubemap	   = TextureCubemap(1, 1);
 
-	FrameBuffer		  *shadowFrameBuffer;
-	OrthographicCamera shadowCamera	 = OrthographicCamera(120, 1., 0.1, 100);
-	uint			   shadowMapSize = 2048;
-	bool			   shadow		 = false;
+	static constexpr uint MAX_CASCADES = ShadowCascades::MAX_CASCADES;
+
+	FrameBuffer		 *shadowFrameBuffer			   = nullptr;
+	Texture2dArray	 *shadowMaps				   = nullptr;	  ///< a layer per cascade, owned by shadowFrameBuffer
+	ShadowCascades	  shadowCascades			   = ShadowCascades(3, 2048);
+	float			  shadowDistance			   = 150;		  ///< no shadows further from the main camera
+	bool			  shadow					   = false;
+	uint			  cascadesCount				   = 0;			  ///< 0 when there is no directional light
+	uint64_t		  cascadeHashes[MAX_CASCADES]  = {};		  ///< bounds and casters of each cascade
+	uint64_t		  renderedHashes[MAX_CASCADES] = {};		  ///< what each layer of shadowMaps holds
+	RingBuffer::Range cascadeCameras[MAX_CASCADES];				  ///< camera block of each cascade in frameData
+	uint			  renderedCascades			   = 0;			  ///< cascades drawn again in the last frame
 
 	Camera *mainCamera = nullptr;
 
@@ -154,14 +261,111 @@ class Renderer : public ygl::ISystem {
 	Window							   *window = nullptr;
 	AssetManager					   *asman;
 
+	RenderQueue			   renderQueue;
+	std::vector<glm::mat4> instanceMatrices;	 ///< world matrices of the queued draws in sorted order
+	RingBuffer::Range	   instanceRange;		 ///< where instanceMatrices are in frameData
+
+	bool						   frustumCulling = true;
+	bool						   depthPrepass	  = false;
+	std::size_t					   culledCount	  = 0;	   ///< draws rejected by frustum culling in the last frame
+	std::vector<RenderQueue::Draw> candidates;			   ///< draw of every entity before culling
+	std::vector<uint>			   shadowShaders;		   ///< shadow shader of every candidate
+	std::vector<glm::vec4>		   boundingSpheres;		   ///< world-space bounding sphere of every candidate
+	std::vector<uint8_t>		   colorVisible;
+	std::vector<uint8_t>		   shadowVisible;
+
+	GLState::Stats glStats;		///< requests to GLState during the last frame
+
+	// uniforms set by the renderer, looked up once for each shader they are used with
+	Uniform<glm::mat4> worldMatrixUniform	= Uniform<glm::mat4>("worldMatrix");
+	Uniform<GLuint>	   materialIndexUniform	= Uniform<GLuint>("material_index");
+	Uniform<GLint>	   animateUniform		= Uniform<GLint>("animate");
+	Uniform<GLint>	   instancedUniform		= Uniform<GLint>("instanced");
+	Uniform<bool>	   useSkyboxUniform		= Uniform<bool>("use_skybox");
+	Uniform<uint>	   renderModeUniform	= Uniform<uint>("renderMode");
+	Uniform<GLboolean> useShadowUniform		= Uniform<GLboolean>("use_shadow");
+
+	bool								gpuDriven  = false;
+	MeshPool						   *meshPool   = nullptr;
+	ComputeShader					   *cullShader = nullptr;
+	std::unordered_map<IMesh *, GLuint>	meshEntries;		  ///< pool entry of each mesh that was tried
+	std::vector<GLuint>					drawEntries;		  ///< pool entry of each queued draw in sorted order
+	RingBuffer::Range					drawEntriesRange;	  ///< where drawEntries are in frameData
+	MutableBuffer						commandsBuffer;		  ///< written by the culling shader
+
+	bool		  occlusionCulling = true;
+	DepthPyramid *depthPyramid	   = nullptr;	  ///< of the depth of the previous frame
+
+	bool		   lightClustering = true;
+	ComputeShader *clusterShader   = nullptr;
+	MutableBuffer  clusterLightsCounts;		///< number of lights that reach each cluster
+	MutableBuffer  clusterLights;			///< MAX_LIGHTS_PER_CLUSTER light indices for each cluster
+
+	FrameCapture frameCapture;
+	std::string	 recordingPrefix;		 ///< empty when frames are not recorded
+	std::string	 recordingExtension;
+	uint		 recordedFrames = 0;
+
+	Profiler profiler;
+
+	void collectDraws();
+	/**
+	 * @brief Get the shader that draws the depth of a draw for the prepass, -1 if it cannot be prepassed, like cutout
+	 * materials and meshes with their own depth test.
+	 *
+	 * @param shadowShader - the shadow shader of the draw, -1 for the default one
+	 */
+	uint getDepthShader(const RenderQueue::Draw &draw, uint shadowShader);
+	void reserveFrameData();
+	void uploadMaterialsAndLights();
+	void createShadowMaps();
+	void collectShadowDraws();
+	void uploadShadowCascades();
+	void uploadInstanceMatrices();
+	void uploadDrawEntries();
+	void enableInstanceMatrices(std::size_t first);
+	void disableInstanceMatrices();
+	/**
+	 * @brief Writes the indirect commands of a range of the render queue, zero instances for the culled draws.
+	 *
+	 * @param occlusion - whether to test against the depth pyramid too, only for passes seen from the main camera
+	 */
+	void cullDraws(std::size_t first, std::size_t last, bool occlusion);
+	void buildDepthPyramid();
+	void buildLightClusters();
+	/**
+	 * @brief Fills the header of the lights SSBO.
+	 *
+	 * @param camera - the camera to build clusters for, nullptr to leave the lights unclustered
+	 */
+	static LightsHeader makeLightsHeader(Camera *camera, glm::vec2 screenSize, uint lightsCount);
+	void submitDraws(uint pass);
 	void drawScene();
 	void shadowPass();
+	void depthPass();
 	void colorPass();
 	void effectsPass();
-
-	std::vector<IScreenEffect *> effects;
+	/**
+	 * @brief Applies a run of fused effects in one pass. Draws a copy of the screen when none of them is enabled.
+	 * prepareFused() has to be called for the enabled ones before that.
+	 *
+	 * @param source - the framebuffer with the image to apply the effects to
+	 * @param target - the framebuffer to draw to, nullptr for the default one
+	 */
+	void	  fusedPass(IScreenEffect *const *effects, std::size_t count, FrameBuffer *source, FrameBuffer *target);
+	VFShader *getFusedShader(uint stages);
+
+	std::vector<IScreenEffect *>		 effects;
+	std::unordered_map<uint, VFShader *> fusedShaders;	   ///< variants of fused.fs by bit mask of their stages
 
    public:
+	/// first of the 4 attribute locations that hold the world matrix of an instance
+	static constexpr GLuint INSTANCE_MATRIX_LOCATION = 8;
+	/// number of clusters the view frustum is split into along x, y and depth for clustered lighting
+	static constexpr uint CLUSTERS_X = 16, CLUSTERS_Y = 9, CLUSTERS_Z = 24;
+	/// lights that reach a cluster after this many are ignored
+	static constexpr uint MAX_LIGHTS_PER_CLUSTER = 128;
+
 	static const char *name;
 	uint			   skyboxTexture	 = 0;
 	uint			   irradianceTexture = 0;
@@ -182,6 +386,8 @@ class Renderer : public ygl::ISystem {
 	IMesh	 *getMesh(uint index);
 	Mesh	 *getScreenQuad();
 
+	void bindMaterialTextures(unsigned int materialIndex);
+	void bindSceneTextures(Shader *shader);
 	void bindTexturesForMaterial(unsigned int materialIndex, Shader *shader);
 
 	unsigned int   addMaterial(const Material &);
@@ -196,6 +402,81 @@ class Renderer : public ygl::ISystem {
 	uint getDefaultShadowShader();
 	void setClearColor(glm::vec4 color);
 	void setShadow(bool shadow);
+	/**
+	 * @brief Sets the number of cascades the shadow of the first light is split into. Each cascade is a shadow map
+	 * that covers a part of the view frustum of the main camera, the near ones in more detail. A cascade is drawn
+	 * again only when its bounds or its casters change. Defaults to 3.
+	 *
+	 * @param count - from 1 to ShadowCascades::MAX_CASCADES
+	 */
+	void setShadowCascades(uint count);
+	uint getShadowCascades() { return shadowCascades.getCount(); }
+	/**
+	 * @brief Sets the width and height of the shadow map of each cascade. Defaults to 2048.
+	 */
+	void setShadowMapSize(uint size);
+	/**
+	 * @brief Sets the distance from the main camera up to which shadows are drawn. Defaults to 150.
+	 */
+	void  setShadowDistance(float distance) { shadowDistance = distance; }
+	float getShadowDistance() { return shadowDistance; }
+	/**
+	 * @brief Get the number of cascades that were drawn again in the last frame.
+	 */
+	uint getRenderedCascades() { return renderedCascades; }
+	/**
+	 * @brief Enables the GPU driven path. Meshes that can be pooled (see MeshPool) are frustum culled in a compute
+	 * shader and drawn with glMultiDrawElementsIndirect, one call for each run of draws with the same shader and
+	 * material. The shader has to support instancing like simple.vs does. Other draws are submitted as usual. Not
+	 * available without compute shaders.
+	 *
+	 * @param gpuDriven - true to enable
+	 */
+	void setGPUDriven(bool gpuDriven);
+	bool isGPUDriven() { return gpuDriven; }
+	/**
+	 * @brief Enables occlusion culling in the GPU driven path. After the color pass a Hi-Z pyramid (see DepthPyramid)
+	 * is built from its depth and in the next frame the culling shader also drops the draws whose bounds are behind
+	 * it. The test uses the depth and the camera of the previous frame, so an object that comes out from behind an
+	 * occluder can show up a frame late. Works only when there is at least one screen effect, since the depth of the
+	 * default framebuffer cannot be read. Enabled by default.
+	 *
+	 * @param occlusionCulling - true to enable
+	 */
+	void setOcclusionCulling(bool occlusionCulling) { this->occlusionCulling = occlusionCulling; }
+	bool isOcclusionCulling() { return occlusionCulling; }
+	/**
+	 * @brief Enables culling of entities whose bounding sphere is outside the frustum of the camera, for both the color
+	 * and the shadow pass. Enabled by default. Animated meshes are never culled.
+	 *
+	 * @param frustumCulling - true to enable
+	 */
+	void		setFrustumCulling(bool frustumCulling) { this->frustumCulling = frustumCulling; }
+	bool		isFrustumCulling() { return frustumCulling; }
+	std::size_t getCulledCount() { return culledCount; }
+	/**
+	 * @brief Enables the depth prepass. The depth of the scene is drawn first with the shadow shaders and the color
+	 * pass then tests for GL_EQUAL without writing depth, so each pixel is shaded only once. Only draws whose shadow
+	 * shader has the same vertex stages as their shader are prepassed, the others and the draw functions are drawn as
+	 * usual. Pays off in scenes with a lot of overdraw. Disabled by default.
+	 *
+	 * @param depthPrepass - true to enable
+	 */
+	void setDepthPrepass(bool depthPrepass) { this->depthPrepass = depthPrepass; }
+	bool isDepthPrepass() { return depthPrepass; }
+	/**
+	 * @brief Enables clustered lighting. The view frustum of the main camera is split into clusters and a compute
+	 * shader lists the lights that reach each of them, so every fragment only shades the lights near it. Otherwise
+	 * every fragment loops over all lights. Enabled by default, not available without compute shaders.
+	 *
+	 * @param lightClustering - true to enable
+	 */
+	void setLightClustering(bool lightClustering) { this->lightClustering = lightClustering; }
+	bool isLightClustering() { return lightClustering; }
+	/**
+	 * @brief Get the number of GL state changes that were issued and skipped by GLState during the last frame.
+	 */
+	const GLState::Stats &getGLStats() { return glStats; }
 
 	void setMainCamera(Camera *cam) { this->mainCamera = cam; }
 
@@ -212,6 +493,16 @@ class Renderer : public ygl::ISystem {
 	static void drawObject(Shader *sh, Mesh *mesh);
 
 	static void compute(ComputeShader *shader, int numGroupsX, int numGroupsY, int numGroupsZ);
+	/**
+	 * @brief Get the world space sphere that a draw is culled with. Animated meshes and meshes with a depth test
+	 * other than GL_LESS, like the skybox, get an infinite radius and are never culled.
+	 *
+	 * @param meshSphere - bounding sphere of the mesh in model space
+	 * @param depthFunc - depth test of the mesh
+	 * @param animated - whether the mesh is skinned
+	 * @param world - world matrix of the draw
+	 */
+	static glm::vec4 getCullingSphere(glm::vec4 meshSphere, GLenum depthFunc, bool animated, const glm::mat4 &world);
 
 	static GLuint loadMaterials(int count, Material *materials);
 	static GLuint loadLights(int count, Light *materials);
@@ -221,9 +512,38 @@ class Renderer : public ygl::ISystem {
 	bool		  hasSkybox();
 	bool		  hasShadow();
 
+	/**
+	 * @brief Get the profiler that measures the passes of the renderer. A frame of it ends with each doWork(), other
+	 * systems can measure their work in it too.
+	 */
+	Profiler &getProfiler() { return profiler; }
+
 	void drawGUI();
 	bool drawMaterialEditor();
+	/**
+	 * @brief Saves the current viewport of the framebuffer that is bound for reading to an image file. The pixels are
+	 * read and encoded in the background, the file is written a frame or two later.
+	 *
+	 * @param filename - the file to write, the format is chosen by its extension, see FrameCapture
+	 */
 	void screenShot(const std::string &filename);
+	/**
+	 * @brief Saves every frame that is rendered from now on to a numbered image file, like prefix000042.png. PNG files
+	 * take long to encode, TGA or BMP files keep up better with long recordings.
+	 *
+	 * @param prefix - path and name of the files before the frame number
+	 * @param extension - extension of the files, including the dot
+	 */
+	void startRecording(const std::string &prefix, const std::string &extension = ".png");
+	/**
+	 * @brief Stops saving frames. The frames that were already captured are still written.
+	 */
+	void stopRecording() { recordingPrefix.clear(); }
+	bool isRecording() { return !recordingPrefix.empty(); }
+	/**
+	 * @brief Waits until all screenshots and recorded frames have been written.
+	 */
+	void flushCaptures() { frameCapture.flush(); }
 
 	void write(std::ostream &out) override;
 	void read(std::istream &in) override;
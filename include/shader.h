@@ -27,6 +27,14 @@ class Shader : public ISerializable {
 	GLuint		*shaders	  = nullptr;
 	const char **fileNames	  = nullptr;
 	bool		 bound		  = false;
+	bool		 errorShader  = false;	   ///< if the stages failed and were replaced by the error shader
+
+	inline static uint64_t nextId = 1;
+	const uint64_t		   id	  = nextId++;	  ///< unique for every shader ever created, unlike program names
+
+	std::vector<std::string> sources;	  ///< expanded sources of the stages, kept until the program is created
+	std::vector<GLenum>		 types;
+	std::vector<std::string> defines;	  ///< defined at the top of every stage, after the stage define
 
 	std::unordered_map<std::string, GLint> uniforms;
 	std::unordered_map<std::string, GLint> SSBOs;
@@ -41,7 +49,16 @@ class Shader : public ISerializable {
 	Shader(std::initializer_list<std::string> files);
 	Shader(std::istream &in);
 
+	/**
+	 * @brief Loads the source of a shader stage. The stages are compiled by finishProgramCreation(), unless the program
+	 * is found in the binary cache.
+	 *
+	 * @param type - type of the stage, for example GL_VERTEX_SHADER
+	 * @param target - index of the stage
+	 * @param file - source file, defaults to the file name given on construction
+	 */
 	void createShader(GLenum type, GLuint target, const char *file = nullptr);
+	void compileShaders();
 	void attachShaders();
 
 	bool checkLinkStatus();
@@ -51,6 +68,10 @@ class Shader : public ISerializable {
 	void loadSource(const char *file, GLenum type, const char *includeDir, char *&source, int &length);
 	void loadSource(const char *file, GLenum type, char *&source, int &length);
 
+	uint64_t getBinaryCacheKey();
+	bool	 loadProgramBinary(const std::string &cacheFile, uint64_t key);
+	void	 saveProgramBinary(const std::string &cacheFile, uint64_t key);
+
 	void finishProgramCreation();
 	void deleteShaders();
 	void detachShaders();
@@ -73,6 +94,12 @@ class Shader : public ISerializable {
 
 	GLuint getUniformLocation(const std::string &uniformName);
 	bool   hasUniform(const std::string &uniformName);
+	/**
+	 * @brief Looks up a uniform once, for callers that would otherwise call hasUniform() and getUniformLocation().
+	 *
+	 * @return GLint - location of the uniform or -1 if the shader does not have it
+	 */
+	GLint findUniformLocation(const std::string &uniformName);
 
 	template <class T>
 	inline void setUniform(const std::string &uniformName, T &&value) {
@@ -84,19 +111,21 @@ class Shader : public ISerializable {
 		if (hasUniform(uniformName)) setUniform(getUniformLocation(uniformName), std::forward<T>(value));
 	}
 
-	void setUniform(GLuint location, GLboolean value) { glUniform1i(location, value ? 1 : 0); }
-	void setUniform(GLuint location, GLint value) { glUniform1i(location, value); }
-	void setUniform(GLuint location, GLuint value) { glUniform1ui(location, value); }
-	void setUniform(GLuint location, glm::mat4x4 value) {
+	static void setUniform(GLuint location, GLboolean value) { glUniform1i(location, value ? 1 : 0); }
+	static void setUniform(GLuint location, GLint value) { glUniform1i(location, value); }
+	static void setUniform(GLuint location, GLuint value) { glUniform1ui(location, value); }
+	static void setUniform(GLuint location, glm::mat4x4 value) {
 		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 	}
-	void setUniform(GLuint location, glm::vec4 value) { glUniform4f(location, value.x, value.y, value.z, value.w); }
-	void setUniform(GLuint location, glm::vec3 value) { glUniform3f(location, value.x, value.y, value.z); }
-	void setUniform(GLuint location, glm::vec2 value) { glUniform2f(location, value.x, value.y); }
-	void setUniform(GLuint location, glm::ivec2 value) { glUniform2i(location, value.x, value.y); }
-	void setUniform(GLuint location, glm::ivec3 value) { glUniform3i(location, value.x, value.y, value.z); }
-	void setUniform(GLuint location, GLfloat value) { glUniform1f(location, value); }
-	void setUniform(GLuint location, GLdouble value) { glUniform1d(location, value); }
+	static void setUniform(GLuint location, glm::vec4 value) {
+		glUniform4f(location, value.x, value.y, value.z, value.w);
+	}
+	static void setUniform(GLuint location, glm::vec3 value) { glUniform3f(location, value.x, value.y, value.z); }
+	static void setUniform(GLuint location, glm::vec2 value) { glUniform2f(location, value.x, value.y); }
+	static void setUniform(GLuint location, glm::ivec2 value) { glUniform2i(location, value.x, value.y); }
+	static void setUniform(GLuint location, glm::ivec3 value) { glUniform3i(location, value.x, value.y, value.z); }
+	static void setUniform(GLuint location, GLfloat value) { glUniform1f(location, value); }
+	static void setUniform(GLuint location, GLdouble value) { glUniform1d(location, value); }
 
 	void  createSSBO(const std::string &name, GLuint binding);
 	void  createUBO(const std::string &name, GLuint binding);
@@ -105,7 +134,10 @@ class Shader : public ISerializable {
 	GLint getSSBOBinding(const std::string &name);
 	GLint getUBOBinding(const std::string &name);
 
-	bool isBound();
+	bool		isBound();
+	uint64_t	getId() const { return id; }
+	uint		getStagesCount() const { return shadersCount; }
+	const char *getFileName(uint stage) const { return fileNames[stage]; }
 
 	static void setSSBO(GLuint bufferId, GLuint binding);
 	static void setUBO(GLuint bufferId, GLuint binding);
@@ -113,6 +145,45 @@ class Shader : public ISerializable {
 	void serialize(std::ostream &out) override;
 };
 
+/**
+ * @brief A uniform looked up by name only once for each shader it is used with. Setting the value afterwards is a plain
+ * glUniform call. The handle remembers the id of the shader it was resolved for and resolves the name again when used
+ * with another one, so it stays valid when shaders are reloaded. Setting a uniform that the shader does not have does
+ * nothing, so optional uniforms need no hasUniform() checks. Like Shader::setUniform, the shader has to be bound.
+ *
+ * @tparam T - type of the value, any type accepted by Shader::setUniform
+ */
+template <class T>
+class Uniform {
+	std::string name;
+	uint64_t	shaderId = 0;
+	GLint		location = -1;
+
+   public:
+	Uniform(const std::string &name) : name(name) {}
+
+	/**
+	 * @brief Get the location of the uniform in \a shader. Looks the name up only if the last call was for another
+	 * shader.
+	 *
+	 * @return GLint - the location or -1 if the shader does not have the uniform
+	 */
+	GLint resolve(Shader *shader) {
+		if (shader->getId() != shaderId) {
+			shaderId = shader->getId();
+			location = shader->findUniformLocation(name);
+		}
+		return location;
+	}
+
+	bool exists(Shader *shader) { return resolve(shader) != -1; }
+
+	void set(Shader *shader, const T &value) {
+		GLint resolved = resolve(shader);
+		if (resolved != -1) Shader::setUniform((GLuint)resolved, value);
+	}
+};
+
 /**
  * @brief Vertex-Fragment Shader. Links a Vertex Shader and a Fragment Shader into a program. See OpenGL wiki.
  */
@@ -120,6 +191,13 @@ class VFShader : public Shader {
    public:
 	static const char *name;
 	VFShader(const char *vertex, const char *fragment);
+	/**
+	 * @brief Creates a variant of a shader with some macros defined, for shaders that turn parts on and off with
+	 * #ifdef. The defines are not serialized.
+	 *
+	 * @param defines - names of the macros, each is defined with no value
+	 */
+	VFShader(const char *vertex, const char *fragment, const std::vector<std::string> &defines);
 	VFShader(std::istream &in);
 
 	void serialize(std::ostream &out) override;
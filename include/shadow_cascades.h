@@ -0,0 +1,99 @@
+#pragma once
+
+#include <yoghurtgl.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @file shadow_cascades.h
+ * @brief Fitting of cascaded shadow maps to the view frustum
+ */
+
+namespace ygl {
+
+/**
+ * @brief Splits the view frustum of a camera in depth slices and fits an orthographic light camera to each of them.
+ * Near cascades cover a small area with many texels each, far ones a big area. The cascades are fit to bounding
+ * spheres of the slices and moved in whole texels, so they keep their size when the camera turns and their texels do
+ * not move when it moves, which keeps shadow edges from shimmering. This also means a cascade keeps exactly the same
+ * matrices while the camera stays within a texel, so a renderer can keep its shadow map from an earlier frame.
+ */
+class ShadowCascades {
+   public:
+	static constexpr uint MAX_CASCADES = 4;
+
+	/// laid out the way the ShadowCascades uniform block in rendering.glsl reads it
+	struct Uniforms {
+		glm::mat4 matrices[MAX_CASCADES];	  ///< projection * view of each cascade
+		glm::vec4 splits;					  ///< view space depth at which each cascade ends
+		GLuint	  count;
+		GLuint	  padding[3];
+	};
+
+	struct Cascade {
+		glm::mat4 view;				  ///< rotation of the light, the same for all cascades
+		glm::mat4 projection;		  ///< set by cull()
+		glm::vec2 min, max;			  ///< bounds in light space
+		float	  receiversDepth[2];  ///< nearest and farthest depth of the slice in light space
+		float	  castersDepth;		  ///< nearest depth of the casters, found by cull()
+		float	  splitDepth;		  ///< view space depth at which the cascade ends
+	};
+
+   private:
+	Cascade cascades[MAX_CASCADES];
+	uint	count		= 3;
+	uint	resolution	= 2048;
+	float	splitLambda = 0.75;
+
+   public:
+	ShadowCascades() = default;
+	/**
+	 * @param count - number of cascades, up to MAX_CASCADES
+	 * @param resolution - width and height of the shadow map of each cascade in texels
+	 */
+	ShadowCascades(uint count, uint resolution);
+
+	/**
+	 * @brief Fits the cascades to the view frustum of a camera, up to \a distance from it. cull() has to be called for
+	 * each cascade afterwards to find the depth range of its casters.
+	 *
+	 * @param cameraProjection - projection matrix of the camera
+	 * @param cameraWorld - world matrix of the camera, the inverse of its view matrix
+	 * @param lightTransform - world matrix of the light, it shines along its -z axis like an OrthographicCamera
+	 * @param distance - depth after which there are no shadows
+	 */
+	void fit(const glm::mat4 &cameraProjection, const glm::mat4 &cameraWorld, const glm::mat4 &lightTransform,
+			 float distance);
+	/**
+	 * @brief Finds the spheres that can cast a shadow in a cascade: those that overlap it when seen from the light and
+	 * are not entirely behind it. Extends the cascade towards the light so that all of them fit and sets its
+	 * projection.
+	 *
+	 * @param cascade - index of the cascade
+	 * @param spheres - world space center and radius of each sphere. Spheres with infinite radius are always casters.
+	 * @param sphereCount - number of spheres
+	 * @param casters - set to 1 for each caster and to 0 for the rest
+	 */
+	void cull(uint cascade, const glm::vec4 *spheres, std::size_t sphereCount, uint8_t *casters);
+
+	/**
+	 * @brief Get the data for the shaders. Only valid after all cascades were culled.
+	 */
+	Uniforms getUniforms() const;
+
+	const Cascade &operator[](uint index) const { return cascades[index]; }
+
+	uint  getCount() const { return count; }
+	void  setCount(uint count);
+	uint  getResolution() const { return resolution; }
+	void  setResolution(uint resolution) { this->resolution = resolution; }
+	float getSplitLambda() const { return splitLambda; }
+	/**
+	 * @brief Sets how the depth range is split: 0 for slices of equal length, 1 for logarithmic slices that grow with
+	 * distance. Defaults to 0.75.
+	 */
+	void setSplitLambda(float splitLambda) { this->splitLambda = splitLambda; }
+};
+
+}	  // namespace ygl
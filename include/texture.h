@@ -1,6 +1,7 @@
 #pragma once
 
 #include <yoghurtgl.h>
+#include <gl_state.h>
 
 #include <istream>
 #include <string>
@@ -62,6 +63,7 @@ enum TextureType {
 	RG16F,
 	R8,
 	R32UI,
+	RGBA8,
 	DIFFUSE	  = SRGBA8,
 	NORMAL	  = RGB16F,
 	ROUGHNESS = SRGB8,
@@ -89,7 +91,13 @@ class ITexture : public ISerializable, public FrameBufferAttachable {
 	virtual void save(std::string fileName) = 0;
 
 	virtual void bind(int textureUnit) const = 0;
-	virtual void bind() const { bind(GL_TEXTURE0); }
+	/**
+	 * @brief Binds the texture to unit 0 and makes that unit active, so that the texture can be modified.
+	 */
+	virtual void bind() const {
+		GLState::activeTexture(GL_TEXTURE0);
+		bind(GL_TEXTURE0);
+	}
 
 	virtual void unbind(int textureUnit) const = 0;
 	virtual void unbind() const { unbind(GL_TEXTURE0); }
@@ -209,18 +217,55 @@ class Texture3d : public ITexture {
 	void resize(uint width, uint height) override { assert(0); }
 	void save(std::string) override { assert(0); };
 
-	void bind(int textureUnit) const override {
-		glActiveTexture(textureUnit);
-		glBindTexture(GL_TEXTURE_3D, id);
-	}
-	void unbind(int textureUnit) const override {
-		glActiveTexture(textureUnit);
-		glBindTexture(GL_TEXTURE_3D, 0);
-	}
+	void bind(int textureUnit) const override { GLState::bindTexture(textureUnit, GL_TEXTURE_3D, id); }
+	void unbind(int textureUnit) const override { GLState::bindTexture(textureUnit, GL_TEXTURE_3D, 0); }
 
 	int getID() override { return id; }
 };
 
+/**
+ * @brief An array of 2D textures with the same size and format, sampled as a sampler2DArray. Each layer can be
+ * attached to a FrameBuffer on its own.
+ */
+class Texture2dArray : public ITexture {
+	GLuint		id	  = -1;
+	GLsizei		width = -1, height = -1, layers = -1;
+	TextureType	type;
+	GLint		internalFormat;
+
+	void init();
+
+   public:
+	Texture2dArray(GLsizei width, GLsizei height, GLsizei layers, TextureType type);
+	~Texture2dArray();
+
+	void bind(int textureUnit) const override { GLState::bindTexture(textureUnit, GL_TEXTURE_2D_ARRAY, id); }
+	void unbind(int textureUnit) const override { GLState::bindTexture(textureUnit, GL_TEXTURE_2D_ARRAY, 0); }
+#ifndef YGL_NO_COMPUTE_SHADERS
+	void bindImage(int unit) override { glBindImageTexture(unit, id, 0, GL_TRUE, 0, GL_READ_WRITE, internalFormat); }
+	void unbindImage(int unit) override { glBindImageTexture(unit, 0, 0, GL_TRUE, 0, GL_READ_WRITE, internalFormat); }
+#else
+	void bindImage(int) override { assert(0); };
+	void unbindImage(int) override { assert(0); };
+#endif
+
+	void serialize(std::ostream &out) override { assert(0); }
+	void save(std::string) override { assert(0); };
+	/**
+	 * @brief Attaches a single layer.
+	 *
+	 * @param image - the layer to attach
+	 */
+	void BindToFrameBuffer(const FrameBuffer &fb, GLenum attachment, uint image, uint level) override;
+	/**
+	 * @brief Recreates all layers with a new size, their contents are lost.
+	 */
+	void resize(uint width, uint height) override;
+
+	int		getID() override { return id; }
+	GLsizei getLayers() const { return layers; }
+};
+
 /**
  * @brief CubeMap Texture - six textures that wrap arround a cube.
  */
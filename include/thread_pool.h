@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <yoghurtgl.h>
+
+/**
+ * @file thread_pool.h
+ * @brief A pool of worker threads for CPU work that does not touch the OpenGL context.
+ */
+
+namespace ygl {
+
+/**
+ * @brief A fixed set of worker threads that execute tasks from a shared queue. A thread that waits for a task to finish
+ * should help with the queued work through wait(), so tasks can safely wait for tasks they have submitted.
+ */
+class ThreadPool {
+	std::vector<std::thread>		  workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex						  mutex;
+	std::condition_variable			  condition;
+	bool							  stopping = false;
+
+	void workerLoop();
+
+   public:
+	/**
+	 * @brief Construct a new Thread Pool.
+	 *
+	 * @param threadsCount - number of worker threads. If 0, tasks are executed by the thread that waits for them.
+	 */
+	ThreadPool(std::size_t threadsCount);
+	~ThreadPool();
+	DELETE_COPY_AND_ASSIGNMENT(ThreadPool)
+
+	/**
+	 * @brief Get the pool shared by the engine. It has one worker less than the number of hardware threads, leaving a
+	 * core for the main thread.
+	 *
+	 * @return ThreadPool&
+	 */
+	static ThreadPool &getDefault();
+
+	/**
+	 * @brief Adds a task to the queue.
+	 *
+	 * @param task - the task
+	 */
+	void enqueue(std::function<void()> task);
+
+	/**
+	 * @brief Adds a task to the queue and returns a future for its result.
+	 *
+	 * @param f - a callable with no arguments
+	 * @return std::future - becomes ready when \a f has been executed
+	 */
+	template <class F>
+	auto submit(F &&f) -> std::future<decltype(f())> {
+		using R	  = decltype(f());
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+		auto res  = task->get_future();
+		enqueue([task]() { (*task)(); });
+		return res;
+	}
+
+	/**
+	 * @brief Executes one queued task on the calling thread, if there is one.
+	 *
+	 * @return true - if a task has been executed
+	 */
+	bool runPendingTask();
+
+	/**
+	 * @brief Waits for a future, executing queued tasks in the meantime.
+	 *
+	 * @param future - the future to wait for
+	 */
+	template <class R>
+	void wait(std::future<R> &future) {
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			if (!runPendingTask()) std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * @brief Number of worker threads.
+	 *
+	 * @return std::size_t
+	 */
+	std::size_t getThreadsCount() { return workers.size(); }
+};
+
+}	  // namespace ygl
@@ -13,11 +13,15 @@
  */
 
 namespace ygl {
+class FrameBuffer;
+
 /**
- * @brief A Window Wrapper.
+ * @brief A Window Wrapper. When ygl::init() has been called with headless = true, the window is never shown and
+ * everything that is drawn on it goes to an offscreen FrameBuffer instead.
  */
 class Window {
-	GLFWwindow									  *window = nullptr;
+	GLFWwindow									  *window				= nullptr;
+	FrameBuffer									  *offscreenFrameBuffer = nullptr;
 	int											   width = -1, height = -1;
 	std::chrono::high_resolution_clock::time_point lastSwapTime			= std::chrono::high_resolution_clock::now();
 	double										   lastPrintTime		= 0;
@@ -25,6 +29,8 @@ class Window {
 	void (*frameCallback)(long, long, long)								= &defaultFrameCallback;
 	bool enableViewports												= false;
 
+	void createOffscreenFrameBuffer();
+
 	inline static std::vector<std::function<void(GLFWwindow *, int, int)>> resizeCallbacks;
 
 	Window() {};
@@ -51,6 +57,7 @@ class Window {
 	int			getHeight();
 	glm::ivec2	getPos();
 	GLFWwindow *getHandle();
+	bool		isHeadless();
 	bool		shouldClose();
 	void		close();
 	void		setShouldClose(bool);
@@ -80,6 +87,19 @@ class Window {
 	 * @param callback - the function to be called.
 	 */
 	void addResizeCallback(const std::function<void(GLFWwindow *window, int width, int height)> &callback);
+	/**
+	 * @brief Resizes the window. The resize callbacks are called the same way as when the user resizes it.
+	 *
+	 * @param width - new width
+	 * @param height - new height
+	 */
+	void setSize(int width, int height);
+	/**
+	 * @brief Get the framebuffer that a headless window renders to.
+	 *
+	 * @return FrameBuffer* - the offscreen framebuffer, or nullptr if the window is not headless
+	 */
+	FrameBuffer *getOffscreenFrameBuffer();
 
 	void setClearColor(const glm::vec4 &color) { glClearColor(color.r, color.g, color.b, color.a); }
 };
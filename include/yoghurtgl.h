@@ -57,14 +57,17 @@ namespace ygl {
 extern bool gl_init;		   ///< is gl initialized
 extern bool glfw_init;		   ///< is glfw initialized
 extern bool gl_debug_init;	   ///< is gl debug context initialized
+extern bool headless;		   ///< are windows offscreen, see init()
 
 /**
  * @brief Initializes Yoghurtgl.
  *
+ * @param headless - if true, windows are never shown and render into an offscreen context that does not need a
+ * display. Setting the YGL_HEADLESS environment variable to anything but 0 has the same effect.
  * @return 0 if it failed
  * @return 1 if it succeeded
  */
-int init();
+int init(bool headless = false);
 /**
  * @brief Initializes yoghurtgl debug context.
  *
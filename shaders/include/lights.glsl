@@ -0,0 +1,58 @@
+// Lights and the clusters they are binned into, shared by rendering.glsl and lightClusters.comp.
+//
+// With storage buffers the lights have no fixed limit. The view frustum of the main camera is split into clusters,
+// tiles on the screen with exponentially spaced depth slices, and each cluster lists the lights that reach it, so a
+// fragment only looks at the lights near it. WebGL has no storage buffers and keeps the uniform block of 100 lights.
+
+struct Light {
+	mat4  transform;
+	vec3  color;
+	float intensity;
+	int	  type;
+};
+
+const int LIGHT_AMBIENT		= 0;
+const int LIGHT_DIRECTIONAL = 1;
+const int LIGHT_POINT		= 2;
+
+// point lights are treated as zero past the distance where they fall below this
+const float LIGHT_CUTOFF = 1.0 / 256.0;
+
+#if !defined(GL_ES) && (defined(FRAGMENT_SHADER) || defined(COMPUTE_SHADER))
+	#define CLUSTERED_LIGHTS
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+// same as Renderer::MAX_LIGHTS_PER_CLUSTER
+const uint MAX_LIGHTS_PER_CLUSTER = 128u;
+
+	#ifdef COMPUTE_SHADER
+		#define CLUSTERS_ACCESS writeonly
+	#else
+		#define CLUSTERS_ACCESS readonly
+	#endif
+
+// same layout as LightsHeader followed by the lights
+layout(std430, binding = 5) readonly buffer Lights {
+	mat4  inverseProjection;	 // of the camera the clusters are built for
+	vec4  clusterDepth;			 // near and far depth, scale and bias from log(depth) to a slice
+	uvec3 clusterCount;			 // clusters along each axis, 0 when there are no clusters
+	uint  lightsCount;
+	vec2  screenSize;
+	Light lights[];
+};
+layout(std430, binding = 6) CLUSTERS_ACCESS buffer ClusterLightsCounts { uint clusterLightsCounts[]; };
+layout(std430, binding = 7) CLUSTERS_ACCESS buffer ClusterLights { uint clusterLights[]; };
+#elif defined(GL_ES)
+layout(std140, binding = 2) uniform Lights {
+	Light lights[100];
+	uint  lightsCount;
+};
+#endif
+
+// the distance at which a light stops mattering, infinite for lights that are not point lights
+float lightRadius(in Light light) {
+	if (light.type != LIGHT_POINT) return 1e30;
+	float brightest = max(light.color.r, max(light.color.g, light.color.b));
+	return sqrt(light.intensity * brightest / LIGHT_CUTOFF);
+}
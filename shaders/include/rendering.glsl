@@ -1,5 +1,6 @@
 #ifdef GL_ES
 precision highp float;
+precision highp sampler2DArray;
 #endif
 
 const float PI	   = 3.14159265359;
@@ -37,13 +38,6 @@ struct AmbientLight {
 	float intensity;
 };
 
-struct Light {
-	mat4  transform;
-	vec3  color;
-	float intensity;
-	int	  type;
-};
-
 struct Material {
 	vec3  albedo;
 	float specular_chance;
@@ -86,15 +80,13 @@ layout(std140, binding = 0) uniform Matrices {
 
 layout(std140, binding = 1) uniform Materials { Material materials[100]; };
 
-layout(std140, binding = 2) uniform Lights {
-	Light lights[100];
-	uint  lightsCount;
-};
+#include <lights.glsl>
 
-layout(std140, binding = 4) uniform shadowMatrices {
-	mat4 shadowProjectionMatrix;
-	mat4 shadowViewMatrix;
-	mat4 shadowCameraWorldMatrix;
+// same layout as ShadowCascades::Uniforms
+layout(std140, binding = 4) uniform ShadowCascades {
+	mat4 shadowMatrices[4];
+	vec4 cascadeSplits;		// view space depth at which each cascade ends
+	uint cascadesCount;
 };
 
 uniform uint  material_index = 0;
@@ -116,7 +108,7 @@ layout(binding = 13) uniform samplerCube irradianceMap;
 layout(binding = 14) uniform samplerCube prefilterMap;
 layout(binding = 15) uniform sampler2D brdfMap;
 uniform bool use_shadow = false;
-layout(binding = 16) uniform sampler2D shadowMap;
+layout(binding = 16) uniform sampler2DArray shadowMap;
 
 vec3 fresnelSchlick(float cosTheta, vec3 F0) {	   // learnopengl
 	return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
@@ -199,6 +191,40 @@ vec3 calcLight(Light light, in vec3 position, in vec3 N, in vec3 albedo, in floa
 	return (kD * albedo / PI + specular) * radiance * NdotL;
 }
 
+#ifdef CLUSTERED_LIGHTS
+// index of the cluster of the fragment that is being shaded
+uint getCluster(in vec3 position) {
+	float depth = -(viewMatrix * vec4(position, 1.0)).z;
+	uvec2 tile	= uvec2(clamp(gl_FragCoord.xy / screenSize * vec2(clusterCount.xy), vec2(0), vec2(clusterCount.xy - 1u)));
+	uint  slice = uint(clamp(log(depth) * clusterDepth.z + clusterDepth.w, 0.0, float(clusterCount.z - 1u)));
+	return (slice * clusterCount.y + tile.y) * clusterCount.x + tile.x;
+}
+#endif
+
+// the sum of all lights, the first one is multiplied by shadow
+vec3 calcDirectLights(in vec3 position, in vec3 N, in vec3 albedo, in float roughness, in float metallic, in float ao,
+					  in vec3 camPos, in float shadow) {
+	vec3 light = vec3(0.0);
+#if defined(CLUSTERED_LIGHTS)
+	if (clusterCount.x != 0u) {
+		uint cluster = getCluster(position);
+		uint count	 = clusterLightsCounts[cluster];
+		for (uint i = 0u; i < count; ++i) {
+			uint index = clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER + i];
+			light += (index == 0u ? shadow : 1.0) *
+					 calcLight(lights[index], position, N, albedo, roughness, metallic, ao, camPos);
+		}
+		return light;
+	}
+#endif
+#if defined(CLUSTERED_LIGHTS) || defined(GL_ES)
+	for (uint i = 0u; i < lightsCount; ++i) {
+		light += (i == 0u ? shadow : 1.0) * calcLight(lights[i], position, N, albedo, roughness, metallic, ao, camPos);
+	}
+#endif
+	return light;
+}
+
 vec3 calculateIndirectComponent(in vec3 position, in vec3 N, in vec3 albedo, in float roughness, in float metallic,
 								in float ao, in vec3 camPos) {
 	vec3 V = normalize(camPos - position);
@@ -225,18 +251,27 @@ vec3 calculateIndirectComponent(in vec3 position, in vec3 N, in vec3 albedo, in
 	return ambient * indirectStrength;
 }
 
-float sampleShadow(in vec4 shadowPosition) {
-		if(
-				shadowPosition.x >= -1 && shadowPosition.x <=1 && 
-				shadowPosition.y >= -1 && shadowPosition.y <=1 &&
-				shadowPosition.z >= -1 && shadowPosition.z <=1) {
-			vec3 coords = (shadowPosition.xyz + 1.) / 2.;
-			float depth = texture(shadowMap, coords.xy).x;
-			if(coords.z <= (depth + 0.001)) {
-				return 1.0;
-			}
-		}
-		return 0.0;
+float sampleShadow(in vec3 coords, in int cascade) {
+	float depth = texture(shadowMap, vec3(coords.xy, float(cascade))).x;
+	return coords.z <= depth + 0.001 ? 1.0 : 0.0;
+}
+
+// the part of the light that reaches a position, from the nearest cascade that covers it
+float calcShadow(in vec3 position) {
+	float viewDepth = -(viewMatrix * vec4(position, 1)).z;
+	vec2  texel		= 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	for (int i = 0; i < int(cascadesCount); ++i) {
+		if (viewDepth > cascadeSplits[i]) continue;
+		vec3 coords = (shadowMatrices[i] * vec4(position, 1)).xyz * 0.5 + 0.5;
+		if (any(lessThan(coords, vec3(0.0))) || any(greaterThan(coords, vec3(1.0)))) continue;
+
+		float lit = 0.0;
+		for (int x = -1; x <= 1; ++x)
+			for (int y = -1; y <= 1; ++y)
+				lit += sampleShadow(vec3(coords.xy + vec2(x, y) * texel, coords.z), i);
+		return lit / 9.0;
+	}
+	return 1.0;
 }
 
 vec3 calcAllLightsCustom(in vec3 position, in vec3 normal, in vec3 albedo, in float roughness, in float metallic, in float AO, in vec3 emission, in float opacity) {
@@ -248,25 +283,10 @@ vec3 calcAllLightsCustom(in vec3 position, in vec3 normal, in vec3 albedo, in fl
 
 
 	float hasLight = 1.;
-	if(use_shadow) {
-		vec4 shadowPosition = shadowProjectionMatrix * shadowViewMatrix * vec4(position, 1);
-		if(
-				shadowPosition.x >= -1 + eps && shadowPosition.x <=1 - eps && 
-				shadowPosition.y >= -1 + eps && shadowPosition.y <=1 - eps &&
-				shadowPosition.z >= -1 + eps && shadowPosition.z <=1 - eps) {
-			hasLight = 0.0;
-			for(int i = -1; i <= 1; ++i)
-				for(int j = -1; j <= 1; ++j)
-					hasLight += sampleShadow(vec4(shadowPosition.xy + vec2(i, j) * 0.002, shadowPosition.zw));
-			hasLight /= 9;
-		}
-	}
+	if (use_shadow) hasLight = calcShadow(position);
 
 	if (renderMode == 0 || renderMode == 6) {
-		for (int i = 0; i < lightsCount; i++) {
-			light += hasLight * calcLight(lights[i], position, normal, albedo, roughness, metallic, AO, camPos);
-			hasLight = 1.0;
-		}
+		light += calcDirectLights(position, normal, albedo, roughness, metallic, AO, camPos, hasLight);
 		light += emission;
 		if (use_skybox == true) {
 			light += calculateIndirectComponent(position, normal, albedo, roughness, metallic, AO, camPos);
@@ -280,10 +300,7 @@ vec3 calcAllLightsCustom(in vec3 position, in vec3 normal, in vec3 albedo, in fl
 	if (renderMode == 5) { light += (normal * 0.5 + 0.5); }
 	if (renderMode == 7) { light += emission; }
 	if (renderMode == 8) {
-		for (int i = 0; i < lightsCount; i++) {
-			light += hasLight * calcLight(lights[i], position, normal, albedo, roughness, metallic, AO, camPos);
-			hasLight = 1.0;
-		}
+		light += calcDirectLights(position, normal, albedo, roughness, metallic, AO, camPos, hasLight);
 	}
 	if (renderMode == 9) { 
 		if (use_skybox == true) {
@@ -0,0 +1,60 @@
+in vec2 outTexCoord;
+
+out vec4 fragColor;
+
+// the per pixel screen effects in one pass, each one is turned on by its define. The renderer generates a variant for
+// every combination of enabled effects. They are applied in the order of IScreenEffect::FusedStage.
+
+layout(binding = 7) uniform sampler2D sampler_color;
+
+#ifdef FUSE_BLOOM
+layout(binding = 8) uniform sampler2D sampler_bloom;
+
+uniform float bloomWeight = 1.0;
+#endif
+
+#ifdef FUSE_VIGNETTE
+uniform float vignetteStrength = 0.5;
+uniform float vignetteRadius   = 0.5;
+uniform float vignetteSoftness = 0.5;
+#endif
+
+#ifdef FUSE_TONEMAP
+uniform float exposure = 1.0;
+
+// ACES tone mapping curve fit to go from HDR to LDR
+// https://knarkowicz.wordpress.com/2016/01/06/aces-filmic-tone-mapping-curve/
+vec3 ACESFilm(vec3 x) {
+	float a = 2.51;
+	float b = 0.03;
+	float c = 2.43;
+	float d = 0.59;
+	float e = 0.14;
+	return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0, 1.0);
+}
+
+vec3 LinearToInverseGamma(vec3 rgb, float gamma) {
+	return mix(pow(rgb, vec3(1.0 / gamma)) * 1.055 - 0.055, rgb * 12.92, vec3(lessThan(rgb, 0.0031308.xxx)));
+}
+#endif
+
+void main() {
+	vec4 color = texture(sampler_color, outTexCoord);
+
+#ifdef FUSE_BLOOM
+	color.rgb += texture(sampler_bloom, outTexCoord).rgb * bloomWeight;
+#endif
+
+#ifdef FUSE_VIGNETTE
+	// distance from the center, 1 in the corners
+	float distance = length(outTexCoord - 0.5) * 1.41421356;
+	color.rgb *= 1.0 - vignetteStrength * smoothstep(vignetteRadius, vignetteRadius + vignetteSoftness, distance);
+#endif
+
+#ifdef FUSE_TONEMAP
+	color.rgb = ACESFilm(color.rgb * exposure);
+	color.rgb = LinearToInverseGamma(color.rgb, 2.4);
+#endif
+
+	fragColor = color;
+}
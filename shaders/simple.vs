@@ -2,6 +2,9 @@
 
 #include <rendering.glsl>
 
+// the depth prepass draws with this shader too, GL_EQUAL needs the same depth in both passes
+invariant gl_Position;
+
 out vec4 vColor;
 out vec2 vTexCoord;
 out vec3 vVertexNormal;
@@ -9,6 +12,9 @@ out vec3 vVertexPos;
 out mat3 vTBN;
 
 uniform mat4 worldMatrix;
+// set by the renderer when it draws many objects with one call, each with its own matrix
+uniform bool instanced = false;
+layout(location = 8) in mat4 instanceMatrix;
 
 const int MAX_BONES = 200;
 const int MAX_BONE_INFLUENCE = 4;
@@ -41,17 +47,18 @@ void main() {
 		totalNormal = normal;
 	}
 
-	vec4 vPos = worldMatrix * totalPosition;
+	mat4 model = instanced ? instanceMatrix : worldMatrix;
+	vec4 vPos = model * totalPosition;
 
 	gl_PointSize = 5.0;
 	gl_Position = projectionMatrix * viewMatrix * vPos;
 	
 	vColor = color;
 	vTexCoord = texCoord;
-	vVertexNormal = normalize(worldMatrix * vec4(totalNormal, 0.0)).xyz;
+	vVertexNormal = normalize(model * vec4(totalNormal, 0.0)).xyz;
 	vVertexPos = vPos.xyz;
 
-	vec3 worldSpaceTangent = normalize(vec3(worldMatrix * vec4(tangent, 0.0)));
+	vec3 worldSpaceTangent = normalize(vec3(model * vec4(tangent, 0.0)));
 
 	// re-orthogonalize T with respect to N
 	worldSpaceTangent = normalize(worldSpaceTangent - dot(worldSpaceTangent, vVertexNormal) * vVertexNormal);
@@ -1,4 +1,5 @@
 #include <animations.h>
+#include <algorithm>
 #if !defined( YGL_NO_ASSIMP)
 
 ygl::Bone::Bone(const std::string &name, int ID, const aiNodeAnim *channel, float duration, AnimationBehaviour behaviour)
@@ -35,27 +36,45 @@ ygl::Bone::Bone(const std::string &name, int ID, const aiNodeAnim *channel, floa
 	}
 }
 
-void ygl::Bone::Update(float animationTime) {
+float ygl::Bone::GetLocalTime(float animationTime) const {
 	switch (behaviour) {
-		case Loop: animationTime = fmod(animationTime, m_Duration); break;
-		case Stop: animationTime = glm::min<float>(animationTime, m_Duration - 0.01); break;
+		case Loop: return fmod(animationTime, m_Duration);
+		case Stop: return glm::min<float>(animationTime, m_Duration - 0.01);
 		default: assert(false && "invalid animation behaviour");
 	}
-	glm::vec3 translation = InterpolatePosition(animationTime);
-	glm::quat rotation	  = InterpolateRotation(animationTime);
-	glm::vec3 scale		  = InterpolateScaling(animationTime);
-	glm::mat4 t			  = glm::translate(glm::mat4(1), translation);
-	glm::mat4 r			  = glm::toMat4(rotation);
-	glm::mat4 s			  = glm::scale(glm::mat4(1), scale);
-	m_LocalTransform	  = t * r * s;
-	m_LocalTranslation	  = translation;
-	m_LocalRotation		  = rotation;
-	m_LocalScale		  = scale;
-	currentTime			  = animationTime;
+	return animationTime;
+}
+
+void ygl::Bone::Update(float animationTime) {
+	glm::vec3 translation, scale;
+	glm::quat rotation;
+	Sample(animationTime, translation, rotation, scale);
+	m_LocalTransform   = ComposeTransform(translation, rotation, scale);
+	m_LocalTranslation = translation;
+	m_LocalRotation	   = rotation;
+	m_LocalScale	   = scale;
+	currentTime		   = GetLocalTime(animationTime);
+}
+
+void ygl::Bone::Sample(float animationTime, glm::vec3 &translation, glm::quat &rotation, glm::vec3 &scale) const {
+	animationTime = GetLocalTime(animationTime);
+	translation	  = InterpolatePosition(animationTime);
+	rotation	  = InterpolateRotation(animationTime);
+	scale		  = InterpolateScaling(animationTime);
+}
+
+glm::mat4 ygl::Bone::ComposeTransform(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale) {
+	glm::mat4 result = glm::toMat4(rotation);
+	result[0] *= scale.x;
+	result[1] *= scale.y;
+	result[2] *= scale.z;
+	result[3] = glm::vec4(translation, 1.0f);
+	return result;
 }
 
 template <class T>
-static int getIndex(float animationTime, std::vector<T> keys, float &currentAnimationTime, size_t &currentIndex) {
+static int getIndex(float animationTime, const std::vector<T> &keys, float &currentAnimationTime,
+					size_t &currentIndex) {
 	size_t startIndex = 0;
 	if (animationTime >= currentAnimationTime) { startIndex = currentIndex; }
 
@@ -68,6 +87,15 @@ static int getIndex(float animationTime, std::vector<T> keys, float &currentAnim
 	return keys.size() - 1;
 }
 
+/// index of the last key before \a animationTime, found with a binary search so it does not depend on previous calls
+template <class T>
+static uint findKey(float animationTime, const std::vector<T> &keys) {
+	auto next = std::upper_bound(keys.begin(), keys.end(), animationTime,
+								 [](float time, const T &key) { return time < key.timeStamp; });
+	if (next == keys.begin()) return 0;
+	return next - keys.begin() - 1;
+}
+
 uint ygl::Bone::GetPositionIndex(float animationTime) {
 	return getIndex(animationTime, m_Positions, currentTime, currentPositionIndex);
 }
@@ -88,10 +116,10 @@ float ygl::Bone::GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float
 	return scaleFactor;
 }
 
-glm::vec3 ygl::Bone::InterpolatePosition(float animationTime) {
+glm::vec3 ygl::Bone::InterpolatePosition(float animationTime) const {
 	if (1 == m_NumPositions) return m_Positions[0].position;
 
-	uint p0Index = GetPositionIndex(animationTime);
+	uint p0Index = findKey(animationTime, m_Positions);
 	uint p1Index = p0Index + 1;
 	if (p1Index >= m_Positions.size()) --p1Index;
 	float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp, m_Positions[p1Index].timeStamp, animationTime);
@@ -99,13 +127,13 @@ glm::vec3 ygl::Bone::InterpolatePosition(float animationTime) {
 	return finalPosition;
 }
 
-glm::quat ygl::Bone::InterpolateRotation(float animationTime) {
+glm::quat ygl::Bone::InterpolateRotation(float animationTime) const {
 	if (1 == m_NumRotations) {
 		auto rotation = glm::normalize(m_Rotations[0].orientation);
 		return rotation;
 	}
 
-	uint p0Index = GetRotationIndex(animationTime);
+	uint p0Index = findKey(animationTime, m_Rotations);
 	uint p1Index = p0Index + 1;
 	if (p1Index >= m_Rotations.size()) --p1Index;
 	float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp, m_Rotations[p1Index].timeStamp, animationTime);
@@ -115,10 +143,10 @@ glm::quat ygl::Bone::InterpolateRotation(float animationTime) {
 	return finalRotation;
 }
 
-glm::vec3 ygl::Bone::InterpolateScaling(float animationTime) {
+glm::vec3 ygl::Bone::InterpolateScaling(float animationTime) const {
 	if (1 == m_NumScalings) return m_Scales[0].scale;
 
-	uint p0Index = GetScaleIndex(animationTime);
+	uint p0Index = findKey(animationTime, m_Scales);
 	uint p1Index = p0Index + 1;
 	if (p1Index >= m_Scales.size()) --p1Index;
 	float	  scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp, m_Scales[p1Index].timeStamp, animationTime);
@@ -1,4 +1,7 @@
 #include <buffer.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 ygl::Buffer::Buffer(ygl::Buffer &&other) {
 	this->buffer = other.buffer;
@@ -10,7 +13,7 @@ ygl::Buffer::Buffer(ygl::Buffer &&other) {
 
 ygl::Buffer &ygl::Buffer::operator=(ygl::Buffer &&other) {
 	if (this != &other) {
-		glDeleteBuffers(1, &buffer);
+		GLState::deleteBuffer(buffer);
 		this->buffer = other.buffer;
 		this->target = other.target;
 		this->size	 = other.size;
@@ -23,11 +26,11 @@ ygl::Buffer &ygl::Buffer::operator=(ygl::Buffer &&other) {
 void ygl::Buffer::bind(GLenum target) {
 	assert(buffer != 0 && "please initialize the buffer");
 	this->target = target;
-	glBindBuffer(target, buffer);
+	GLState::bindBuffer(target, buffer);
 	bound = true;
 }
 
-void ygl::Buffer::unbind() { glBindBuffer(target, 0); }
+void ygl::Buffer::unbind() { GLState::bindBuffer(target, 0); }
 
 void ygl::Buffer::set(void *data, GLsizeiptr size, GLsizeiptr offset) {
 	Bind b(this);
@@ -66,3 +69,134 @@ ygl::Bind &ygl::Bind::operator=(ygl::Bind &&other) {
 	}
 	return *this;
 }
+
+ygl::RingBuffer::RingBuffer(GLsizeiptr regionSize, uint regionsCount)
+	: regionSize(alignSize(regionSize, getRegionAlignment())), fences(regionsCount, nullptr) {
+	create();
+}
+
+ygl::RingBuffer::~RingBuffer() {
+	for (GLsync fence : fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	// the data the GPU still reads is kept until it is done, even after the buffer is deleted
+	GLState::deleteBuffer(buffer);
+}
+
+void ygl::RingBuffer::create() {
+	GLsizeiptr size = regionSize * fences.size();
+	glGenBuffers(1, &buffer);
+	// bound to a target that nothing draws from, so that other bindings are not disturbed
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+	mapped = (uint8_t *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	if (mapped == nullptr) dbLog(ygl::LOG_ERROR, "RingBuffer: failed to map a buffer of size ", (int64_t)size);
+#else
+	// WebGL can't map buffers, so the data is uploaded with glBufferSubData
+	glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+#endif
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	region = 0;
+	head   = 0;
+}
+
+ygl::RingBuffer::Range ygl::RingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+	if (size <= 0) return Range();
+	assert(getRegionAlignment() % alignment == 0 && "the regions are not aligned to that");
+	GLintptr offset = place(region, regionSize, head, size, alignment);
+	if (offset < 0) {
+		dbLog(ygl::LOG_ERROR, "RingBuffer: ", (int64_t)size, " bytes do not fit in a region of ", (int64_t)regionSize);
+		return Range();
+	}
+	return Range{offset, size};
+}
+
+GLintptr ygl::RingBuffer::place(uint region, GLsizeiptr regionSize, GLsizeiptr &head, GLsizeiptr size,
+								GLsizeiptr alignment) {
+	GLsizeiptr offset = alignSize(head, alignment);
+	if (offset + size > regionSize) return -1;
+	head = offset + size;
+	return (GLintptr)(region * regionSize + offset);
+}
+
+void ygl::RingBuffer::write(const Range &range, GLintptr offset, const void *data, GLsizeiptr size) {
+	assert(offset + size <= range.size && "writing outside of the range");
+	if (size == 0) return;
+#ifndef YGL_NO_COMPUTE_SHADERS
+	if (mapped) std::memcpy(mapped + range.offset + offset, data, size);
+#else
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset + offset, size, data);
+	GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+#endif
+}
+
+ygl::RingBuffer::Range ygl::RingBuffer::write(const void *data, GLsizeiptr size, GLsizeiptr alignment) {
+	Range range = allocate(size, alignment);
+	if (range.size) write(range, 0, data, size);
+	return range;
+}
+
+void ygl::RingBuffer::bindRange(GLenum target, GLuint index, const Range &range) const {
+	if (range.size) GLState::bindBufferRange(target, index, buffer, range.offset, range.size);
+}
+
+void ygl::RingBuffer::nextFrame() {
+#ifndef YGL_NO_COMPUTE_SHADERS
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+	region = (region + 1) % fences.size();
+	head   = 0;
+	wait(region);
+}
+
+void ygl::RingBuffer::wait(uint region) {
+	GLsync &fence = fences[region];
+	if (!fence) return;
+	// the first wait flushes, otherwise the fence might never reach the GPU
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (true) {
+		GLenum result = glClientWaitSync(fence, flags, 1000000000);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) break;
+		if (result == GL_WAIT_FAILED) {
+			dbLog(ygl::LOG_ERROR, "RingBuffer: waiting for a fence failed");
+			break;
+		}
+		flags = 0;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void ygl::RingBuffer::reserve(GLsizeiptr regionSize) {
+	if (regionSize <= this->regionSize) return;
+	for (GLsync &fence : fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	GLState::deleteBuffer(buffer);
+	this->regionSize = alignSize(regionSize, getRegionAlignment());
+	create();
+}
+
+GLsizeiptr ygl::RingBuffer::getOffsetAlignment(GLenum target) {
+	static GLint uniformAlignment = 0;
+	if (uniformAlignment == 0) glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	static GLint storageAlignment = 0;
+	if (storageAlignment == 0) glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+	if (target == GL_SHADER_STORAGE_BUFFER) return storageAlignment;
+#endif
+	if (target == GL_UNIFORM_BUFFER) return uniformAlignment;
+	return 16;
+}
+
+GLsizeiptr ygl::RingBuffer::getRegionAlignment() {
+	GLsizeiptr alignment = std::max<GLsizeiptr>(getOffsetAlignment(GL_UNIFORM_BUFFER), 16);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	alignment = std::max(alignment, getOffsetAlignment(GL_SHADER_STORAGE_BUFFER));
+#endif
+	return alignment;
+}
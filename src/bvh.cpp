@@ -3,13 +3,20 @@
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <bit>
 #include <vector>
 #include <iomanip>
 #include <glm/fwd.hpp>
 #include <shader.h>
+#include <gl_state.h>
 #include <transformation.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64)
+	#define YGL_BVH_SSE
+	#include <immintrin.h>
+#endif
+
 using namespace ygl::bvh;
 
 BBox::BBox(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
@@ -132,6 +139,36 @@ bool intersectTriangleFast(const Ray &ray, const glm::vec3 &A, const glm::vec3 &
 	return true;
 }
 
+bool Primitive::intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) {
+	const glm::vec3 invDir = 1.f / ray.dir;
+	const glm::vec3 t0	   = (box.min - ray.origin) * invDir;
+	const glm::vec3 t1	   = (box.max - ray.origin) * invDir;
+	const glm::vec3 tNear  = glm::min(t0, t1);
+	const glm::vec3 tFar   = glm::max(t0, t1);
+
+	int nearAxis = 0, farAxis = 0;
+	for (int i = 1; i < 3; ++i) {
+		if (tNear[i] > tNear[nearAxis]) nearAxis = i;
+		if (tFar[i] < tFar[farAxis]) farAxis = i;
+	}
+	if (tNear[nearAxis] > tFar[farAxis]) return false;
+
+	// when the ray starts inside the box the intersection is where it exits
+	bool  entering = tNear[nearAxis] >= tMin;
+	float t		   = entering ? tNear[nearAxis] : tFar[farAxis];
+	if (t < tMin || t > tMax) return false;
+
+	int axis = entering ? nearAxis : farAxis;
+
+	hit.t			 = t;
+	hit.p			 = ray.at(t);
+	hit.normal		 = glm::vec3(0.f);
+	hit.normal[axis] = (ray.dir[axis] > 0) == entering ? -1.f : 1.f;
+	hit.material	 = nullptr;
+	hit.primitive	 = this;
+	return true;
+}
+
 bool Triangle::boxIntersect(const BBox &box) {
 	if (box.inside(A) || box.inside(B) || box.inside(C)) { return true; }
 
@@ -183,6 +220,34 @@ glm::vec3 Triangle::getCenter() {
 	return sum / 3.f;
 }
 
+bool Triangle::intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) {
+	// Moller-Trumbore
+	const glm::vec3 e1	 = B - A;
+	const glm::vec3 e2	 = C - A;
+	const glm::vec3 pvec = glm::cross(ray.dir, e2);
+	const float		det	 = glm::dot(e1, pvec);
+	if (fabs(det) < 1e-12) return false;
+
+	const float		invDet = 1.f / det;
+	const glm::vec3 tvec   = ray.origin - A;
+	const float		u	   = glm::dot(tvec, pvec) * invDet;
+	if (u < 0 || u > 1) return false;
+
+	const glm::vec3 qvec = glm::cross(tvec, e1);
+	const float		v	 = glm::dot(ray.dir, qvec) * invDet;
+	if (v < 0 || u + v > 1) return false;
+
+	const float t = glm::dot(e2, qvec) * invDet;
+	if (t < tMin || t > tMax) return false;
+
+	hit.t		  = t;
+	hit.p		  = ray.at(t);
+	hit.normal	  = glm::normalize(glm::cross(e1, e2));
+	hit.material  = nullptr;
+	hit.primitive = this;
+	return true;
+}
+
 void Triangle::writeTo(char *buff, std::size_t offset) {
 	PrimitiveType type = PrimitiveType::TRIANGLE;
 	memcpy(buff + offset + 0 * sizeof(uint), &type, sizeof(uint));
@@ -193,6 +258,27 @@ void Triangle::print(std::ostream &os) {
 	os << "TRIANGLE : " << indices[0] << ' ' << indices[1] << ' ' << indices[2] << ';';
 }
 
+bool SpherePrimitive::intersect(const Ray &ray, float tMin, float tMax, Intersection &hit) {
+	const glm::vec3 oc = ray.origin - position;
+	const float		a  = glm::dot(ray.dir, ray.dir);
+	const float		b  = glm::dot(oc, ray.dir);
+	const float		c  = glm::dot(oc, oc) - radius * radius;
+	const float		d  = b * b - a * c;
+	if (d < 0) return false;
+
+	const float sqrtD = std::sqrt(d);
+	float		t	  = (-b - sqrtD) / a;
+	if (t < tMin) t = (-b + sqrtD) / a;
+	if (t < tMin || t > tMax) return false;
+
+	hit.t		  = t;
+	hit.p		  = ray.at(t);
+	hit.normal	  = (hit.p - position) / radius;
+	hit.material  = nullptr;
+	hit.primitive = this;
+	return true;
+}
+
 void SpherePrimitive::writeTo(char *buff, std::size_t offset) {
 	PrimitiveType type = PrimitiveType::SPHERE;
 	memcpy(buff + offset + 0 * sizeof(uint), &type, sizeof(uint));
@@ -231,13 +317,13 @@ void BVHTree::addPrimitive(ygl::Mesh *mesh, ygl::Transformation &transform) {
 
 	float	 *vertices = new float[verticesCount * 3];
 	uint32_t *indices  = new uint32_t[indicesCount * 3];
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->getVertices().bufferId);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mesh->getVertices().bufferId);
 	glGetBufferSubData(GL_ARRAY_BUFFER, 0, verticesCount * sizeof(float) * 3, vertices);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->getIBO());
+	GLState::bindBuffer(GL_ARRAY_BUFFER, mesh->getIBO());
 	glGetBufferSubData(GL_ARRAY_BUFFER, 0, indicesCount * sizeof(uint32_t), indices);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 
 	for (std::size_t i = 0; i < indicesCount; i += 3) {
 		uint32_t i0 = indices[i + 0];
@@ -260,9 +346,6 @@ void BVHTree::addPrimitive(ygl::Mesh *mesh, ygl::Transformation &transform) {
 
 void BVHTree::clear(Node *node) {
 	if (node == nullptr) return;
-	for (Intersectable *i : node->primitives) {
-		delete i;
-	}
 	for (int i = 0; i < 2; i++) {
 		clear(node->children[i]);
 		delete node->children[i];
@@ -270,10 +353,20 @@ void BVHTree::clear(Node *node) {
 }
 
 void BVHTree::clear() {
-	if (root != nullptr) clear(root);
 	clearConstructionTree();
+	for (Intersectable *i : allPrimitives) {
+		delete i;
+	}
 	allPrimitives.clear();
-	built = false;
+	buildPrimitives.clear();
+	gpuNodes.clear();
+	cpuLeaves.clear();
+	trianglePacks.clear();
+	otherPrimitives.clear();
+	depth = leafSize = 0;
+	leavesCount = nodeCount = primitivesCount = 0;
+	sahCost									  = 0;
+	built									  = false;
 }
 
 void BVHTree::clearConstructionTree() {
@@ -282,86 +375,105 @@ void BVHTree::clearConstructionTree() {
 	root = nullptr;
 }
 
-void BVHTree::build(Node *node, int depth) {
-	if (depth > MAX_DEPTH || node->primitives.size() <= MIN_PRIMITIVES_COUNT) {
-		leafSize = std::max((int)(node->primitives.size()), leafSize);
-		++leavesCount;
-		return;
-	}
-	this->depth = std::max(depth, this->depth);
+void BVHTree::build(Node *node, std::size_t offset, std::size_t count, int depth, BuildStats &stats) {
+	BuildPrimitive *prims = buildPrimitives.data() + offset;
+	node->primOffset	  = offset;
+	node->primCount		  = count;
 
-	// get a bounding box of all centroids
+	// get the bounding box of the node and the bounding box of all centroids
 	BBox centerBox;
-	for (Intersectable *obj : node->primitives) {
-		centerBox.add(obj->getCenter());
+	for (std::size_t i = 0; i < count; ++i) {
+		node->box.add(prims[i].box);
+		centerBox.add(prims[i].center);
+	}
+
+	if (depth > MAX_DEPTH || count <= MIN_PRIMITIVES_COUNT) {
+		stats.leafSize = std::max((int)count, stats.leafSize);
+		++stats.leavesCount;
+		return;
+	}
+	stats.depth = std::max(depth, stats.depth);
+
+	// sort the centroids into bins on every axis and find the split between bins with the lowest SAH cost
+	struct Bin {
+		BBox		box;
+		std::size_t count = 0;
+	};
+	const glm::vec3 extent = centerBox.max - centerBox.min;
+	glm::vec3		scale;
+	for (int axis = 0; axis < 3; ++axis) {
+		scale[axis] = extent[axis] > 0 ? SAH_BINS_COUNT / extent[axis] : 0;
 	}
-	glm::vec3 size = centerBox.max - centerBox.min;
-
-	// find the axis on which the box is largest
-	char  maxAxis	   = -1;
-	float maxAxisValue = -FLT_MAX;
-	for (int i = 0; i < 3; ++i) {
-		if (maxAxisValue < size[i]) {
-			maxAxis		 = i;
-			maxAxisValue = size[i];
+	auto binIndex = [&](const BuildPrimitive &p, int axis) {
+		int bin = int((p.center[axis] - centerBox.min[axis]) * scale[axis]);
+		return std::min(bin, SAH_BINS_COUNT - 1);
+	};
+
+	Bin bins[3][SAH_BINS_COUNT];
+	for (std::size_t i = 0; i < count; ++i) {
+		for (int axis = 0; axis < 3; ++axis) {
+			Bin &bin = bins[axis][binIndex(prims[i], axis)];
+			bin.box.add(prims[i].box);
+			++bin.count;
 		}
 	}
-	node->splitAxis = maxAxis;
-
-	// choose splitting algorithm
-	if (node->primitives.size() < PERFECT_SPLIT_THRESHOLD) {
-		unsigned long int size = node->primitives.size();
-		// sorts so that the middle element is in its place, all others are in sorted order relative to it
-		std::nth_element(
-			node->primitives.begin(), node->primitives.begin() + size * 0.5, node->primitives.end(),
-			[&](Intersectable *&a, Intersectable *&b) { return a->getCenter()[maxAxis] < b->getCenter()[maxAxis]; });
-		node->left	= new Node();
-		node->right = new Node();
-		nodeCount += 2;
-
-		// split in half
-		for (unsigned long int i = 0; i < size; ++i) {
-			bool ind = i > (size / 2 - 1);
-			node->primitives[i]->expandBox(node->children[ind]->box);
-			node->children[ind]->primitives.push_back(node->primitives[i]);
+
+	const float parentArea = node->box.surfaceArea();
+	float		bestSAH	   = FLT_MAX;
+	int			bestAxis = -1, bestSplit = -1;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (extent[axis] <= 0) continue;
+
+		// rightArea[i] and rightCount[i] describe the bins i..SAH_BINS_COUNT-1
+		float		rightArea[SAH_BINS_COUNT];
+		std::size_t rightCount[SAH_BINS_COUNT];
+		BBox		box;
+		std::size_t sum = 0;
+		for (int i = SAH_BINS_COUNT - 1; i > 0; --i) {
+			box.add(bins[axis][i].box);
+			sum += bins[axis][i].count;
+			rightArea[i]  = sum ? box.surfaceArea() : 0;
+			rightCount[i] = sum;
 		}
-	} else {
-		long int noSplitSAH = node->primitives.size();
 
-		// try evenly distributed splits with SAH
-		float bestSAH = FLT_MAX, bestRatio = -1;
-		for (int i = 0; i < SAH_TRY_COUNT; ++i) {
-			float ratio = float(i + 1.) / float(SAH_TRY_COUNT + 1);
-			float sah	= costSAH(node, maxAxis, ratio);
+		box = BBox();
+		sum = 0;
+		for (int i = 1; i < SAH_BINS_COUNT; ++i) {
+			box.add(bins[axis][i - 1].box);
+			sum += bins[axis][i - 1].count;
+			if (sum == 0 || rightCount[i] == 0) continue;
+			float sah = SAH_TRAVERSAL_COST + (box.surfaceArea() * sum + rightArea[i] * rightCount[i]) / parentArea;
 			if (bestSAH > sah) {
 				bestSAH	  = sah;
-				bestRatio = ratio;
+				bestAxis  = axis;
+				bestSplit = i;
 			}
 		}
+	}
 
+	std::size_t leftCount;
+	if (bestAxis == -1) {
+		// all centroids are in the same point, SAH can't separate them
+		leftCount = count / 2;
+		bestAxis  = 0;
+	} else if (bestSAH > count) {
 		// create a leaf when the node can't be split effectively
-		if (bestSAH > noSplitSAH) {
-			leafSize = std::max((int)(node->primitives.size()), leafSize);
-			++leavesCount;
-			return;
-		}
-
-		// position of the split plane. lerp between min and max
-		const float split = node->box.min[maxAxis] * bestRatio + node->box.max[maxAxis] * (1 - bestRatio);
-		// distibute the primitives to the child nodes
-		node->left	= new Node();
-		node->right = new Node();
-		nodeCount += 2;
-		for (Intersectable *obj : node->primitives) {
-			int ind = obj->getCenter()[maxAxis] > split;
-			obj->expandBox(node->children[ind]->box);
-			node->children[ind]->primitives.push_back(obj);
-		}
+		stats.leafSize = std::max((int)count, stats.leafSize);
+		++stats.leavesCount;
+		return;
+	} else {
+		BuildPrimitive *middle = std::partition(
+			prims, prims + count, [&](const BuildPrimitive &p) { return binIndex(p, bestAxis) < bestSplit; });
+		leftCount = middle - prims;
 	}
+	node->splitAxis = bestAxis;
 
-	build(node->left, depth + 1);
-	build(node->right, depth + 1);
-	node->primitives.clear();
+	node->left	= new Node();
+	node->right = new Node();
+	stats.nodeCount += 2;
+
+	build(node->left, offset, leftCount, depth + 1, stats);
+	build(node->right, offset + leftCount, count - leftCount, depth + 1, stats);
 }
 
 void BVHTree::build(Purpose purpose) {
@@ -373,78 +485,130 @@ void BVHTree::build(Purpose purpose) {
 
 	primitivesCount = allPrimitives.size();
 
-	root = new Node();
-	root->primitives.swap(allPrimitives);
-	for (unsigned long int c = 0; c < root->primitives.size(); ++c) {
-		root->primitives[c]->expandBox(root->box);
+	// the primitives are accessed only through their precomputed bounds during construction
+	buildPrimitives.resize(allPrimitives.size());
+	for (std::size_t i = 0; i < allPrimitives.size(); ++i) {
+		BuildPrimitive &p = buildPrimitives[i];
+		allPrimitives[i]->expandBox(p.box);
+		p.center = allPrimitives[i]->getCenter();
+		p.index	 = i;
 	}
+
 	// build both trees
-	Timer buildTimer;
-	build(root, 0);
+	Timer	   buildTimer;
+	BuildStats stats;
+	root = new Node();
+	build(root, 0, buildPrimitives.size(), 0, stats);
+	depth		= stats.depth;
+	leafSize	= stats.leafSize;
+	leavesCount = stats.leavesCount;
+	nodeCount	= stats.nodeCount;
+
+	// order the primitives the same way as the leaves
+	std::vector<Intersectable *> orderedPrimitives(allPrimitives.size());
+	for (std::size_t i = 0; i < buildPrimitives.size(); ++i) {
+		orderedPrimitives[i] = allPrimitives[buildPrimitives[i].index];
+	}
+	allPrimitives.swap(orderedPrimitives);
+	buildPrimitives.clear();
+	buildPrimitives.shrink_to_fit();
 	printf("Main Tree built: %lldms\n", (long long int)buildTimer.toMs(buildTimer.elapsedNs()));
 
 	Timer gpuTimer;
 	buildGPUTree();
+	buildCPULeaves();
+#if !defined(YGL_NO_COMPUTE_SHADERS)
+	if (uploadToGPU) uploadGPUTree();
+#endif
 	printf("GPU Tree built: %lldms\n", (long long int)gpuTimer.toMs(gpuTimer.elapsedNs()));
 
 	// construction tree is no longer needed
 	clearConstructionTree();
 
 	built = true;
-	printf(" done in %lldms, nodes: %ld, leaves: %ld, depth %d, %d leaf size\n",
-		   (long long int)timer.toMs(timer.elapsedNs()), nodeCount, leavesCount, depth, leafSize);
-}
-
-float BVHTree::costSAH(const Node *node, int axis, float ratio) {
-	// effectively a lerp between the min and max of the box
-	const float split	 = node->box.min[axis] * ratio + node->box.max[axis] * (1 - ratio);
-	long int	count[2] = {0, 0};
-	BBox		boxes[2];
-	// count indices and merge bounding boxes in both children
-	for (Intersectable *obj : node->primitives) {
-		int ind = (obj->getCenter()[axis] > split);
-		++count[ind];
-		obj->expandBox(boxes[ind]);
-	}
-	// just the formula
-	float s0   = node->box.surfaceArea();
-	float s[2] = {count[0] ? boxes[0].surfaceArea() : 0, count[1] ? boxes[1].surfaceArea() : 0};
-	return SAH_TRAVERSAL_COST + (s[0] * count[0] + s[1] * count[1]) / s0;
+	printf(" done in %lldms, nodes: %ld, leaves: %ld, depth %d, %d leaf size, SAH cost %f\n",
+		   (long long int)timer.toMs(timer.elapsedNs()), nodeCount, leavesCount, depth, leafSize, sahCost);
 }
 
-void BVHTree::buildGPUTree_h(BVHTree::Node *node, unsigned long int parent, std::vector<BVHTree::GPUNode> &gpuNodes,
-							 std::vector<Intersectable *> &primitives) {
+void BVHTree::buildGPUTree_h(BVHTree::Node *node, unsigned long int parent, std::vector<BVHTree::GPUNode> &gpuNodes) {
 	BVHTree::GPUNode current;
 	current.min	   = node->box.min;
 	current.max	   = node->box.max;
 	current.parent = parent;
 	if (node->isLeaf()) {
 		current.right	   = 0;
-		current.primOffset = primitives.size();
-		current.primCount  = node->primitives.size();
-		for (Intersectable *p : node->primitives) {
-			primitives.push_back(p);
-		}
+		current.primOffset = node->primOffset;
+		current.primCount  = node->primCount;
+		sahCost += node->box.surfaceArea() * node->primCount;
 	} else {
 		current.primOffset = 0;
 		current.primCount  = 0;
+		sahCost += node->box.surfaceArea() * SAH_TRAVERSAL_COST;
 	}
 	gpuNodes.push_back(current);
 	unsigned long int currIndex = gpuNodes.size() - 1;
 
 	if (node->isLeaf()) return;
 
-	buildGPUTree_h(node->left, currIndex, gpuNodes, primitives);
+	buildGPUTree_h(node->left, currIndex, gpuNodes);
 	gpuNodes[currIndex].right = gpuNodes.size();
-	buildGPUTree_h(node->right, currIndex, gpuNodes, primitives);
+	buildGPUTree_h(node->right, currIndex, gpuNodes);
 }
 
-#if !defined( YGL_NO_COMPUTE_SHADERS)
 void BVHTree::buildGPUTree() {
-	gpuNodes.reserve(nodeCount);
-	std::vector<Intersectable *> orderedPrimitives;
+	gpuNodes.reserve(nodeCount + 1);
+
+	sahCost = 0;
+	buildGPUTree_h(root, 0, gpuNodes);
+	if (root->box.surfaceArea() > 0) sahCost /= root->box.surfaceArea();
+}
+
+void BVHTree::buildCPULeaves() {
+	cpuLeaves.assign(gpuNodes.size(), CPULeaf{0, 0, 0, 0});
+	trianglePacks.clear();
+	otherPrimitives.clear();
+
+	TrianglePack emptyPack;
+	memset(&emptyPack, 0, sizeof(emptyPack));
+	for (uint32_t &p : emptyPack.primitive) {
+		p = UINT32_MAX;
+	}
+
+	for (std::size_t i = 0; i < gpuNodes.size(); ++i) {
+		const GPUNode &node = gpuNodes[i];
+		if (!node.isLeaf()) continue;
+
+		CPULeaf &leaf	 = cpuLeaves[i];
+		leaf.packOffset	 = trianglePacks.size();
+		leaf.otherOffset = otherPrimitives.size();
+		int lane		 = 4;
+		for (uint32_t p = node.primOffset; p < node.primOffset + node.primCount; ++p) {
+			Triangle *triangle = dynamic_cast<Triangle *>(allPrimitives[p]);
+			if (triangle == nullptr) {
+				otherPrimitives.push_back(p);
+				continue;
+			}
+			if (lane == 4) {
+				trianglePacks.push_back(emptyPack);
+				lane = 0;
+			}
+			TrianglePack &pack = trianglePacks.back();
+			for (int axis = 0; axis < 3; ++axis) {
+				pack.v0[axis][lane] = triangle->A[axis];
+				pack.e1[axis][lane] = triangle->B[axis] - triangle->A[axis];
+				pack.e2[axis][lane] = triangle->C[axis] - triangle->A[axis];
+			}
+			pack.primitive[lane] = p;
+			++lane;
+		}
+		leaf.packCount	= trianglePacks.size() - leaf.packOffset;
+		leaf.otherCount = otherPrimitives.size() - leaf.otherOffset;
+	}
+}
 
-	if (!(root->isLeaf())) buildGPUTree_h(root, 0, gpuNodes, orderedPrimitives);
+#if !defined(YGL_NO_COMPUTE_SHADERS)
+void BVHTree::uploadGPUTree() {
+	std::vector<Intersectable *> &orderedPrimitives = allPrimitives;
 
 	// TODO: convert all primitives to GPU format and figure out how to access them by indices
 	// primitive data:
@@ -460,23 +624,245 @@ void BVHTree::buildGPUTree() {
 	// send buff to gpu
 	GLuint primitivesBuff;
 	glGenBuffers(1, &primitivesBuff);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, primitivesBuff);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, primitivesBuff);
 	glBufferData(GL_SHADER_STORAGE_BUFFER, buffSize, buff, GL_STATIC_DRAW);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
 	ygl::Shader::setSSBO(primitivesBuff, 7);
 
 	GLuint nodesBuff;
 	glGenBuffers(1, &nodesBuff);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, nodesBuff);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, nodesBuff);
 	glBufferData(GL_SHADER_STORAGE_BUFFER, gpuNodes.size() * sizeof(GPUNode), gpuNodes.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
 	ygl::Shader::setSSBO(nodesBuff, 5);
 	delete[] buff;
 }
 #endif
-BVHTree::~BVHTree() {
-	clear();
-	clearConstructionTree();
+namespace {
+// ray data that is reused for every node and triangle test
+struct TraversalRay {
+#ifdef YGL_BVH_SSE
+	__m128 origin, invDir;
+	__m128 ox, oy, oz;
+	__m128 dx, dy, dz;
+#else
+	glm::vec3 origin, invDir;
+	glm::vec3 dir;
+#endif
+
+	TraversalRay(const Ray &ray) {
+		const glm::vec3 invDir = 1.f / ray.dir;
+#ifdef YGL_BVH_SSE
+		this->origin = _mm_setr_ps(ray.origin.x, ray.origin.y, ray.origin.z, 0.f);
+		this->invDir = _mm_setr_ps(invDir.x, invDir.y, invDir.z, 0.f);
+		ox			 = _mm_set1_ps(ray.origin.x);
+		oy			 = _mm_set1_ps(ray.origin.y);
+		oz			 = _mm_set1_ps(ray.origin.z);
+		dx			 = _mm_set1_ps(ray.dir.x);
+		dy			 = _mm_set1_ps(ray.dir.y);
+		dz			 = _mm_set1_ps(ray.dir.z);
+#else
+		this->origin = ray.origin;
+		this->invDir = invDir;
+		dir			 = ray.dir;
+#endif
+	}
+};
+}	  // namespace
+
+/// @brief slab test of \a ray against the box [\a min, \a max]. Writes the distance to the box in \a tNear.
+/// \a min and \a max must be followed by 4 more bytes, as in GPUNode
+static inline bool intersectBox(const TraversalRay &ray, const glm::vec3 &min, const glm::vec3 &max, float tMin,
+								float tMax, float &tNear) {
+#ifdef YGL_BVH_SSE
+	// the fourth lane is loaded from the next field of GPUNode and ignored
+	const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&min.x), ray.origin), ray.invDir);
+	const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&max.x), ray.origin), ray.invDir);
+	const __m128 lo = _mm_min_ps(t0, t1);
+	const __m128 hi = _mm_max_ps(t0, t1);
+
+	__m128 entry = _mm_max_ss(_mm_max_ss(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 1, 1, 1))),
+							  _mm_max_ss(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 2, 2, 2)), _mm_set_ss(tMin)));
+	__m128 exit	 = _mm_min_ss(_mm_min_ss(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 1, 1, 1))),
+							  _mm_min_ss(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 2, 2, 2)), _mm_set_ss(tMax)));
+	tNear		 = _mm_cvtss_f32(entry);
+	return _mm_comile_ss(entry, exit);
+#else
+	const glm::vec3 t0 = (min - ray.origin) * ray.invDir;
+	const glm::vec3 t1 = (max - ray.origin) * ray.invDir;
+	const glm::vec3 lo = glm::min(t0, t1);
+	const glm::vec3 hi = glm::max(t0, t1);
+
+	float entry = std::max(std::max(lo.x, lo.y), std::max(lo.z, tMin));
+	float exit	= std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+	tNear		= entry;
+	return entry <= exit;
+#endif
+}
+
+/// @brief Moller-Trumbore test of \a ray against the 4 triangles in \a pack.
+/// @return the index of the closest intersected triangle that is closer than \a closest or -1. Updates \a closest
+static inline int intersectPack(const TraversalRay &ray, const float (&v0)[3][4], const float (&e1)[3][4],
+								const float (&e2)[3][4], float tMin, float &closest) {
+#ifdef YGL_BVH_SSE
+	const __m128 e1x = _mm_load_ps(e1[0]), e1y = _mm_load_ps(e1[1]), e1z = _mm_load_ps(e1[2]);
+	const __m128 e2x = _mm_load_ps(e2[0]), e2y = _mm_load_ps(e2[1]), e2z = _mm_load_ps(e2[2]);
+
+	// pvec = dir x e2
+	const __m128 px	 = _mm_sub_ps(_mm_mul_ps(ray.dy, e2z), _mm_mul_ps(ray.dz, e2y));
+	const __m128 py	 = _mm_sub_ps(_mm_mul_ps(ray.dz, e2x), _mm_mul_ps(ray.dx, e2z));
+	const __m128 pz	 = _mm_sub_ps(_mm_mul_ps(ray.dx, e2y), _mm_mul_ps(ray.dy, e2x));
+	const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+
+	// tvec = origin - v0
+	const __m128 tx = _mm_sub_ps(ray.ox, _mm_load_ps(v0[0]));
+	const __m128 ty = _mm_sub_ps(ray.oy, _mm_load_ps(v0[1]));
+	const __m128 tz = _mm_sub_ps(ray.oz, _mm_load_ps(v0[2]));
+	const __m128 u =
+		_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+	// qvec = tvec x e1
+	const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	const __m128 v	= _mm_mul_ps(
+		 _mm_add_ps(_mm_add_ps(_mm_mul_ps(ray.dx, qx), _mm_mul_ps(ray.dy, qy)), _mm_mul_ps(ray.dz, qz)), invDet);
+	const __m128 t =
+		_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+	const __m128 zero	 = _mm_setzero_ps();
+	const __m128 absDet	 = _mm_andnot_ps(_mm_set1_ps(-0.f), det);
+	__m128		 mask	 = _mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f));
+	mask				 = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+	mask				 = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+	mask				 = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.f)));
+	mask				 = _mm_and_ps(mask, _mm_cmpge_ps(t, _mm_set1_ps(tMin)));
+	mask				 = _mm_and_ps(mask, _mm_cmple_ps(t, _mm_set1_ps(closest)));
+	if (_mm_movemask_ps(mask) == 0) return -1;
+
+	// find the closest of the intersected triangles
+	__m128 masked = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, _mm_set1_ps(FLT_MAX)));
+	__m128 minT	  = _mm_min_ps(masked, _mm_shuffle_ps(masked, masked, _MM_SHUFFLE(2, 3, 0, 1)));
+	minT		  = _mm_min_ps(minT, _mm_shuffle_ps(minT, minT, _MM_SHUFFLE(1, 0, 3, 2)));
+	int lanes	  = _mm_movemask_ps(_mm_and_ps(mask, _mm_cmpeq_ps(masked, minT)));
+	closest		  = _mm_cvtss_f32(minT);
+	return std::countr_zero((unsigned int)lanes);
+#else
+	int result = -1;
+	for (int i = 0; i < 4; ++i) {
+		const glm::vec3 edge1(e1[0][i], e1[1][i], e1[2][i]);
+		const glm::vec3 edge2(e2[0][i], e2[1][i], e2[2][i]);
+		const glm::vec3 pvec = glm::cross(ray.dir, edge2);
+		const float		det	 = glm::dot(edge1, pvec);
+		if (fabs(det) < 1e-12f) continue;
+
+		const float		invDet = 1.f / det;
+		const glm::vec3 tvec   = ray.origin - glm::vec3(v0[0][i], v0[1][i], v0[2][i]);
+		const float		u	   = glm::dot(tvec, pvec) * invDet;
+		const glm::vec3 qvec   = glm::cross(tvec, edge1);
+		const float		v	   = glm::dot(ray.dir, qvec) * invDet;
+		const float		t	   = glm::dot(edge2, qvec) * invDet;
+		if (u < 0 || v < 0 || u + v > 1 || t < tMin || t > closest) continue;
+		closest = t;
+		result	= i;
+	}
+	return result;
+#endif
+}
+
+bool BVHTree::traverse(const Ray &ray, float tMin, float tMax, Intersection &hit, bool anyHit) const {
+	if (gpuNodes.empty()) return false;
+
+	const TraversalRay traversalRay(ray);
+	float			   tNear;
+	if (!intersectBox(traversalRay, gpuNodes[0].min, gpuNodes[0].max, tMin, tMax, tNear)) return false;
+
+	struct StackEntry {
+		uint32_t node;
+		float	 tNear;
+	};
+	// only the far child is pushed at every level
+	StackEntry			stack[MAX_DEPTH + 8];
+	int					stackSize = 0;
+	uint32_t			current	  = 0;
+	float				closest	  = tMax;
+	bool				found	  = false;
+	const TrianglePack *hitPack	  = nullptr;
+	int					hitLane	  = -1;
+
+	while (true) {
+		const GPUNode &node = gpuNodes[current];
+		if (!node.isLeaf()) {
+			uint32_t	   left = current + 1, right = node.right;
+			const GPUNode &l = gpuNodes[left], &r = gpuNodes[right];
+			float		   tLeft, tRight;
+			bool		   hitLeft	= intersectBox(traversalRay, l.min, l.max, tMin, closest, tLeft);
+			bool		   hitRight = intersectBox(traversalRay, r.min, r.max, tMin, closest, tRight);
+			if (hitLeft && hitRight) {
+				// visit the closer child first
+				if (tRight < tLeft) {
+					std::swap(left, right);
+					std::swap(tLeft, tRight);
+				}
+				stack[stackSize++] = {right, tRight};
+				current			   = left;
+				continue;
+			}
+			if (hitLeft || hitRight) {
+				current = hitLeft ? left : right;
+				continue;
+			}
+		} else {
+			const CPULeaf &leaf = cpuLeaves[current];
+			for (uint32_t i = leaf.packOffset; i < leaf.packOffset + leaf.packCount; ++i) {
+				const TrianglePack &pack = trianglePacks[i];
+				int					lane = intersectPack(traversalRay, pack.v0, pack.e1, pack.e2, tMin, closest);
+				if (lane == -1) continue;
+				found	= true;
+				hitPack = &pack;
+				hitLane = lane;
+				if (anyHit) break;
+			}
+			for (uint32_t i = leaf.otherOffset; i < leaf.otherOffset + leaf.otherCount && !(found && anyHit); ++i) {
+				if (allPrimitives[otherPrimitives[i]]->intersect(ray, tMin, closest, hit)) {
+					found	= true;
+					closest = hit.t;
+					hitPack = nullptr;
+				}
+			}
+			if (found && anyHit) return true;
+		}
+
+		// pop the next node that can still contain a closer intersection
+		do {
+			if (stackSize == 0) {
+				if (found && hitPack != nullptr) {
+					glm::vec3 e1(hitPack->e1[0][hitLane], hitPack->e1[1][hitLane], hitPack->e1[2][hitLane]);
+					glm::vec3 e2(hitPack->e2[0][hitLane], hitPack->e2[1][hitLane], hitPack->e2[2][hitLane]);
+					hit.t		  = closest;
+					hit.p		  = ray.at(closest);
+					hit.normal	  = glm::normalize(glm::cross(e1, e2));
+					hit.material  = nullptr;
+					hit.primitive = allPrimitives[hitPack->primitive[hitLane]];
+				}
+				return found;
+			}
+			--stackSize;
+		} while (stack[stackSize].tNear > closest);
+		current = stack[stackSize].node;
+	}
 }
+
+bool BVHTree::intersect(const Ray &ray, Intersection &hit, float tMin, float tMax) const {
+	return traverse(ray, tMin, tMax, hit, false);
+}
+
+bool BVHTree::occluded(const Ray &ray, float tMin, float tMax) const {
+	Intersection hit;
+	return traverse(ray, tMin, tMax, hit, true);
+}
+
+BVHTree::~BVHTree() { clear(); }
@@ -1,5 +1,72 @@
 #include <camera.h>
 #include <shader.h>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#define YGL_FRUSTUM_SSE
+	#include <immintrin.h>
+#endif
+
+ygl::Frustum::Frustum(const glm::mat4 &viewProjection) {
+	// the rows of the matrix, glm stores columns
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	for (int i = 0; i < 3; ++i) {
+		planes[2 * i]	  = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+	for (glm::vec4 &plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool ygl::Frustum::intersectsSphere(const glm::vec4 &sphere) const {
+	for (const glm::vec4 &plane : planes) {
+		if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) return false;
+	}
+	return true;
+}
+
+bool ygl::Frustum::intersectsBox(const glm::vec3 &min, const glm::vec3 &max) const {
+	for (const glm::vec4 &plane : planes) {
+		// the corner furthest along the normal
+		glm::vec3 corner(plane.x > 0 ? max.x : min.x, plane.y > 0 ? max.y : min.y, plane.z > 0 ? max.z : min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) return false;
+	}
+	return true;
+}
+
+void ygl::Frustum::cullSpheres(const glm::vec4 *spheres, std::size_t count, uint8_t *visible) const {
+	std::size_t i = 0;
+#ifdef YGL_FRUSTUM_SSE
+	for (; i + 4 <= count; i += 4) {
+		// transposed so that each register holds the same component of four spheres
+		__m128 x = _mm_loadu_ps(&spheres[i].x);
+		__m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+		__m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+		__m128 r = _mm_loadu_ps(&spheres[i + 3].x);
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+		__m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+		__m128 outside = _mm_setzero_ps();
+		for (const glm::vec4 &plane : planes) {
+			__m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+			distance		= _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+			distance		= _mm_add_ps(distance, _mm_set1_ps(plane.w));
+			outside			= _mm_or_ps(outside, _mm_cmplt_ps(distance, negR));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int j = 0; j < 4; ++j) {
+			visible[i + j] = !(mask & (1 << j));
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		visible[i] = intersectsSphere(spheres[i]);
+	}
+}
 
 /// @brief constructor.
 /// @param fov Field of view
@@ -68,29 +135,42 @@ void ygl::Camera::setViewMatrix(glm::mat4 &view) { this->matrices.viewMatrix = v
 
 /// @brief Creates a Uniform Buffer Object so that the matrices can be sent to the GPU
 void ygl::Camera::createMatricesUBO() {
-	glGenBuffers(1, &uboMatrices);
-
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferData(GL_UNIFORM_BUFFER, 3 * sizeof(glm::mat4x4), nullptr, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
+	// a camera can be updated a few times in a frame, each update gets its own region
+	matricesBuffer = new RingBuffer(3 * sizeof(glm::mat4), 8);
+	updateMatricesUBO();
 	enable();
 }
 
-/// @brief Enables the camera to be used by shaders. (actually just binds the UBO to the shader binding point)
-void ygl::Camera::enable(int binding) { ygl::Shader::setUBO(uboMatrices, binding); }
+/// @brief Enables the camera to be used by shaders. (binds the current matrices to the shader binding point, and the
+/// new ones after each update)
+void ygl::Camera::enable(int binding) {
+	assert(binding >= 0 && binding < MAX_BINDINGS);
+	enabledCameras[binding] = this;
+	matricesBuffer->bindRange(GL_UNIFORM_BUFFER, binding, matricesRange);
+}
 
 /// @brief Disables the camera. (breaks the UBO binding)
-void ygl::Camera::disable() { ygl::Shader::setUBO(0, 0); }
+void ygl::Camera::disable() {
+	if (enabledCameras[0] == this) enabledCameras[0] = nullptr;
+	ygl::Shader::setUBO(0, 0);
+}
 
 /// @brief Sends the view and projection matrices to the GPU.
 void ygl::Camera::updateMatricesUBO() {
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+	glm::mat4 data[] = {matrices.projectionMatrix, matrices.viewMatrix, transform.getWorldMatrix()};
+	matricesBuffer->nextFrame();
+	matricesRange = matricesBuffer->write(data, sizeof(data), RingBuffer::getOffsetAlignment(GL_UNIFORM_BUFFER));
 
-	glBufferSubData(GL_UNIFORM_BUFFER, 0 * sizeof(glm::mat4), 2 * sizeof(glm::mat4), &matrices);
-	glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(transform.getWorldMatrix()));
+	for (int binding = 0; binding < MAX_BINDINGS; ++binding) {
+		if (enabledCameras[binding] == this) matricesBuffer->bindRange(GL_UNIFORM_BUFFER, binding, matricesRange);
+	}
+}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+ygl::Camera::~Camera() {
+	for (Camera *&camera : enabledCameras) {
+		if (camera == this) camera = nullptr;
+	}
+	delete matricesBuffer;
 }
 
 /// @brief Updates the camera. Should be called before drawing every frame that some of its properties have changed
@@ -99,6 +179,8 @@ void ygl::Camera::update() {
 	updateMatricesUBO();
 }
 
+ygl::Frustum ygl::Camera::getFrustum() { return Frustum(matrices.projectionMatrix * matrices.viewMatrix); }
+
 glm::mat4x4 ygl::Camera::getProjectionMatrix() { return matrices.projectionMatrix; }
 glm::mat4x4 ygl::Camera::getViewMatrix() { return matrices.viewMatrix; }
 float		ygl::PerspectiveCamera::getFov() { return fov; }
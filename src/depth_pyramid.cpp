@@ -0,0 +1,65 @@
+#include <depth_pyramid.h>
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+	#include <renderer.h>
+	#include <gl_state.h>
+	#include <algorithm>
+	#include <bit>
+
+ygl::DepthPyramid::DepthPyramid() {
+	shader = new ComputeShader(YGL_RELATIVE_PATH "./shaders/culling/depthPyramid.comp");
+}
+
+ygl::DepthPyramid::~DepthPyramid() {
+	GLState::deleteTexture(texture);
+	delete shader;
+}
+
+void ygl::DepthPyramid::create(GLsizei width, GLsizei height) {
+	GLState::deleteTexture(texture);
+	this->width	 = width;
+	this->height = height;
+	// down to a single texel
+	levels = std::bit_width((uint)std::max(width, height));
+
+	glGenTextures(1, &texture);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
+}
+
+void ygl::DepthPyramid::build(Texture2d *depth, GLsizei width, GLsizei height, const glm::mat4 &viewProjection) {
+	if (width != this->width || height != this->height) create(width, height);
+
+	// the first level is a copy of the depth, every other one is reduced from the level above it, which the previous
+	// dispatch wrote as an image. Renderer::compute() waits for image writes after every dispatch.
+	shader->bind();
+	depth->bind(GL_TEXTURE7);
+	GLsizei levelWidth = width, levelHeight = height;
+	for (uint i = 0; i < levels; ++i) {
+		glBindImageTexture(0, texture, i, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		if (i > 0) glBindImageTexture(1, texture, i - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		shader->setUniform("firstLevel", (GLboolean)(i == 0));
+		Renderer::compute(shader, levelWidth, levelHeight, 1);
+		levelWidth	= std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+	shader->unbind();
+	depth->unbind(GL_TEXTURE7);
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+	// the culling shader samples the pyramid
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	this->viewProjection = viewProjection;
+	built				 = true;
+}
+
+void ygl::DepthPyramid::bind(int textureUnit) const { GLState::bindTexture(textureUnit, GL_TEXTURE_2D, texture); }
+
+void ygl::DepthPyramid::unbind(int textureUnit) const { GLState::bindTexture(textureUnit, GL_TEXTURE_2D, 0); }
+
+#endif
@@ -6,6 +6,10 @@
 #include <string>
 #include <unordered_map>
 #include <cstddef>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <thread_pool.h>
 #include "serializable.h"
 #include "yoghurtgl.h"
 
@@ -17,13 +21,14 @@ ygl::EntityManager::EntityManager() {}
  * @return The generated ygl::Entity
  */
 ygl::Entity ygl::EntityManager::createEntity() {
-	signatures.push_back(Signature());
-
+	++entityCount;
 	if (freePositions.size()) {
 		Entity e = freePositions.front();
 		freePositions.pop();
 		return e;
-	} else return entityCount++;
+	}
+	signatures.push_back(Signature());
+	return signatures.size() - 1;
 }
 
 /**
@@ -32,7 +37,7 @@ ygl::Entity ygl::EntityManager::createEntity() {
  * @param e The entity to be destroyed.
  */
 void ygl::EntityManager::destroyEntity(ygl::Entity e) {
-	if (e >= entityCount) {
+	if (e >= signatures.size()) {
 		dbLog(ygl::LOG_ERROR, "Deleting Entity that is out of range");
 		return;
 	}
@@ -48,7 +53,7 @@ void ygl::EntityManager::destroyEntity(ygl::Entity e) {
  * @return e's signature
  */
 ygl::Signature ygl::EntityManager::getSignature(ygl::Entity e) {
-	if (e >= entityCount) {
+	if (e >= signatures.size()) {
 		dbLog(ygl::LOG_ERROR, "Accessing Signature of entity out of range");
 		return 0;	  // return a signature with no components
 	}
@@ -63,6 +68,149 @@ ygl::Signature ygl::EntityManager::getSignature(ygl::Entity e) {
  */
 void ygl::EntityManager::setSignature(ygl::Entity e, ygl::Signature s) { signatures[e] = s; }
 
+ygl::Archetype::Archetype(Signature signature, const ComponentInfo *infos)
+	: signature(signature), infos(infos) {
+	offsets.fill(0);
+	std::size_t rowSize	  = sizeof(Entity);
+	std::size_t maxAlign  = alignof(Entity);
+	for (uint i = 0; i < MAX_COMPONENTS; ++i) {
+		if (!signature[i]) continue;
+		types.push_back(i);
+		rowSize += infos[i].size;
+		maxAlign = std::max(maxAlign, infos[i].alignment);
+	}
+	assert(maxAlign <= CHUNK_ALIGNMENT && "component alignment is too big for an archetype chunk");
+
+	// leave room for the padding between the arrays
+	std::size_t padding = types.size() * maxAlign;
+	capacity			= CHUNK_SIZE > padding + rowSize ? (CHUNK_SIZE - padding) / rowSize : 1;
+
+	std::size_t offset = sizeof(Entity) * capacity;
+	for (ComponentType t : types) {
+		std::size_t align = infos[t].alignment;
+		offset			  = (offset + align - 1) / align * align;
+		offsets[t]		  = offset;
+		offset += infos[t].size * capacity;
+	}
+	chunkBytes = offset;
+}
+
+ygl::Archetype::~Archetype() {
+	for (Chunk &chunk : chunks) {
+		for (ComponentType t : types) {
+			for (uint32_t i = 0; i < chunk.count; ++i) {
+				infos[t].destroy(chunk.data + offsets[t] + i * infos[t].size);
+			}
+		}
+		::operator delete(chunk.data, std::align_val_t(CHUNK_ALIGNMENT));
+	}
+}
+
+uint32_t ygl::Archetype::pushRow(Entity e) {
+	if (chunks.empty() || chunks.back().count == capacity) {
+		std::byte *data = (std::byte *)::operator new(chunkBytes, std::align_val_t(CHUNK_ALIGNMENT));
+		chunks.push_back(Chunk{data, 0});
+	}
+	Chunk &chunk					 = chunks.back();
+	((Entity *)chunk.data)[chunk.count] = e;
+	++chunk.count;
+	return entitiesCount++;
+}
+
+ygl::Entity ygl::Archetype::eraseRow(uint32_t row) {
+	uint32_t last	   = entitiesCount - 1;
+	Chunk	&lastChunk = chunks.back();
+	Entity	 moved	   = ((Entity *)lastChunk.data)[lastChunk.count - 1];
+
+	if (row != last) {
+		Chunk	&chunk = chunks[row / capacity];
+		uint32_t index = row % capacity;
+		for (ComponentType t : types) {
+			infos[t].relocate(getComponent(row, t), getComponent(last, t));
+		}
+		((Entity *)chunk.data)[index] = moved;
+	}
+
+	--lastChunk.count;
+	--entitiesCount;
+	if (lastChunk.count == 0) {
+		::operator delete(lastChunk.data, std::align_val_t(CHUNK_ALIGNMENT));
+		chunks.pop_back();
+	}
+	return moved;
+}
+
+ygl::ArchetypeStorage::~ArchetypeStorage() {
+	for (Archetype *archetype : archetypeList) {
+		delete archetype;
+	}
+}
+
+ygl::Archetype *ygl::ArchetypeStorage::getArchetype(Signature signature) {
+	auto it = archetypes.find(signature);
+	if (it != archetypes.end()) return it->second;
+
+	Archetype *archetype = new Archetype(signature, infos.data());
+	archetypes[signature] = archetype;
+	archetypeList.push_back(archetype);
+	return archetype;
+}
+
+ygl::ArchetypeStorage::Record &ygl::ArchetypeStorage::getRecord(Entity e) {
+	if (e >= records.size()) records.resize(e + 1);
+	return records[e];
+}
+
+void ygl::ArchetypeStorage::moveEntity(Entity e, Signature signature) {
+	Record	  &record = getRecord(e);
+	Archetype *from	  = record.archetype;
+	Archetype *to	  = signature.any() ? getArchetype(signature) : nullptr;
+
+	uint32_t row = 0;
+	if (to != nullptr) row = to->pushRow(e);
+
+	if (from != nullptr) {
+		for (ComponentType t : from->getTypes()) {
+			void *src = from->getComponent(record.row, t);
+			if (to != nullptr && signature[t]) infos[t].relocate(to->getComponent(row, t), src);
+			else infos[t].destroy(src);
+		}
+		Entity moved = from->eraseRow(record.row);
+		if (moved != e) records[moved].row = record.row;
+	}
+
+	record.archetype = to;
+	record.row		 = row;
+}
+
+void *ygl::ArchetypeStorage::addComponent(Entity e, ComponentType t) {
+	Record	 &record	= getRecord(e);
+	Signature signature = record.archetype ? record.archetype->getSignature() : Signature();
+	signature.set(t);
+	moveEntity(e, signature);
+	return record.archetype->getComponent(record.row, t);
+}
+
+void ygl::ArchetypeStorage::removeComponent(Entity e, ComponentType t) {
+	Record &record = getRecord(e);
+	if (record.archetype == nullptr) return;
+	Signature signature = record.archetype->getSignature();
+	signature.reset(t);
+	moveEntity(e, signature);
+}
+
+void *ygl::ArchetypeStorage::getComponent(Entity e, ComponentType t) {
+	if (e >= records.size()) return nullptr;
+	Record &record = records[e];
+	if (record.archetype == nullptr || !record.archetype->getSignature()[t]) return nullptr;
+	return record.archetype->getComponent(record.row, t);
+}
+
+void ygl::ArchetypeStorage::destroyEntity(Entity e) {
+	if (e >= records.size() || records[e].archetype == nullptr) return;
+	moveEntity(e, Signature());
+}
+
 void ygl::ISystem::printEntities() {
 	for (ygl::Entity e : this->entities) {
 		std::cerr << e << " ";
@@ -70,6 +218,95 @@ void ygl::ISystem::printEntities() {
 	std::cerr << std::endl;
 }
 
+void ygl::SystemManager::doWork() {
+	std::size_t count = order.size();
+	if (!parallel) {
+		for (ISystem *system : order) {
+			system->doWork();
+		}
+		return;
+	}
+
+	// a system depends on every conflicting system registered before it
+	std::vector<std::vector<std::size_t>> dependents(count);
+	std::vector<std::size_t>			  dependencies(count, 0);
+	for (std::size_t i = 0; i < count; ++i) {
+		for (std::size_t j = i + 1; j < count; ++j) {
+			if (order[i]->conflictsWith(order[j])) {
+				dependents[i].push_back(j);
+				++dependencies[j];
+			}
+		}
+	}
+
+	ThreadPool				&pool = ThreadPool::getDefault();
+	std::mutex				 mutex;
+	std::condition_variable	 changed;
+	std::vector<std::size_t> mainThreadReady;	  // systems that are ready to run on this thread
+	std::size_t				 done	   = 0;
+	std::size_t				 unstarted = 0;		// systems queued in the pool that no thread has picked up yet
+	std::exception_ptr		 error;
+
+	std::function<void(std::size_t)> run;
+	// must be called with the mutex locked
+	auto launch = [&](std::size_t i) {
+		if (order[i]->isMainThreadOnly()) {
+			mainThreadReady.push_back(i);
+			return;
+		}
+		++unstarted;
+		pool.enqueue([&, i]() {
+			{
+				std::lock_guard lock(mutex);
+				--unstarted;
+			}
+			run(i);
+		});
+	};
+	run = [&](std::size_t i) {
+		try {
+			order[i]->doWork();
+		} catch (...) {
+			std::lock_guard lock(mutex);
+			if (!error) error = std::current_exception();
+		}
+		std::lock_guard lock(mutex);
+		++done;
+		for (std::size_t dependent : dependents[i]) {
+			if (--dependencies[dependent] == 0) launch(dependent);
+		}
+		changed.notify_all();
+	};
+
+	{
+		std::lock_guard lock(mutex);
+		for (std::size_t i = 0; i < count; ++i) {
+			if (dependencies[i] == 0) launch(i);
+		}
+	}
+
+	std::unique_lock lock(mutex);
+	while (done < count) {
+		if (!mainThreadReady.empty()) {
+			std::size_t i = mainThreadReady.back();
+			mainThreadReady.pop_back();
+			lock.unlock();
+			run(i);
+			lock.lock();
+		} else if (unstarted > 0) {
+			// help the pool, it may have no worker threads
+			lock.unlock();
+			if (!pool.runPendingTask()) std::this_thread::yield();
+			lock.lock();
+		} else {
+			changed.wait(lock, [&]() { return done == count || !mainThreadReady.empty() || unstarted > 0; });
+		}
+	}
+	lock.unlock();
+
+	if (error) std::rethrow_exception(error);
+}
+
 const char *ygl::Scene::name = "ygl::Scene";
 
 void ygl::Scene::write(std::ostream &out) {
@@ -100,11 +337,10 @@ void ygl::Scene::write(std::ostream &out) {
 
 		for (uint i = 0; i < componentManager.getComponentsCount(); ++i) {
 			if (!s[i]) continue;
-			ComponentType	 type(i);
-			IComponentArray *array = this->componentManager.getComponentArray(type);
+			ComponentType type(i);
 			// component type
 			out.write((char *)&type, sizeof(ComponentType));
-			array->writeComponent(e, out);
+			componentManager.writeComponent(type, e, out);
 		}
 	}
 	out << std::flush;
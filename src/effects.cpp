@@ -2,6 +2,7 @@
 
 #include <effects.h>
 #include <renderer.h>
+#include <gl_state.h>
 #include <stdexcept>
 #include "asset_manager.h"
 
@@ -11,7 +12,7 @@ uint ygl::GrassSystem::GrassBladeMesh::count = 0;
 ygl::GrassSystem::GrassBladeMesh::GrassBladeMesh(glm::ivec2 resolution, int LOD) {
 	this->LOD = LOD;
 	this->createVAO();
-	glBindVertexArray(this->getVAO());
+	GLState::bindVertexArray(this->getVAO());
 
 	this->verticesCount = 15;
 	GLuint indices[]	= {2, 1, 0, 2, 3,  1, 4, 3,	 2,	 4, 5,	3,	6,	5,	4,	6,	7,	5,	8, 7,
@@ -36,7 +37,7 @@ ygl::GrassSystem::GrassBladeMesh::GrassBladeMesh(glm::ivec2 resolution, int LOD)
 	this->addVBO(0, 4, grassData.getID(), GL_FLOAT, 1, sizeof(BladeData), 0);
 	this->addVBO(1, 4, grassData.getID(), GL_FLOAT, 1, sizeof(BladeData), (const void *)(4 * sizeof(float)));
 	this->addVBO(2, 1, grassData.getID(), GL_UNSIGNED_INT, 1, sizeof(BladeData), (const void *)(8 * sizeof(float)));
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 
 	cullFace = false;
 
@@ -99,6 +100,10 @@ void ygl::GrassSystem::init() {
 
 	scene->registerComponent<GrassHolder>();
 	scene->setSystemSignature<GrassSystem, Transformation, GrassHolder>();
+	reads<Transformation>();
+	// update() adds the mesh of a new holder to the AssetManager. The system stays on the main thread, it dispatches
+	// compute shaders
+	writes<GrassHolder, AssetManager>();
 	renderer	 = scene->getSystem<Renderer>();
 	this->window = renderer->getWindow();
 	renderer->addDrawFunction([this]() -> void { render(this->renderer->getWindow()->globalTime); });
@@ -107,11 +112,11 @@ void ygl::GrassSystem::init() {
 ygl::GrassSystem::~GrassSystem() {}
 
 void ygl::GrassSystem::update(float time) {
+	Profiler::Scope scope(renderer->getProfiler(), "grass compute");
 	auto grassCompute = (ComputeShader *)assetManager->getShader(grassComputeIndex);
 	this->bladeCount  = 0;
-	for (Entity e : entities) {
-		auto		 worldMatrix = scene->getComponent<Transformation>(e).getWorldMatrix();
-		GrassHolder &holder		 = scene->getComponent<GrassHolder>(e);
+	for (auto [e, transform, holder] : scene->view<Transformation, GrassHolder>()) {
+		auto worldMatrix = transform.getWorldMatrix();
 		if (holder.LOD > 1) continue;
 		reload(holder);
 		GrassBladeMesh *mesh = (GrassBladeMesh *)assetManager->getMesh(holder.meshIndex);
@@ -119,11 +124,11 @@ void ygl::GrassSystem::update(float time) {
 
 		Shader::setSSBO(mesh->grassData.getID(), 1);
 		grassCompute->bind();
-		grassCompute->setUniform("time", time);
-		grassCompute->setUniform("resolution", mesh->resolution);
-		grassCompute->setUniform("size", holder.size);
-		grassCompute->setUniform("anchorWorldMatrix", worldMatrix);
-		grassCompute->setUniform("LOD", (uint)holder.LOD);
+		computeUniforms.time.set(grassCompute, time);
+		computeUniforms.resolution.set(grassCompute, mesh->resolution);
+		computeUniforms.size.set(grassCompute, holder.size);
+		computeUniforms.anchorWorldMatrix.set(grassCompute, worldMatrix);
+		computeUniforms.LOD.set(grassCompute, holder.LOD);
 		grassCompute->unbind();
 		Renderer::compute(grassCompute, mesh->resolution.x, mesh->resolution.y, 1);
 	}
@@ -131,30 +136,29 @@ void ygl::GrassSystem::update(float time) {
 }
 
 void ygl::GrassSystem::render(float time) {
+	Profiler::Scope scope(renderer->getProfiler(), "grass");
 	auto grassShader = (VFShader *)assetManager->getShader(grassShaderIndex);
 	grassShader->bind();
-	if (grassShader->hasUniform("time")) grassShader->setUniform("time", time);
+	renderUniforms.time.set(grassShader, time);
 	Renderer *renderer = scene->getSystem<Renderer>();
-	if (grassShader->hasUniform("use_skybox")) grassShader->setUniform("use_skybox", renderer->hasSkybox());
-	if (grassShader->hasUniform("use_shadow")) grassShader->setUniform("use_shadow", renderer->hasShadow());
+	renderUniforms.useSkybox.set(grassShader, renderer->hasSkybox());
+	renderUniforms.useShadow.set(grassShader, renderer->hasShadow());
 
-	for (Entity e : entities) {
-		auto		 worldMatrix = scene->getComponent<Transformation>(e).getWorldMatrix();
-		GrassHolder &holder		 = scene->getComponent<GrassHolder>(e);
+	for (auto [e, transform, holder] : scene->view<Transformation, GrassHolder>()) {
+		auto worldMatrix = transform.getWorldMatrix();
 		if (holder.LOD > 1) continue;
 		GrassBladeMesh *mesh = (GrassBladeMesh *)scene->getSystem<AssetManager>()->getMesh(holder.meshIndex);
 
 		mesh->bind();
 		{
-			if (grassShader->hasUniform("worldMatrix")) grassShader->setUniform("worldMatrix", worldMatrix);
-			if (grassShader->hasUniform("renderMode")) grassShader->setUniform("renderMode", renderer->renderMode);
-			if (grassShader->hasUniform("material_index")) grassShader->setUniform("material_index", materialIndex);
-			if (grassShader->hasUniform("curvature")) grassShader->setUniform("curvature", curvature);
-			if (grassShader->hasUniform("facingOffset")) grassShader->setUniform("facingOffset", facingOffset);
-			if (grassShader->hasUniform("height")) grassShader->setUniform("height", height);
-			if (grassShader->hasUniform("width")) grassShader->setUniform("width", width * (holder.LOD + 1));
-			if (grassShader->hasUniform("blade_triangles"))
-				grassShader->setUniform("blade_triangles", (uint)mesh->getVerticesCount());
+			renderUniforms.worldMatrix.set(grassShader, worldMatrix);
+			renderUniforms.renderMode.set(grassShader, renderer->renderMode);
+			renderUniforms.materialIndex.set(grassShader, materialIndex);
+			renderUniforms.curvature.set(grassShader, curvature);
+			renderUniforms.facingOffset.set(grassShader, facingOffset);
+			renderUniforms.height.set(grassShader, height);
+			renderUniforms.width.set(grassShader, width * (holder.LOD + 1));
+			renderUniforms.bladeTriangles.set(grassShader, mesh->getVerticesCount());
 
 			glDrawElementsInstanced(mesh->getDrawMode(), mesh->getIndicesCount(), GL_UNSIGNED_INT, 0, mesh->bladeCount);
 		}
@@ -179,9 +183,8 @@ void ygl::GrassSystem::reload(ygl::GrassSystem::GrassHolder &holder) {
 }
 
 void ygl::GrassSystem::reload() {
-	for (Entity e : entities) {
-		GrassHolder &holder = scene->getComponent<GrassHolder>(e);
-		holder.density		= this->density;
+	for (auto [e, holder] : scene->view<GrassHolder>()) {
+		holder.density = this->density;
 	}
 }
 
@@ -88,19 +88,16 @@ ygl::Entity ygl::addSkybox(Scene &scene, const std::string &path, const std::str
 }
 
 #ifndef YGL_NO_ASSIMP
-ygl::Entity ygl::addModel(ygl::Scene &scene, std::string filePath, uint i) {
-	ygl::AssetManager *asman = scene.getSystem<AssetManager>();
+static ygl::Entity addMeshEntity(ygl::Scene &scene, ygl::MeshFromFile *modelMesh, const std::string &filePath,
+								 uint i) {
+	using namespace ygl;
+	AssetManager *asman = scene.getSystem<AssetManager>();
 
-	Mesh *modelMesh;
-	try {
-		modelMesh = new MeshFromFile(filePath, i);
-	} catch (std::exception &e) { THROW_RUNTIME_ERR("Failed loading MeshFromFile: " + filePath); }
 	Entity model = scene.createEntity();
 	scene.addComponent<Transformation>(model, Transformation(glm::vec3(), glm::vec3(0), glm::vec3(1.)));
 
-	uint materialIndex = MeshFromFile::loadedScene->mMeshes[i]->mMaterialIndex;
-
-	Material mat = ygl::MeshFromFile::getMaterial(MeshFromFile::loadedScene, asman, filePath, materialIndex);
+	// the material is kept with the mesh, so a cached mesh does not need the file to be imported again
+	Material  mat	   = modelMesh->getMaterial(asman);
 	Renderer *renderer = scene.getSystem<Renderer>();
 
 	RendererComponent modelRenderer;
@@ -111,15 +108,30 @@ ygl::Entity ygl::addModel(ygl::Scene &scene, std::string filePath, uint i) {
 	return model;
 }
 
+ygl::Entity ygl::addModel(ygl::Scene &scene, std::string filePath, uint i) {
+	MeshFromFile *modelMesh;
+	try {
+		modelMesh = new MeshFromFile(filePath, i);
+	} catch (std::exception &e) { THROW_RUNTIME_ERR("Failed loading MeshFromFile: " + filePath); }
+	return addMeshEntity(scene, modelMesh, filePath, i);
+}
+
 void ygl::addModels(ygl::Scene &scene, std::string filePath, const std::function<void(Entity)> &edit) {
+	// the first mesh tells how many there are, if all of them are cached the file is never imported
+	MeshFromFile *first;
 	try {
-		// if this does not fail, the calls to addModel will not throw
-		MeshFromFile::loadSceneIfNeeded(filePath);
+		first = new MeshFromFile(filePath, 0);
 	} catch (std::exception &e) {
 		std::cerr << e.what() << std::endl;
 		return;
 	}
-	for (uint i = 0; i < MeshFromFile::loadedScene->mNumMeshes; ++i) {
+	uint meshesCount = first->getMeshesCount();
+	if (meshesCount == 0) {
+		delete first;
+		return;
+	}
+	edit(addMeshEntity(scene, first, filePath, 0));
+	for (uint i = 1; i < meshesCount; ++i) {
 		ygl::Entity model = addModel(scene, filePath, i);
 		edit(model);
 	}
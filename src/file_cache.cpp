@@ -0,0 +1,103 @@
+#include <file_cache.h>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <yoghurtgl.h>
+
+namespace {
+#ifdef __EMSCRIPTEN__
+bool cacheEnabled = false;
+#else
+bool cacheEnabled = true;
+#endif
+std::string cacheDirectory = "./.ygl_cache/";
+
+struct FileHash {
+	std::uintmax_t					size;
+	std::filesystem::file_time_type time;
+	uint64_t						hash;
+};
+std::unordered_map<std::string, FileHash> fileHashes;
+std::mutex								  fileHashesMutex;
+}	  // namespace
+
+uint64_t ygl::cache::hash(const void *data, std::size_t size, uint64_t seed) {
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (std::size_t i = 0; i < size; ++i) {
+		seed ^= bytes[i];
+		seed *= 0x100000001b3ull;
+	}
+	return seed;
+}
+
+uint64_t ygl::cache::hash(const std::string &str, uint64_t seed) { return hash(str.data(), str.size(), seed); }
+
+bool ygl::cache::hashFile(const std::string &path, uint64_t &result) {
+	std::error_code error;
+	std::uintmax_t	size = std::filesystem::file_size(path, error);
+	if (error) return false;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	if (error) return false;
+
+	{
+		std::lock_guard lock(fileHashesMutex);
+		auto			it = fileHashes.find(path);
+		if (it != fileHashes.end() && it->second.size == size && it->second.time == time) {
+			result = hash(&it->second.hash, sizeof(it->second.hash), result);
+			return true;
+		}
+	}
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+
+	uint64_t fileHash = HASH_SEED;
+	char	 buffer[1 << 16];
+	while (in) {
+		in.read(buffer, sizeof(buffer));
+		fileHash = hash(buffer, in.gcount(), fileHash);
+	}
+	if (!in.eof()) return false;
+
+	{
+		std::lock_guard lock(fileHashesMutex);
+		fileHashes[path] = {size, time, fileHash};
+	}
+	result = hash(&fileHash, sizeof(fileHash), result);
+	return true;
+}
+
+void ygl::cache::setEnabled(bool enabled) { cacheEnabled = enabled; }
+
+bool ygl::cache::isEnabled() { return cacheEnabled; }
+
+void ygl::cache::setDirectory(const std::string &directory) { cacheDirectory = directory; }
+
+std::string ygl::cache::getFilePath(const std::string &category, uint64_t key, const std::string &extension) {
+	if (!cacheEnabled) return "";
+
+	std::filesystem::path dir = std::filesystem::path(cacheDirectory) / category;
+	std::error_code		  error;
+	std::filesystem::create_directories(dir, error);
+	if (error) {
+		dbLog(ygl::LOG_WARNING, "cannot create cache directory ", dir.string(), ": ", error.message());
+		return "";
+	}
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+	return (dir / (name + extension)).string();
+}
+
+bool ygl::cache::commitFile(const std::string &tempPath, const std::string &path) {
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		dbLog(ygl::LOG_WARNING, "cannot write cache file ", path, ": ", error.message());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
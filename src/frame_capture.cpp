@@ -0,0 +1,189 @@
+#include <frame_capture.h>
+
+#include <gl_state.h>
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <thread>
+
+#include <stb_image_write.h>
+
+namespace {
+std::size_t getEncoderThreadsCount() {
+#ifdef __EMSCRIPTEN__
+	return 0;	  // the captures are encoded by flush() and when too many are pending
+#else
+	// one is left for rendering, more than a few would only hold more frames in memory
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return std::clamp<std::size_t>(hardwareThreads > 1 ? hardwareThreads - 1 : 1, 1, 4);
+#endif
+}
+
+std::string getExtension(const std::string &fileName) {
+	std::size_t dot = fileName.find_last_of('.');
+	if (dot == std::string::npos) return "";
+	std::string extension = fileName.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+				   [](unsigned char c) { return std::tolower(c); });
+	return extension;
+}
+}	  // namespace
+
+ygl::FrameCapture::FrameCapture(uint buffersCount) : slots(buffersCount), encoder(getEncoderThreadsCount()) {
+	assert(buffersCount >= 1 && "there has to be at least one buffer");
+	maxEncoding = std::max<std::size_t>(2 * encoder.getThreadsCount(), 2);
+}
+
+ygl::FrameCapture::~FrameCapture() {
+	flush();
+	for (Slot &slot : slots) {
+		GLState::deleteBuffer(slot.buffer);
+	}
+}
+
+void ygl::FrameCapture::capture(GLint x, GLint y, GLsizei width, GLsizei height, Callback callback) {
+	Slot &slot = slots[next];
+	// every buffer is in flight, the oldest one has to be read before it can be used again
+	if (slot.busy) {
+		isReady(slot, true);
+		finish(slot);
+	}
+
+	GLsizeiptr size = (GLsizeiptr)width * height * 4;
+	if (slot.buffer == 0) glGenBuffers(1, &slot.buffer);
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (slot.size != size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		slot.size = size;
+	}
+	// with a pack buffer bound, the pixels are written to it and the call does not wait for them
+	glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+	slot.width	  = width;
+	slot.height	  = height;
+	slot.age	  = 0;
+	slot.busy	  = true;
+	slot.callback = std::move(callback);
+	next		  = (next + 1) % slots.size();
+}
+
+void ygl::FrameCapture::capture(GLint x, GLint y, GLsizei width, GLsizei height, const std::string &fileName) {
+	capture(x, y, width, height, [fileName](uint width, uint height, std::vector<uint8_t> &pixels) {
+		if (writeImage(fileName, width, height, pixels)) {
+			dbLog(ygl::LOG_DEBUG, "Capture saved to: ", fileName);
+		} else {
+			dbLog(ygl::LOG_ERROR, "Failed to save a capture to: ", fileName);
+		}
+	});
+}
+
+bool ygl::FrameCapture::isReady(Slot &slot, bool wait) {
+#ifndef YGL_NO_COMPUTE_SHADERS
+	if (!slot.fence) return true;
+	// the flush makes sure that the fence reaches the GPU
+	GLuint64 timeout = wait ? 1000000000 : 0;
+	while (true) {
+		GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) break;
+		if (result == GL_WAIT_FAILED) {
+			dbLog(ygl::LOG_ERROR, "FrameCapture: waiting for a fence failed");
+			break;
+		}
+		if (!wait) return false;
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	return true;
+#else
+	// WebGL has no fences here, the GPU is assumed to be done once every other buffer has been used since
+	return wait || slot.age + 1 >= slots.size();
+#endif
+}
+
+void ygl::FrameCapture::finish(Slot &slot) {
+	std::vector<uint8_t> pixels(slot.size);
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+	if (mapped) {
+		std::memcpy(pixels.data(), mapped, slot.size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	} else dbLog(ygl::LOG_ERROR, "FrameCapture: failed to map a pixel buffer");
+#else
+	glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, slot.size, pixels.data());
+#endif
+	GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// every pending encode holds a copy of a frame. When encoding is slower than capturing, the capture waits for the
+	// oldest one instead of piling up frames in memory.
+	while (encoding.size() >= maxEncoding) {
+		encoder.wait(encoding.front());
+		encoding.pop_front();
+	}
+	encoding.push_back(encoder.submit(
+		[width = slot.width, height = slot.height, callback = std::move(slot.callback),
+		 pixels = std::move(pixels)]() mutable { callback(width, height, pixels); }));
+	slot.callback = nullptr;
+	slot.busy	  = false;
+}
+
+void ygl::FrameCapture::poll() {
+	// the slots are used in order, so the oldest capture is read first and a capture that is not ready means that the
+	// later ones are not ready either
+	for (Slot &slot : slots) {
+		if (slot.busy) ++slot.age;
+	}
+	for (std::size_t i = 0; i < slots.size(); ++i) {
+		Slot &slot = slots[(next + i) % slots.size()];
+		if (!slot.busy) continue;
+		if (!isReady(slot, false)) break;
+		finish(slot);
+	}
+
+	while (!encoding.empty() && encoding.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		encoding.pop_front();
+	}
+}
+
+void ygl::FrameCapture::flush() {
+	for (std::size_t i = 0; i < slots.size(); ++i) {
+		Slot &slot = slots[(next + i) % slots.size()];
+		if (!slot.busy) continue;
+		isReady(slot, true);
+		finish(slot);
+	}
+	for (std::future<void> &future : encoding) {
+		encoder.wait(future);
+	}
+	encoding.clear();
+}
+
+std::size_t ygl::FrameCapture::getPendingCount() {
+	auto busy	 = [](const Slot &slot) { return slot.busy; };
+	auto running = [](std::future<void> &future) {
+		return future.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+	};
+	return std::count_if(slots.begin(), slots.end(), busy) + std::count_if(encoding.begin(), encoding.end(), running);
+}
+
+bool ygl::FrameCapture::writeImage(const std::string &fileName, uint width, uint height, std::vector<uint8_t> &pixels) {
+	// OpenGL rows go from the bottom up. stbi_flip_vertically_on_write() sets a global that is not safe to change
+	// while another thread writes an image, so the rows are flipped here.
+	std::size_t rowSize = (std::size_t)width * 4;
+	for (uint y = 0; y < height / 2; ++y) {
+		std::swap_ranges(pixels.begin() + y * rowSize, pixels.begin() + (y + 1) * rowSize,
+						 pixels.begin() + (height - 1 - y) * rowSize);
+	}
+
+	std::string extension = getExtension(fileName);
+	const char *name	  = fileName.c_str();
+	if (extension == "jpg" || extension == "jpeg") return stbi_write_jpg(name, width, height, 4, pixels.data(), 90);
+	if (extension == "bmp") return stbi_write_bmp(name, width, height, 4, pixels.data());
+	if (extension == "tga") return stbi_write_tga(name, width, height, 4, pixels.data());
+	return stbi_write_png(name, width, height, 4, pixels.data(), width * 4);
+}
@@ -0,0 +1,235 @@
+#include <gl_state.h>
+
+#include <unordered_map>
+#include <iterator>
+
+namespace {
+constexpr GLuint UNKNOWN = -1;
+
+// the element array buffer is not here, it is part of the VAO state
+constexpr GLenum bufferTargets[] = {
+	GL_ARRAY_BUFFER,	  GL_UNIFORM_BUFFER,	GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+	GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER,
+#ifndef YGL_NO_COMPUTE_SHADERS
+	GL_SHADER_STORAGE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+#endif
+};
+constexpr GLenum textureTargets[] = {GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY};
+constexpr GLenum capabilities[]	  = {GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_STENCIL_TEST};
+
+constexpr std::size_t BUFFER_TARGETS_COUNT	= std::size(bufferTargets);
+constexpr std::size_t TEXTURE_TARGETS_COUNT = std::size(textureTargets);
+constexpr std::size_t CAPABILITIES_COUNT	= std::size(capabilities);
+
+template <std::size_t N>
+int indexOf(const GLenum (&values)[N], GLenum value) {
+	for (std::size_t i = 0; i < N; ++i) {
+		if (values[i] == value) return i;
+	}
+	return -1;
+}
+
+struct State {
+	GLuint	program;
+	GLuint	vao;
+	GLuint	buffers[BUFFER_TARGETS_COUNT];
+	GLenum	activeUnit;
+	GLuint	textures[ygl::GLState::MAX_TEXTURE_UNITS][TEXTURE_TARGETS_COUNT];
+	GLuint	capabilities[CAPABILITIES_COUNT];	  ///< 0 or 1, UNKNOWN when not known
+	GLenum	depthFunc;
+	GLuint	depthMask;
+	GLenum	blendSrc;
+	GLenum	blendDst;
+	GLenum	polygonMode;
+	GLfloat lineWidth;
+
+	std::unordered_map<GLuint, uint32_t> attributes;	 ///< enabled attributes of each VAO, a bit for each location
+
+	State() { reset(); }
+
+	void reset() {
+		program	   = UNKNOWN;
+		vao		   = UNKNOWN;
+		activeUnit = UNKNOWN;
+		for (GLuint &buffer : buffers) {
+			buffer = UNKNOWN;
+		}
+		for (auto &unit : textures) {
+			for (GLuint &texture : unit) {
+				texture = UNKNOWN;
+			}
+		}
+		for (GLuint &capability : capabilities) {
+			capability = UNKNOWN;
+		}
+		depthFunc	= UNKNOWN;
+		depthMask	= UNKNOWN;
+		blendSrc	= UNKNOWN;
+		blendDst	= UNKNOWN;
+		polygonMode = UNKNOWN;
+		lineWidth	= -1;
+	}
+};
+
+State				state;
+ygl::GLState::Stats stats;
+
+/**
+ * @brief Sets \a cached to \a value and counts the request.
+ *
+ * @return bool - true if the value changed and the GL call has to be made
+ */
+template <class T>
+bool update(T &cached, const T &value) {
+	if (cached == value) {
+		++stats.skipped;
+		return false;
+	}
+	cached = value;
+	++stats.issued;
+	return true;
+}
+
+void setVertexAttribArray(GLuint location, bool enabled) {
+	if (state.vao != UNKNOWN && location < 32) {
+		uint32_t &mask = state.attributes[state.vao];
+		uint32_t  bit  = 1u << location;
+		if (((mask & bit) != 0) == enabled) {
+			++stats.skipped;
+			return;
+		}
+		mask ^= bit;
+	}
+	++stats.issued;
+	if (enabled) glEnableVertexAttribArray(location);
+	else glDisableVertexAttribArray(location);
+}
+}	  // namespace
+
+void ygl::GLState::useProgram(GLuint program) {
+	if (update(state.program, program)) glUseProgram(program);
+}
+
+void ygl::GLState::bindVertexArray(GLuint vao) {
+	if (update(state.vao, vao)) glBindVertexArray(vao);
+}
+
+void ygl::GLState::enableVertexAttribArray(GLuint location) { setVertexAttribArray(location, true); }
+
+void ygl::GLState::disableVertexAttribArray(GLuint location) { setVertexAttribArray(location, false); }
+
+void ygl::GLState::bindBuffer(GLenum target, GLuint buffer) {
+	int index = indexOf(bufferTargets, target);
+	if (index < 0) {
+		++stats.issued;
+		glBindBuffer(target, buffer);
+	} else if (update(state.buffers[index], buffer)) glBindBuffer(target, buffer);
+}
+
+void ygl::GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+	++stats.issued;
+	glBindBufferBase(target, index, buffer);
+	int targetIndex = indexOf(bufferTargets, target);
+	if (targetIndex >= 0) state.buffers[targetIndex] = buffer;
+}
+
+void ygl::GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	++stats.issued;
+	glBindBufferRange(target, index, buffer, offset, size);
+	int targetIndex = indexOf(bufferTargets, target);
+	if (targetIndex >= 0) state.buffers[targetIndex] = buffer;
+}
+
+void ygl::GLState::activeTexture(GLenum unit) {
+	if (update(state.activeUnit, unit)) glActiveTexture(unit);
+}
+
+void ygl::GLState::bindTexture(GLenum unit, GLenum target, GLuint texture) {
+	GLuint unitIndex   = unit - GL_TEXTURE0;
+	int	   targetIndex = indexOf(textureTargets, target);
+	if (unitIndex >= MAX_TEXTURE_UNITS || targetIndex < 0) {
+		activeTexture(unit);
+		++stats.issued;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (!update(state.textures[unitIndex][targetIndex], texture)) return;
+	if (state.activeUnit != unit) {
+		glActiveTexture(unit);
+		state.activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+}
+
+void ygl::GLState::setCapability(GLenum capability, bool enabled) {
+	int index = indexOf(capabilities, capability);
+	if (index < 0) ++stats.issued;
+	else if (!update(state.capabilities[index], (GLuint)enabled)) return;
+
+	if (enabled) glEnable(capability);
+	else glDisable(capability);
+}
+
+void ygl::GLState::depthFunc(GLenum func) {
+	if (update(state.depthFunc, func)) glDepthFunc(func);
+}
+
+void ygl::GLState::depthMask(bool mask) {
+	if (update(state.depthMask, (GLuint)mask)) glDepthMask(mask ? GL_TRUE : GL_FALSE);
+}
+
+void ygl::GLState::blendFunc(GLenum sfactor, GLenum dfactor) {
+	if (state.blendSrc == sfactor && state.blendDst == dfactor) {
+		++stats.skipped;
+		return;
+	}
+	state.blendSrc = sfactor;
+	state.blendDst = dfactor;
+	++stats.issued;
+	glBlendFunc(sfactor, dfactor);
+}
+
+void ygl::GLState::polygonMode(GLenum mode) {
+	if (update(state.polygonMode, mode)) glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void ygl::GLState::lineWidth(GLfloat width) {
+	if (update(state.lineWidth, width)) glLineWidth(width);
+}
+
+void ygl::GLState::deleteProgram(GLuint program) {
+	// a program that is in use stays in use until another one is bound
+	if (state.program == program) state.program = UNKNOWN;
+	glDeleteProgram(program);
+}
+
+void ygl::GLState::deleteVertexArray(GLuint vao) {
+	if (vao == UNKNOWN) return;
+	if (state.vao == vao) state.vao = 0;
+	state.attributes.erase(vao);
+	glDeleteVertexArrays(1, &vao);
+}
+
+void ygl::GLState::deleteBuffer(GLuint buffer) {
+	if (buffer == UNKNOWN) return;
+	for (GLuint &bound : state.buffers) {
+		if (bound == buffer) bound = 0;
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void ygl::GLState::deleteTexture(GLuint texture) {
+	if (texture == UNKNOWN) return;
+	for (auto &unit : state.textures) {
+		for (GLuint &bound : unit) {
+			if (bound == texture) bound = 0;
+		}
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void ygl::GLState::invalidate() { state.reset(); }
+
+const ygl::GLState::Stats &ygl::GLState::getStats() { return stats; }
+
+void ygl::GLState::resetStats() { stats = Stats(); }
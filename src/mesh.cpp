@@ -3,6 +3,7 @@
 #include <iostream>
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
 
 #ifndef M_PI
 	#define M_PI 3.14159265358979323846
@@ -13,6 +14,7 @@
 #include <texture.h>
 #include <mesh.h>
 #include <asset_manager.h>
+#include <gl_state.h>
 
 GLuint ygl::IMesh::createVAO() {
 	glGenVertexArrays(1, &vao);
@@ -22,34 +24,33 @@ GLuint ygl::IMesh::createVAO() {
 GLuint ygl::IMesh::createIBO(GLuint *data, int count) {
 	indicesCount = count;
 	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesCount * sizeof(GLuint), data, GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	return ibo;
 }
 
 void ygl::IMesh::bind() const {
-	if (cullFace) glEnable(GL_CULL_FACE);
-	else glDisable(GL_CULL_FACE);
-	glDepthFunc(depthfunc);
-	glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
-	glLineWidth(lineWidth);
+	GLState::setCapability(GL_CULL_FACE, cullFace);
+	GLState::depthFunc(depthfunc);
+	GLState::polygonMode(polygonMode);
+	GLState::lineWidth(lineWidth);
 
-	glBindVertexArray(vao);
+	GLState::bindVertexArray(vao);
+	// the attributes stay enabled in the VAO, so after the first bind this does not reach the driver
 	enableVBOs();
-	if (ibo != (GLuint)-1) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	if (ibo != (GLuint)-1) GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 }
 
 void ygl::IMesh::unbind() const {
-	if (ibo != (GLuint)-1) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	disableVBOs();
-	glBindVertexArray(0);
+	if (ibo != (GLuint)-1) GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	GLState::bindVertexArray(0);
 }
 
 ygl::IMesh::~IMesh() {
-	glDeleteVertexArrays(1, &vao);
+	GLState::deleteVertexArray(vao);
 	vao = -1;
-	if (ibo != (GLuint)-1) glDeleteBuffers(1, &ibo);
+	if (ibo != (GLuint)-1) GLState::deleteBuffer(ibo);
 	ibo = -1;
 }
 
@@ -81,6 +82,7 @@ void ygl::IMesh::setPolygonMode(GLenum polygonMode) { this->polygonMode = polygo
 
 void ygl::IMesh::setLineWidth(uint lineWidth) { this->lineWidth = lineWidth; }
 
+// the bounds are not serialized, the meshes compute them again when their vertices are created
 ygl::IMesh::IMesh(std::istream &in) {
 	in.read((char *)&drawMode, sizeof(drawMode));
 	in.read((char *)&depthfunc, sizeof(depthfunc));
@@ -95,15 +97,36 @@ void ygl::IMesh::serialize(std::ostream &out) {
 	out.write((char *)&cullFace, sizeof(cullFace));
 }
 
+void ygl::IMesh::computeBounds(const GLfloat *positions, GLuint count) {
+	if (positions == nullptr || count == 0) return;
+
+	boundsMin = glm::vec3(INFINITY);
+	boundsMax = glm::vec3(-INFINITY);
+	for (GLuint i = 0; i < count; ++i) {
+		glm::vec3 p(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+		boundsMin = glm::min(boundsMin, p);
+		boundsMax = glm::max(boundsMax, p);
+	}
+
+	// centered on the AABB, which is tight enough for the meshes the engine creates
+	glm::vec3 center  = (boundsMin + boundsMax) * 0.5f;
+	float	  radius2 = 0;
+	for (GLuint i = 0; i < count; ++i) {
+		glm::vec3 d = glm::vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]) - center;
+		radius2		= std::max(radius2, glm::dot(d, d));
+	}
+	boundingSphere = glm::vec4(center, std::sqrt(radius2));
+}
+
 void ygl::MultiBufferMesh::addVBO(GLuint attrLocation, GLuint coordSize, GLuint buffer, GLenum type,
 								  GLuint indexDivisor, GLsizei stride, const void *pointer) {
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
 	if (type == GL_BYTE || type == GL_UNSIGNED_BYTE || type == GL_SHORT || type == GL_UNSIGNED_SHORT ||
 		type == GL_INT || type == GL_UNSIGNED_INT)
 		glVertexAttribIPointer(attrLocation, coordSize, type, stride, pointer);
 	else glVertexAttribPointer(attrLocation, coordSize, type, GL_FALSE, stride, pointer);
 	glVertexAttribDivisor(attrLocation, indexDivisor);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 	vbos.push_back(VBO(attrLocation, buffer, coordSize));
 }
 
@@ -118,33 +141,34 @@ void ygl::MultiBufferMesh::addVBO(GLuint attrLocation, GLuint coordSize, GLuint
 
 ygl::MultiBufferMesh::~MultiBufferMesh() {
 	for (VBO &vbo : vbos) {
-		glDeleteBuffers(1, &(vbo.bufferId));
+		GLState::deleteBuffer(vbo.bufferId);
 		vbo.bufferId = -1;
 	}
 }
 void ygl::MultiBufferMesh::enableVBOs() const {
 	for (VBO vbo : vbos) {
-		glEnableVertexAttribArray(vbo.location);
+		GLState::enableVertexAttribArray(vbo.location);
 	}
 }
 void ygl::MultiBufferMesh::disableVBOs() const {
 	for (VBO vbo : vbos) {
-		glDisableVertexAttribArray(vbo.location);
+		GLState::disableVertexAttribArray(vbo.location);
 	}
 }
 
 void ygl::Mesh::init(GLuint vertexCount, GLfloat *vertices, GLfloat *normals, GLfloat *texCoords, GLfloat *colors,
 					 GLfloat *tangents, GLuint indicesCount, GLuint *indices) {
 	this->createVAO();
-	glBindVertexArray(this->getVAO());
+	GLState::bindVertexArray(this->getVAO());
 	this->verticesCount = vertexCount;
+	this->computeBounds(vertices, vertexCount);
 	this->createIBO(indices, indicesCount);
 	this->addVBO(0, 3, vertices, GL_FLOAT, vertexCount);
 	this->addVBO(1, 3, normals, GL_FLOAT, vertexCount);
 	this->addVBO(2, 2, texCoords, GL_FLOAT, vertexCount);
 	this->addVBO(3, 4, colors, GL_FLOAT, vertexCount);
 	this->addVBO(4, 3, tangents, GL_FLOAT, vertexCount);
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 }
 
 // constructs a simple mesh with vertex position (vec3), normal(vec3), texCoord(vec2) and color(vec4).
@@ -167,10 +191,10 @@ void ygl::AnimatedMesh::init(GLuint vertexCount, GLfloat *vertices, GLfloat *nor
 							 GLfloat *colors, GLfloat *tangents, GLint *boneIDs, GLfloat *weights, GLuint indicesCount,
 							 GLuint *indices) {
 	Mesh::init(vertexCount, vertices, normals, texCoords, colors, tangents, indicesCount, indices);
-	glBindVertexArray(this->getVAO());
+	GLState::bindVertexArray(this->getVAO());
 	this->addVBO(5, MAX_BONE_INFLUENCE, boneIDs, GL_INT, vertexCount);
 	this->addVBO(6, MAX_BONE_INFLUENCE, weights, GL_FLOAT, vertexCount);
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 }
 
 ygl::AnimatedMesh::AnimatedMesh(GLuint vertexCount, GLfloat *vertices, GLfloat *normals, GLfloat *texCoords,
@@ -519,6 +543,9 @@ ygl::PlaneMesh::PlaneMesh(std::istream &in) : Mesh(in) {
 	#include <assimp/material.h>
 	#include <assimp/version.h>
 	#include <assimp_glm_helpers.h>
+	#include <filesystem>
+	#include <fstream>
+	#include <file_cache.h>
 
 Assimp::Importer *ygl::MeshFromFile::importer = nullptr;
 
@@ -566,17 +593,14 @@ bool getTexture(aiMaterial *mat, aiTextureType type, std::string &fileName) {
 	return false;
 }
 
-ygl::Material ygl::MeshFromFile::getMaterial(const aiScene *scene, ygl::AssetManager *asman, std::string filePath,
-											 uint m) {
-	if (!scene->HasMaterials()) { return Material(); }
+ygl::MeshFromFile::MaterialData ygl::MeshFromFile::readMaterial(const aiScene *scene, const std::string &filePath,
+																 uint m) {
+	MaterialData data;
+	if (!scene->HasMaterials()) { return data; }
 	aiMaterial *material = scene->mMaterials[m];	 // Get the current material
-	aiString	materialName;						 // The name of the material found in mesh file
 	aiReturn	ret;	 // Code which says whether loading something has been successful of not
 	std::string dir = filePath.substr(0, filePath.rfind('/') + 1);
 
-	ret = material->Get(AI_MATKEY_NAME, materialName);	   // Get the material name (pass by reference)
-	if (ret != AI_SUCCESS) materialName = "";			   // Failed to find material name so makes var empty
-
 	aiColor3D diff(0, 0, 0);
 	ret = material->Get(AI_MATKEY_COLOR_DIFFUSE, diff);
 	if (ret != AI_SUCCESS) diff = aiColor3D(1, 0, 1);
@@ -596,38 +620,57 @@ ygl::Material ygl::MeshFromFile::getMaterial(const aiScene *scene, ygl::AssetMan
 	ret		  = material->Get(AI_MATKEY_REFRACTI, ior);
 	if (ret != AI_SUCCESS) ior = 1.;
 
-	glm::vec3 glmAlbedo(diff.r, diff.g, diff.b);
-	glm::vec3 glmEmission(emission.r, emission.g, emission.b);
-	glm::vec3 glmSpecular(specular.r, specular.g, specular.b);
-	glm::vec3 glmTransparent(transparent.r, transparent.g, transparent.b);
-
-	const uint	  TEX_COUNT = 7;
-	float		  use_map[TEX_COUNT]{0};
-	uint		  map[TEX_COUNT]{0};
-	std::string	  map_file[TEX_COUNT];
-	aiTextureType mapType[TEX_COUNT]{aiTextureType_NORMALS,	  aiTextureType_DIFFUSE_ROUGHNESS, aiTextureType_LIGHTMAP,
-									 aiTextureType_METALNESS, aiTextureType_DIFFUSE,		   aiTextureType_EMISSIVE,
-									 aiTextureType_OPACITY};
-	TextureType	  texType[TEX_COUNT]{TextureType::NORMAL,	TextureType::ROUGHNESS, TextureType::AO,
-									 TextureType::METALLIC, TextureType::DIFFUSE,	TextureType::EMISSIVE,
-									 TextureType::OPACITY};
-
-	for (uint i = 0; i < TEX_COUNT; ++i) {
-		use_map[i]	= getTexture(material, mapType[i], map_file[i]);
-		map_file[i] = dir + map_file[i];
+	data.present	 = true;
+	data.albedo		 = glm::vec3(diff.r, diff.g, diff.b);
+	data.emission	 = glm::vec3(emission.r, emission.g, emission.b);
+	data.specular	 = glm::vec3(specular.r, specular.g, specular.b);
+	data.transparent = glm::vec3(transparent.r, transparent.g, transparent.b);
+	data.roughness	 = roughness_factor;
+	data.ior		 = ior;
+
+	aiTextureType mapType[MATERIAL_MAPS]{aiTextureType_NORMALS,	 aiTextureType_DIFFUSE_ROUGHNESS,
+										 aiTextureType_LIGHTMAP, aiTextureType_METALNESS,
+										 aiTextureType_DIFFUSE,	 aiTextureType_EMISSIVE,
+										 aiTextureType_OPACITY};
+
+	for (uint i = 0; i < MATERIAL_MAPS; ++i) {
+		if (getTexture(material, mapType[i], data.maps[i])) data.maps[i] = dir + data.maps[i];
+		else data.maps[i].clear();
+	}
+	return data;
+}
+
+ygl::Material ygl::MeshFromFile::createMaterial(const MaterialData &data, ygl::AssetManager *asman) {
+	if (!data.present) { return Material(); }
+
+	float		use_map[MATERIAL_MAPS]{0};
+	uint		map[MATERIAL_MAPS]{0};
+	TextureType texType[MATERIAL_MAPS]{TextureType::NORMAL,	  TextureType::ROUGHNESS, TextureType::AO,
+									   TextureType::METALLIC, TextureType::DIFFUSE,	  TextureType::EMISSIVE,
+									   TextureType::OPACITY};
+
+	for (uint i = 0; i < MATERIAL_MAPS; ++i) {
+		use_map[i] = !data.maps[i].empty();
 
 		if (use_map[i]) {
-			map[i] = asman->getTextureIndex(map_file[i]);
-			if (map[i] == (uint)-1) map[i] = asman->addTexture(new Texture2d(map_file[i], texType[i]), map_file[i]);
+			map[i] = asman->getTextureIndex(data.maps[i]);
+			if (map[i] == (uint)-1) map[i] = asman->addTexture(new Texture2d(data.maps[i], texType[i]), data.maps[i]);
 		}
 	}
 
-	ygl::Material mat(glmAlbedo, 0.02, glmEmission, ior, glmTransparent, 0.0, glmSpecular, roughness_factor,
-					  roughness_factor, 0., map[0], use_map[0], map[1], use_map[1], map[2], use_map[2], map[3],
+	ygl::Material mat(data.albedo, 0.02, data.emission, data.ior, data.transparent, 0.0, data.specular, data.roughness,
+					  data.roughness, 0., map[0], use_map[0], map[1], use_map[1], map[2], use_map[2], map[3],
 					  use_map[3], map[4], use_map[4], map[5], use_map[5], map[6], use_map[6]);
 	return mat;
 }
 
+ygl::Material ygl::MeshFromFile::getMaterial(const aiScene *scene, ygl::AssetManager *asman, std::string filePath,
+											 uint m) {
+	return createMaterial(readMaterial(scene, filePath, m), asman);
+}
+
+ygl::Material ygl::MeshFromFile::getMaterial(ygl::AssetManager *asman) const { return createMaterial(material, asman); }
+
 const char	  *ygl::MeshFromFile::name		  = "ygl::MeshFromFile";
 const aiScene *ygl::MeshFromFile::loadedScene = nullptr;
 std::string	   ygl::MeshFromFile::loadedFile  = "";
@@ -639,7 +682,7 @@ void ygl::MeshFromFile::loadSceneIfNeeded(const std::string &path) {
 	}
 }
 
-void ygl::MeshFromFile::init(const std::string &path, uint index) {
+void ygl::MeshFromFile::importData(const std::string &path, uint index, Data &data) {
 	loadSceneIfNeeded(path);
 	#define scene loadedScene
 
@@ -650,6 +693,7 @@ void ygl::MeshFromFile::init(const std::string &path, uint index) {
 
 	aiMesh	   **meshes	   = scene->mMeshes;
 	unsigned int numMeshes = scene->mNumMeshes;
+	data.meshesCount	   = numMeshes;
 
 	assert(numMeshes >= 1 && "no meshes in the scene?");
 	if (numMeshes <= index) {
@@ -660,37 +704,45 @@ void ygl::MeshFromFile::init(const std::string &path, uint index) {
 	aiMesh		*mesh		   = meshes[index];
 	unsigned int verticesCount = mesh->mNumVertices;
 	unsigned int indicesCount  = mesh->mNumFaces * 3;
-	GLuint		*indices	   = new GLuint[indicesCount];
+	data.verticesCount		   = verticesCount;
+	data.material			   = readMaterial(scene, path, mesh->mMaterialIndex);
 
+	data.indices.resize(indicesCount);
 	unsigned int indexCounter = 0;
 	for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
 		assert(mesh->mFaces->mNumIndices == 3);
-		indices[indexCounter++] = mesh->mFaces[i].mIndices[0];
-		indices[indexCounter++] = mesh->mFaces[i].mIndices[1];
-		indices[indexCounter++] = mesh->mFaces[i].mIndices[2];
+		data.indices[indexCounter++] = mesh->mFaces[i].mIndices[0];
+		data.indices[indexCounter++] = mesh->mFaces[i].mIndices[1];
+		data.indices[indexCounter++] = mesh->mFaces[i].mIndices[2];
 	}
+	assert(indexCounter == indicesCount && "something went very wrong");
+
+	auto copyStream = [verticesCount](std::vector<GLfloat> &stream, const void *source, uint coordSize) {
+		if (source == nullptr) return;
+		stream.resize(verticesCount * coordSize);
+		std::memcpy(stream.data(), source, stream.size() * sizeof(GLfloat));
+	};
+	copyStream(data.vertices, mesh->mVertices, 3);
+	copyStream(data.normals, mesh->mNormals, 3);
+	copyStream(data.colors, mesh->mColors[0], 4);
+	copyStream(data.tangents, mesh->mTangents, 3);
 
-	GLfloat *texCoords = nullptr;
 	if (mesh->HasTextureCoords(0)) {
-		texCoords = new GLfloat[verticesCount * sizeof(float) * 2];
+		data.texCoords.resize(verticesCount * 2);
 		for (unsigned int i = 0; i < verticesCount; ++i) {
-			texCoords[i * 2]	 = mesh->mTextureCoords[0][i].x;
-			texCoords[i * 2 + 1] = mesh->mTextureCoords[0][i].y;
+			data.texCoords[i * 2]	  = mesh->mTextureCoords[0][i].x;
+			data.texCoords[i * 2 + 1] = mesh->mTextureCoords[0][i].y;
 		}
+	} else {
+		dbLog(ygl::LOG_WARNING, "tex coords cannot be loaded for model!");
 	}
 
-	assert(indexCounter == indicesCount && "something went very wrong");
-
-	if (!(mesh->HasTextureCoords(0))) { dbLog(ygl::LOG_WARNING, "tex coords cannot be loaded for model!"); }
-	if (!(mesh->HasVertexColors(0))) { /*dbLog(ygl::LOG_WARNING, "colors cannot be loaded for model!");*/
-	}
-
-	GLint *boneIDs = new GLint[MAX_BONE_INFLUENCE * verticesCount];
-	for (uint i = 0; i < MAX_BONE_INFLUENCE * verticesCount; ++i)
-		boneIDs[i] = -1;
-	GLfloat *boneWeights = new GLfloat[MAX_BONE_INFLUENCE * verticesCount];
+	data.boneIDs.assign(MAX_BONE_INFLUENCE * verticesCount, -1);
+	data.weights.assign(MAX_BONE_INFLUENCE * verticesCount, 0);
 
 	if (mesh->HasBones()) {
+		std::unordered_map<std::string, uint> boneIndices;
+
 		int numBones = mesh->mNumBones;
 		for (int boneIndex = 0; boneIndex < numBones; ++boneIndex) {
 			int			boneId = -1;
@@ -698,15 +750,16 @@ void ygl::MeshFromFile::init(const std::string &path, uint index) {
 
 			fixMixamoBoneName(name);
 
-			if (boneInfoMap.find(name) == boneInfoMap.end()) {
+			auto it = boneIndices.find(name);
+			if (it == boneIndices.end()) {
 				BoneInfo newBoneInfo;
-				newBoneInfo.id	   = bonesCount;
+				newBoneInfo.id	   = data.bones.size();
 				newBoneInfo.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[boneIndex]->mOffsetMatrix);
-				boneInfoMap[name]  = newBoneInfo;
-				boneId			   = bonesCount;
-				bonesCount++;
+				boneIndices[name]  = newBoneInfo.id;
+				boneId			   = newBoneInfo.id;
+				data.bones.push_back({name, newBoneInfo});
 			} else {
-				boneId = boneInfoMap[name].id;
+				boneId = data.bones[it->second].second.id;
 			}
 
 			assert(boneId != -1);
@@ -721,32 +774,260 @@ void ygl::MeshFromFile::init(const std::string &path, uint index) {
 				int	 baseIndex = vertexId * MAX_BONE_INFLUENCE;
 				bool success   = false;
 				for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
-					if (boneIDs[baseIndex + i] < 0) {
-						boneWeights[baseIndex + i] = weight;
-						boneIDs[baseIndex + i]	   = boneId;
-						success					   = true;
+					if (data.boneIDs[baseIndex + i] < 0) {
+						data.weights[baseIndex + i] = weight;
+						data.boneIDs[baseIndex + i] = boneId;
+						success						= true;
 						break;
 					}
 				}
 				if (!success) {
 					dbLog(ygl::LOG_WARNING,
-						  "failed to add bone weight!\n\tcurrent weights: ", boneWeights[baseIndex + 0], " ",
-						  boneWeights[baseIndex + 1], " ", boneWeights[baseIndex + 2], " ", boneWeights[baseIndex + 3]);
+						  "failed to add bone weight!\n\tcurrent weights: ", data.weights[baseIndex + 0], " ",
+						  data.weights[baseIndex + 1], " ", data.weights[baseIndex + 2], " ",
+						  data.weights[baseIndex + 3]);
 				}
 			}
 		}
 	}
 
-	AnimatedMesh::init(verticesCount, (GLfloat *)mesh->mVertices, (GLfloat *)mesh->mNormals, texCoords,
-					   (GLfloat *)mesh->mColors[0], (GLfloat *)mesh->mTangents, boneIDs, boneWeights, indicesCount,
-					   indices);
+	#undef scene
+}
 
-	delete[] indices;
-	delete[] boneIDs;
-	delete[] boneWeights;
-	if (texCoords != nullptr) delete[] texCoords;
+static std::string decodeUri(const std::string &uri) {
+	std::string result;
+	for (std::size_t i = 0; i < uri.size(); ++i) {
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(uri[i + 1]) && std::isxdigit(uri[i + 2])) {
+			result += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+			i += 2;
+		} else {
+			result += uri[i];
+		}
+	}
+	return result;
+}
 
-	#undef scene
+/**
+ * @brief Finds the files, other than textures, that a model file loads its meshes from: the buffers of a .gltf and
+ * the material libraries of an .obj. Textures are left out, materials only keep their file names.
+ */
+static std::vector<std::string> getReferencedFiles(const std::string &path) {
+	std::vector<std::string> files;
+	std::string				 extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	std::string	  dir = path.substr(0, path.rfind('/') + 1);
+	std::ifstream in(path);
+
+	if (extension == ".gltf") {
+		const std::string images[] = {".png", ".jpg", ".jpeg", ".webp", ".ktx2", ".dds", ".bmp", ".tga"};
+		std::string		  json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		for (std::size_t pos = json.find("\"uri\""); pos != std::string::npos; pos = json.find("\"uri\"", pos + 1)) {
+			std::size_t begin = json.find('"', json.find(':', pos + 5) + 1);
+			std::size_t end	  = begin == std::string::npos ? begin : json.find('"', begin + 1);
+			if (end == std::string::npos) break;
+			std::string uri = decodeUri(json.substr(begin + 1, end - begin - 1));
+			if (uri.starts_with("data:")) continue;
+
+			std::string uriExtension = std::filesystem::path(uri).extension().string();
+			std::transform(uriExtension.begin(), uriExtension.end(), uriExtension.begin(), ::tolower);
+			if (std::find(std::begin(images), std::end(images), uriExtension) != std::end(images)) continue;
+			files.push_back(dir + uri);
+		}
+	} else if (extension == ".obj") {
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.starts_with("mtllib")) continue;
+			std::size_t begin = line.find_first_not_of(" \t", 6);
+			std::size_t end	  = line.find_last_not_of(" \t\r");
+			if (begin != std::string::npos && begin != 6) files.push_back(dir + line.substr(begin, end - begin + 1));
+		}
+	}
+	return files;
+}
+
+uint64_t ygl::MeshFromFile::getCacheKey(const std::string &path, uint index) {
+	uint64_t fileKey = cache::HASH_SEED;
+	if (!cache::hashFile(path, fileKey)) return 0;
+
+	// the list is parsed again only when the model file changes, the referenced files are checked every time
+	static std::unordered_map<std::string, std::pair<uint64_t, std::vector<std::string>>> referencedFiles;
+	auto [references, inserted]	 = referencedFiles.try_emplace(path);
+	auto &[referencesKey, files] = references->second;
+	if (inserted || referencesKey != fileKey) {
+		referencesKey = fileKey;
+		files		  = getReferencedFiles(path);
+	}
+
+	uint64_t key = fileKey;
+	for (const std::string &file : files) {
+		if (!cache::hashFile(file, key)) key = cache::hash(file, key);
+	}
+
+	uint32_t params[] = {CACHE_VERSION,		 index,				  (uint32_t)import_flags,
+						 aiGetVersionMajor(), aiGetVersionMinor(), aiGetVersionRevision()};
+	return cache::hash(params, sizeof(params), key);
+}
+
+// cache entry layout:
+//		header: magic, version, key, vertices count, indices count, bones count, meshes count in the file, bitmask of
+//				the present streams
+//		streams: vertices, normals, texCoords, colors, tangents, bone ids, weights, indices
+//		bones: name length, name, id, offset matrix
+//		material: present flag, albedo, emission, specular, transparent, roughness, ior, length and name of each map
+static constexpr uint32_t MESH_CACHE_MAGIC = 0x4d4c4759;	 // "YGLM"
+
+static bool readString(std::istream &in, std::string &str) {
+	uint32_t length = 0;
+	in.read((char *)&length, sizeof(length));
+	if (!in || length > 4096) return false;
+	str.resize(length);
+	in.read(str.data(), length);
+	return (bool)in;
+}
+
+static void writeString(std::ostream &out, const std::string &str) {
+	uint32_t length = str.size();
+	out.write((char *)&length, sizeof(length));
+	out.write(str.data(), length);
+}
+
+bool ygl::MeshFromFile::readCache(const std::string &cacheFile, uint64_t key, Data &data) {
+	std::ifstream in(cacheFile, std::ios::binary);
+	if (!in) return false;
+
+	uint32_t magic	 = 0, version = 0, indicesCount = 0, bonesCount = 0, streams = 0;
+	uint64_t fileKey = 0;
+	in.read((char *)&magic, sizeof(magic));
+	in.read((char *)&version, sizeof(version));
+	in.read((char *)&fileKey, sizeof(fileKey));
+	in.read((char *)&data.verticesCount, sizeof(data.verticesCount));
+	in.read((char *)&indicesCount, sizeof(indicesCount));
+	in.read((char *)&bonesCount, sizeof(bonesCount));
+	in.read((char *)&data.meshesCount, sizeof(data.meshesCount));
+	in.read((char *)&streams, sizeof(streams));
+	if (!in || magic != MESH_CACHE_MAGIC || version != CACHE_VERSION || fileKey != key) return false;
+
+	std::vector<GLfloat> *floatStreams[] = {&data.vertices, &data.normals, &data.texCoords, &data.colors,
+											&data.tangents};
+	uint				  coordSizes[]	 = {3, 3, 2, 4, 3};
+	for (int i = 0; i < 5; ++i) {
+		if (!(streams & (1 << i))) continue;
+		floatStreams[i]->resize(data.verticesCount * coordSizes[i]);
+		in.read((char *)floatStreams[i]->data(), floatStreams[i]->size() * sizeof(GLfloat));
+	}
+	data.boneIDs.resize(MAX_BONE_INFLUENCE * data.verticesCount);
+	data.weights.resize(MAX_BONE_INFLUENCE * data.verticesCount);
+	data.indices.resize(indicesCount);
+	in.read((char *)data.boneIDs.data(), data.boneIDs.size() * sizeof(GLint));
+	in.read((char *)data.weights.data(), data.weights.size() * sizeof(GLfloat));
+	in.read((char *)data.indices.data(), data.indices.size() * sizeof(GLuint));
+
+	data.bones.resize(bonesCount);
+	for (auto &[name, info] : data.bones) {
+		if (!readString(in, name)) return false;
+		in.read((char *)&info.id, sizeof(info.id));
+		in.read((char *)glm::value_ptr(info.offset), sizeof(info.offset));
+	}
+
+	MaterialData &material = data.material;
+	uint8_t		  present  = 0;
+	in.read((char *)&present, sizeof(present));
+	material.present = present;
+	for (glm::vec3 *color : {&material.albedo, &material.emission, &material.specular, &material.transparent}) {
+		in.read((char *)glm::value_ptr(*color), sizeof(*color));
+	}
+	in.read((char *)&material.roughness, sizeof(material.roughness));
+	in.read((char *)&material.ior, sizeof(material.ior));
+	for (std::string &map : material.maps) {
+		if (!readString(in, map)) return false;
+	}
+	return (bool)in;
+}
+
+void ygl::MeshFromFile::writeCache(const std::string &cacheFile, uint64_t key, const Data &data) {
+	std::string	  tempFile = cacheFile + ".tmp";
+	std::ofstream out(tempFile, std::ios::binary);
+	if (!out) {
+		dbLog(ygl::LOG_WARNING, "cannot write mesh cache file ", tempFile);
+		return;
+	}
+
+	const std::vector<GLfloat> *floatStreams[] = {&data.vertices, &data.normals, &data.texCoords, &data.colors,
+												  &data.tangents};
+	uint32_t					streams		   = 0;
+	for (int i = 0; i < 5; ++i) {
+		if (!floatStreams[i]->empty()) streams |= 1 << i;
+	}
+
+	uint32_t magic		  = MESH_CACHE_MAGIC, version = CACHE_VERSION;
+	uint32_t indicesCount = data.indices.size(), bonesCount = data.bones.size();
+	out.write((char *)&magic, sizeof(magic));
+	out.write((char *)&version, sizeof(version));
+	out.write((char *)&key, sizeof(key));
+	out.write((char *)&data.verticesCount, sizeof(data.verticesCount));
+	out.write((char *)&indicesCount, sizeof(indicesCount));
+	out.write((char *)&bonesCount, sizeof(bonesCount));
+	out.write((char *)&data.meshesCount, sizeof(data.meshesCount));
+	out.write((char *)&streams, sizeof(streams));
+
+	for (const std::vector<GLfloat> *stream : floatStreams) {
+		out.write((char *)stream->data(), stream->size() * sizeof(GLfloat));
+	}
+	out.write((char *)data.boneIDs.data(), data.boneIDs.size() * sizeof(GLint));
+	out.write((char *)data.weights.data(), data.weights.size() * sizeof(GLfloat));
+	out.write((char *)data.indices.data(), data.indices.size() * sizeof(GLuint));
+
+	for (const auto &[name, info] : data.bones) {
+		writeString(out, name);
+		out.write((char *)&info.id, sizeof(info.id));
+		out.write((char *)glm::value_ptr(info.offset), sizeof(info.offset));
+	}
+
+	const MaterialData &material = data.material;
+	uint8_t				present	 = material.present;
+	out.write((char *)&present, sizeof(present));
+	for (const glm::vec3 *color : {&material.albedo, &material.emission, &material.specular, &material.transparent}) {
+		out.write((char *)glm::value_ptr(*color), sizeof(*color));
+	}
+	out.write((char *)&material.roughness, sizeof(material.roughness));
+	out.write((char *)&material.ior, sizeof(material.ior));
+	for (const std::string &map : material.maps) {
+		writeString(out, map);
+	}
+
+	out.close();
+	if (!out) {
+		dbLog(ygl::LOG_WARNING, "cannot write mesh cache file ", tempFile);
+		std::filesystem::remove(tempFile);
+		return;
+	}
+	cache::commitFile(tempFile, cacheFile);
+}
+
+void ygl::MeshFromFile::init(const std::string &path, uint index) {
+	Data		data;
+	uint64_t	key		  = getCacheKey(path, index);
+	std::string cacheFile = key ? cache::getFilePath("meshes", key, ".ygm") : "";
+
+	if (cacheFile.empty() || !readCache(cacheFile, key, data)) {
+		data = Data();
+		importData(path, index, data);
+		if (data.verticesCount == 0) return;
+		if (!cacheFile.empty()) writeCache(cacheFile, key, data);
+	}
+
+	for (const auto &[name, info] : data.bones) {
+		boneInfoMap[name] = info;
+	}
+	bonesCount	= data.bones.size();
+	meshesCount = data.meshesCount;
+	material	= data.material;
+
+	auto streamData = [](auto &stream) { return stream.empty() ? nullptr : stream.data(); };
+	AnimatedMesh::init(data.verticesCount, streamData(data.vertices), streamData(data.normals),
+					   streamData(data.texCoords), streamData(data.colors), streamData(data.tangents),
+					   streamData(data.boneIDs), streamData(data.weights), data.indices.size(),
+					   streamData(data.indices));
 }
 
 ygl::MeshFromFile::MeshFromFile(const std::string &path, uint index) : path(path), index(index) { init(path, index); }
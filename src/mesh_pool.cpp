@@ -0,0 +1,123 @@
+#include <mesh_pool.h>
+#include <gl_state.h>
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+	#include <algorithm>
+
+namespace {
+/// number of floats per vertex for position, normal, texture coordinates, color and tangent
+constexpr GLuint attributeSizes[] = {3, 3, 2, 4, 3};
+
+void copyBuffer(GLuint from, GLuint to, GLintptr fromOffset, GLintptr toOffset, GLsizeiptr size) {
+	if (size == 0) return;
+	ygl::GLState::bindBuffer(GL_COPY_READ_BUFFER, from);
+	ygl::GLState::bindBuffer(GL_COPY_WRITE_BUFFER, to);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, fromOffset, toOffset, size);
+	ygl::GLState::bindBuffer(GL_COPY_READ_BUFFER, 0);
+	ygl::GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+}	  // namespace
+
+ygl::MeshPool::MeshPool(GLuint initialVertices, GLuint initialIndices) {
+	glGenVertexArrays(1, &vao);
+	entriesBuffer = MutableBuffer(GL_SHADER_STORAGE_BUFFER, 64 * sizeof(Entry), GL_DYNAMIC_DRAW);
+	reserve(initialVertices, initialIndices);
+}
+
+ygl::MeshPool::~MeshPool() { GLState::deleteVertexArray(vao); }
+
+void ygl::MeshPool::reserve(GLuint newVerticesCapacity, GLuint newIndicesCapacity) {
+	// the old contents are copied to the bigger buffers on the GPU
+	if (newVerticesCapacity > verticesCapacity) {
+		for (uint i = 0; i < ATTRIBUTES_COUNT; ++i) {
+			GLsizeiptr	  vertexSize = attributeSizes[i] * sizeof(GLfloat);
+			MutableBuffer grown(GL_ARRAY_BUFFER, newVerticesCapacity * vertexSize, GL_STATIC_DRAW);
+			if (verticesCapacity) copyBuffer(attributes[i].getID(), grown.getID(), 0, 0, verticesCount * vertexSize);
+			attributes[i] = std::move(grown);
+		}
+		verticesCapacity = newVerticesCapacity;
+	}
+	if (newIndicesCapacity > indicesCapacity) {
+		// created as an array buffer, binding an element array buffer would change the currently bound VAO
+		MutableBuffer grown(GL_ARRAY_BUFFER, newIndicesCapacity * sizeof(GLuint), GL_STATIC_DRAW);
+		if (indicesCapacity) copyBuffer(indices.getID(), grown.getID(), 0, 0, indicesCount * sizeof(GLuint));
+		indices			= std::move(grown);
+		indicesCapacity = newIndicesCapacity;
+	}
+	attachAttributes();
+}
+
+void ygl::MeshPool::attachAttributes() {
+	GLState::bindVertexArray(vao);
+	for (uint i = 0; i < ATTRIBUTES_COUNT; ++i) {
+		GLState::bindBuffer(GL_ARRAY_BUFFER, attributes[i].getID());
+		glVertexAttribPointer(i, attributeSizes[i], GL_FLOAT, GL_FALSE, 0, nullptr);
+		GLState::enableVertexAttribArray(i);
+	}
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.getID());
+	GLState::bindVertexArray(0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool ygl::MeshPool::canAdd(IMesh *mesh) {
+	Mesh *m = dynamic_cast<Mesh *>(mesh);
+	if (!m || m->getIBO() == (GLuint)-1) return false;
+	if (m->getDrawMode() != GL_TRIANGLES || !m->getCullFace() || m->getDepthFunc() != GL_LESS ||
+		m->getPolygonMode() != GL_FILL)
+		return false;
+
+	const std::vector<IMesh::VBO> &vbos = m->getVBOs();
+	if (vbos.size() < ATTRIBUTES_COUNT) return false;
+	for (uint i = 0; i < ATTRIBUTES_COUNT; ++i) {
+		if (vbos[i].location != i || vbos[i].coordSize != attributeSizes[i]) return false;
+	}
+	return true;
+}
+
+GLuint ygl::MeshPool::add(IMesh *mesh) {
+	if (!canAdd(mesh)) return INVALID;
+
+	const std::vector<IMesh::VBO> &vbos			= ((Mesh *)mesh)->getVBOs();
+	GLuint						   meshVertices = mesh->getVerticesCount();
+	GLuint						   meshIndices	= mesh->getIndicesCount();
+
+	if (verticesCount + meshVertices > verticesCapacity || indicesCount + meshIndices > indicesCapacity) {
+		reserve(std::max(2 * verticesCapacity, verticesCount + meshVertices),
+				std::max(2 * indicesCapacity, indicesCount + meshIndices));
+	}
+
+	for (uint i = 0; i < ATTRIBUTES_COUNT; ++i) {
+		GLsizeiptr vertexSize = attributeSizes[i] * sizeof(GLfloat);
+		copyBuffer(vbos[i].bufferId, attributes[i].getID(), 0, verticesCount * vertexSize, meshVertices * vertexSize);
+	}
+	copyBuffer(mesh->getIBO(), indices.getID(), 0, indicesCount * sizeof(GLuint), meshIndices * sizeof(GLuint));
+
+	entries.push_back(Entry{meshIndices, indicesCount, (GLint)verticesCount, 0, mesh->getBoundingSphere()});
+	verticesCount += meshVertices;
+	indicesCount += meshIndices;
+	entriesChanged = true;
+	return entries.size() - 1;
+}
+
+GLuint ygl::MeshPool::getEntriesBuffer() {
+	if (entriesChanged) {
+		GLsizeiptr size = entries.size() * sizeof(Entry);
+		if (size > entriesBuffer.getSize()) entriesBuffer.resize(std::max(size, 2 * entriesBuffer.getSize()));
+		entriesBuffer.set(entries.data(), size);
+		entriesBuffer.unbind();
+		entriesChanged = false;
+	}
+	return entriesBuffer.getID();
+}
+
+void ygl::MeshPool::bind() const {
+	GLState::enable(GL_CULL_FACE);
+	GLState::depthFunc(GL_LESS);
+	GLState::polygonMode(GL_FILL);
+	GLState::lineWidth(1);
+	GLState::bindVertexArray(vao);
+}
+
+void ygl::MeshPool::unbind() const { GLState::bindVertexArray(0); }
+
+#endif
@@ -0,0 +1,269 @@
+#include <profiler.h>
+
+#include <timer.h>
+#include <imgui.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+void writeJsonString(std::ostream &out, const std::string &str) {
+	out << '"';
+	for (char c : str) {
+		if (c == '"' || c == '\\') out << '\\' << c;
+		else if ((unsigned char)c < 0x20) out << ' ';
+		else out << c;
+	}
+	out << '"';
+}
+
+float average(const float *values, uint count) {
+	if (count == 0) return 0;
+	float sum = 0;
+	for (uint i = 0; i < ygl::Profiler::HISTORY_SIZE; ++i) {
+		sum += values[i];
+	}
+	return sum / count;
+}
+}	  // namespace
+
+// the history is filled with zeros, so the entries that have not been used yet add nothing
+float ygl::Profiler::Stats::getCpuAverage() const { return average(cpu, count); }
+float ygl::Profiler::Stats::getGpuAverage() const { return average(gpu, count); }
+float ygl::Profiler::Stats::getCpuMax() const { return *std::max_element(cpu, cpu + HISTORY_SIZE); }
+float ygl::Profiler::Stats::getGpuMax() const { return *std::max_element(gpu, gpu + HISTORY_SIZE); }
+
+ygl::Profiler::Profiler(bool gpuTimers, uint framesInFlight) : gpuTimers(gpuTimers), frames(framesInFlight) {
+	assert(framesInFlight >= 1 && "there has to be at least one frame");
+#ifdef YGL_NO_COMPUTE_SHADERS
+	// WebGL has no timestamp queries
+	this->gpuTimers = false;
+#endif
+	beginFrame();
+}
+
+ygl::Profiler::~Profiler() {
+#ifndef YGL_NO_COMPUTE_SHADERS
+	for (Frame &frame : frames) {
+		if (!frame.queries.empty()) glDeleteQueries(frame.queries.size(), frame.queries.data());
+	}
+#endif
+}
+
+void ygl::Profiler::beginFrame() {
+	Frame &frame = frames[current];
+	// every frame is in flight, the oldest one has to be read before it can be used again
+	if (frame.pending) {
+		isReady(frame, true);
+		collect(frame);
+	}
+	frame.samples.clear();
+	frame.usedQueries = 0;
+	frame.index		  = frameIndex;
+	frame.traced	  = tracing;
+	if (tracing) syncClocks(frame);
+}
+
+void ygl::Profiler::syncClocks(Frame &frame) {
+	frame.gpuOffset = 0;
+#ifndef YGL_NO_COMPUTE_SHADERS
+	if (!gpuTimers) return;
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	frame.gpuOffset = (int64_t)timer_nsec() - gpuTime;
+#endif
+}
+
+uint ygl::Profiler::issueTimestamp(Frame &frame) {
+#ifndef YGL_NO_COMPUTE_SHADERS
+	if (frame.usedQueries == frame.queries.size()) {
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+	glQueryCounter(frame.queries[frame.usedQueries], GL_TIMESTAMP);
+#endif
+	return frame.usedQueries++;
+}
+
+void ygl::Profiler::begin(const char *name) {
+	Frame &frame = frames[current];
+	open.push_back(frame.samples.size());
+	Sample &sample = frame.samples.emplace_back(Sample{name, uint(open.size() - 1), 0, 0, {0, 0}});
+	if (gpuTimers) sample.queries[0] = issueTimestamp(frame);
+	sample.cpuBegin = timer_nsec();
+}
+
+void ygl::Profiler::end() {
+	assert(!open.empty() && "end() without a begin()");
+	Frame  &frame  = frames[current];
+	Sample &sample = frame.samples[open.back()];
+	open.pop_back();
+	sample.cpuEnd = timer_nsec();
+	if (gpuTimers) sample.queries[1] = issueTimestamp(frame);
+}
+
+void ygl::Profiler::endFrame() {
+	assert(open.empty() && "a scope has not ended");
+	frames[current].pending = true;
+	++frameIndex;
+	current = (current + 1) % frames.size();
+
+	// frames end in order, so the oldest one is read first and a frame that is not ready means that the later ones
+	// are not ready either
+	for (std::size_t i = 0; i < frames.size(); ++i) {
+		Frame &frame = frames[(current + i) % frames.size()];
+		if (!frame.pending) continue;
+		if (!isReady(frame, false)) break;
+		collect(frame);
+	}
+	beginFrame();
+}
+
+void ygl::Profiler::flush() {
+	for (std::size_t i = 0; i < frames.size(); ++i) {
+		Frame &frame = frames[(current + i) % frames.size()];
+		if (!frame.pending) continue;
+		isReady(frame, true);
+		collect(frame);
+	}
+}
+
+bool ygl::Profiler::isReady(Frame &frame, bool wait) {
+#ifndef YGL_NO_COMPUTE_SHADERS
+	// reading the results waits for them
+	if (!gpuTimers || frame.usedQueries == 0 || wait) return true;
+	// the queries finish in order
+	GLuint available = 0;
+	glGetQueryObjectuiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	return available;
+#else
+	return true;
+#endif
+}
+
+void ygl::Profiler::collect(Frame &frame) {
+	frame.pending = false;
+
+	std::vector<GLuint64> timestamps(frame.usedQueries, 0);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	for (uint i = 0; i < frame.usedQueries; ++i) {
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+	}
+#endif
+
+	for (const Sample &sample : frame.samples) {
+		uint64_t cpuTime = sample.cpuEnd - sample.cpuBegin;
+		uint64_t gpuTime = gpuTimers ? timestamps[sample.queries[1]] - timestamps[sample.queries[0]] : 0;
+
+		auto [found, added] = statsIndices.try_emplace(sample.name, stats.size());
+		if (added) stats.emplace_back().name = sample.name;
+		Stats &stat = stats[found->second];
+		stat.depth	= sample.depth;
+
+		// scopes with the same name in a frame share an entry
+		uint entry;
+		if (stat.count > 0 && stat.lastFrame == frame.index) {
+			entry = (stat.next + HISTORY_SIZE - 1) % HISTORY_SIZE;
+		} else {
+			entry			= stat.next;
+			stat.next		= (stat.next + 1) % HISTORY_SIZE;
+			stat.count		= std::min(stat.count + 1, HISTORY_SIZE);
+			stat.lastFrame	= frame.index;
+			stat.cpu[entry] = 0;
+			stat.gpu[entry] = 0;
+		}
+		stat.cpu[entry] += cpuTime / 1e6f;
+		stat.gpu[entry] += gpuTime / 1e6f;
+
+		if (frame.traced) {
+			trace.push_back({sample.name, false, (int64_t)sample.cpuBegin, cpuTime});
+			if (gpuTimers) {
+				int64_t gpuBegin = (int64_t)timestamps[sample.queries[0]] + frame.gpuOffset;
+				trace.push_back({sample.name, true, gpuBegin, gpuTime});
+			}
+		}
+	}
+}
+
+const ygl::Profiler::Stats *ygl::Profiler::getStats(const std::string &name) const {
+	auto found = statsIndices.find(name);
+	return found == statsIndices.end() ? nullptr : &stats[found->second];
+}
+
+void ygl::Profiler::startTrace() {
+	trace.clear();
+	tracing	   = true;
+	traceBegin = timer_nsec();
+	// the current frame is traced from here on
+	frames[current].traced = true;
+	syncClocks(frames[current]);
+}
+
+void ygl::Profiler::writeTrace(std::ostream &out) const {
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	for (const TraceEvent &event : trace) {
+		// microseconds since the trace started
+		char times[64];
+		snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", (event.begin - (int64_t)traceBegin) / 1e3,
+				 event.duration / 1e3);
+		out << ",\n{\"name\":";
+		writeJsonString(out, event.name);
+		out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1) << "," << times << "}";
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool ygl::Profiler::saveTrace(const std::string &fileName) const {
+	std::ofstream out(fileName);
+	writeTrace(out);
+	out.close();
+	return bool(out);
+}
+
+void ygl::Profiler::drawGui() {
+	ImGui::Begin("Profiler");
+	ImGui::Text("Milliseconds over the last %u frames", HISTORY_SIZE);
+	if (!tracing) {
+		if (ImGui::Button("Start Trace")) startTrace();
+	} else if (ImGui::Button("Save Trace")) {
+		stopTrace();
+		flush();
+		if (saveTrace("trace.json")) {
+			dbLog(ygl::LOG_INFO, "Trace saved to: trace.json");
+		} else {
+			dbLog(ygl::LOG_ERROR, "Failed to save the trace to: trace.json");
+		}
+	}
+
+	if (ImGui::BeginTable("Scopes", gpuTimers ? 5 : 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("CPU avg");
+		ImGui::TableSetupColumn("CPU max");
+		if (gpuTimers) {
+			ImGui::TableSetupColumn("GPU avg");
+			ImGui::TableSetupColumn("GPU max");
+		}
+		ImGui::TableHeadersRow();
+		for (const Stats &stat : stats) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%*s%s", int(stat.depth * 2), "", stat.name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stat.getCpuAverage());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stat.getCpuMax());
+			if (gpuTimers) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.getGpuAverage());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", stat.getGpuMax());
+			}
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
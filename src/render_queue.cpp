@@ -0,0 +1,79 @@
+#include <render_queue.h>
+#include <algorithm>
+#include <cstring>
+
+uint64_t ygl::RenderQueue::makeKey(uint32_t pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth) {
+	// the bits of a non-negative float compare in the same order as the floats
+	depth = std::max(depth, 0.f);
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	uint64_t key = pass & ((1u << PASS_BITS) - 1);
+	key			 = (key << SHADER_BITS) | (shader & ((1u << SHADER_BITS) - 1));
+	key			 = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+	key			 = (key << MESH_BITS) | (mesh & ((1u << MESH_BITS) - 1));
+	key			 = (key << DEPTH_BITS) | (depthBits >> (32 - DEPTH_BITS));
+	return key;
+}
+
+void ygl::RenderQueue::clear() {
+	draws.clear();
+	keys.clear();
+	order.clear();
+}
+
+void ygl::RenderQueue::add(uint64_t key, const Draw &draw) {
+	order.push_back(draws.size());
+	draws.push_back(draw);
+	keys.push_back(key);
+}
+
+void ygl::RenderQueue::sort() {
+	constexpr uint32_t RADIX_BITS = 8;
+	constexpr uint32_t RADIX	  = 1 << RADIX_BITS;
+	constexpr uint32_t PASSES	  = 64 / RADIX_BITS;
+
+	const std::size_t count = keys.size();
+	if (count < 2) return;
+
+	// counts for all digits are gathered in a single pass over the keys
+	uint32_t histograms[PASSES][RADIX] = {};
+	for (uint64_t key : keys) {
+		for (uint32_t p = 0; p < PASSES; ++p) {
+			++histograms[p][(key >> (p * RADIX_BITS)) & (RADIX - 1)];
+		}
+	}
+
+	tempKeys.resize(count);
+	tempOrder.resize(count);
+	for (uint32_t p = 0; p < PASSES; ++p) {
+		uint32_t	  *histogram = histograms[p];
+		const uint32_t shift	 = p * RADIX_BITS;
+
+		// all keys have the same digit, nothing would move
+		if (histogram[(keys[0] >> shift) & (RADIX - 1)] == count) continue;
+
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < RADIX; ++i) {
+			uint32_t c	 = histogram[i];
+			histogram[i] = offset;
+			offset += c;
+		}
+
+		for (std::size_t i = 0; i < count; ++i) {
+			uint32_t dst   = histogram[(keys[i] >> shift) & (RADIX - 1)]++;
+			tempKeys[dst]  = keys[i];
+			tempOrder[dst] = order[i];
+		}
+		keys.swap(tempKeys);
+		order.swap(tempOrder);
+	}
+}
+
+std::pair<std::size_t, std::size_t> ygl::RenderQueue::getPassRange(uint32_t pass) const {
+	auto first = std::lower_bound(keys.begin(), keys.end(), pass,
+								  [](uint64_t key, uint32_t value) { return getPass(key) < value; });
+	auto last  = std::upper_bound(first, keys.end(), pass,
+								  [](uint32_t value, uint64_t key) { return value < getPass(key); });
+	return {first - keys.begin(), last - keys.begin()};
+}
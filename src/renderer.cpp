@@ -4,12 +4,19 @@
 #include <assert.h>
 #include <ostream>
 #include <string>
+#include <algorithm>
+#include <cmath>
 #include <texture.h>
 #include <yoghurtgl.h>
+#include <gl_state.h>
 #include <asset_manager.h>
 #include <material.h>
 #include <entities.h>
 #include <effects.h>
+#include <file_cache.h>
+#include <depth_pyramid.h>
+#include <cstdio>
+#include <cstring>
 
 #include <imgui.h>
 
@@ -45,7 +52,7 @@ ygl::FrameBuffer::FrameBuffer(FrameBufferAttachable *buff1, GLenum attachment1,
 		glObjectLabel(GL_FRAMEBUFFER, id, size, name);
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	bindDefault();
 }
 
 ygl::FrameBuffer::~FrameBuffer() {
@@ -58,7 +65,7 @@ void ygl::FrameBuffer::clear() const { glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BU
 
 void ygl::FrameBuffer::bind() const { glBindFramebuffer(GL_FRAMEBUFFER, id); }
 
-void ygl::FrameBuffer::unbind() const { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+void ygl::FrameBuffer::unbind() const { bindDefault(); }
 
 ygl::Texture2d *ygl::FrameBuffer::getColor() { return (Texture2d *)color; }
 
@@ -71,51 +78,28 @@ void ygl::FrameBuffer::resize(uint width, uint height) {
 	depth_stencil->BindToFrameBuffer(*this, GL_DEPTH_STENCIL_ATTACHMENT, 0, 0);
 }
 
-void ygl::FrameBuffer::bindDefault() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+void ygl::FrameBuffer::bindDefault() { glBindFramebuffer(GL_FRAMEBUFFER, defaultID); }
 
-ygl::ACESEffect::ACESEffect(ygl::Renderer *renderer) {
-	this->setRenderer(renderer);
-	auto sh		= new VFShader(YGL_RELATIVE_PATH "./shaders/ui/textureOnScreen.vs",
-							   YGL_RELATIVE_PATH "./shaders/postProcessing/acesFilm.fs");
-	colorGrader = renderer->getAssetManager()->addShader(sh, "color grading shader", false);
-}
+void ygl::FrameBuffer::setDefault(FrameBuffer *fb) { defaultID = fb ? fb->id : 0; }
+
+ygl::ACESEffect::ACESEffect(ygl::Renderer *renderer) { this->setRenderer(renderer); }
 
 ygl::ACESEffect::~ACESEffect() {}
 
-void ygl::ACESEffect::apply(FrameBuffer *front, FrameBuffer *back) {
-	front->getColor()->bind(GL_TEXTURE7);
-	if (back) back->bind();
-	else FrameBuffer::bindDefault();
-
-	VFShader *sh = (VFShader *)renderer->getAssetManager()->getShader(colorGrader);
-	sh->bind();
-	sh->setUniform("doColorGrading", enabled);
-	sh->setUniform("doGammaCorrection", enabled);
-	Renderer::drawObject(sh, renderer->getScreenQuad());
-	front->getColor()->unbind(GL_TEXTURE7);
-}
+void ygl::ACESEffect::setFusedUniforms(Shader *shader) { exposureUniform.set(shader, exposure); }
 
 ygl::BloomEffect::BloomEffect(Renderer *renderer) {
 	Window *window = renderer->getWindow();
-	tex1		   = new Texture2d(window->getWidth(), window->getHeight(), TextureType::RGBA16F, nullptr);
-	tex2		   = new Texture2d(window->getWidth(), window->getHeight(), TextureType::RGBA16F, nullptr);
-
-	window->addResizeCallback([this, window](GLFWwindow *, int, int) {
-		delete tex1;
-		delete tex2;
-		tex1 = new Texture2d(window->getWidth(), window->getHeight(), TextureType::RGBA16F, nullptr);
-		tex2 = new Texture2d(window->getWidth(), window->getHeight(), TextureType::RGBA16F, nullptr);
-		dbLog(ygl::LOG_DEBUG, "resizing textures!!");
-	});
+	createLevels(window->getWidth(), window->getHeight());
 
-	dbLog(ygl::LOG_DEBUG, "window size: ", window->getWidth(), " ", window->getHeight());
+	window->addResizeCallback([this, window](GLFWwindow *handle, int width, int height) {
+		if (handle != window->getHandle()) return;
+		deleteLevels();
+		createLevels(width, height);
+	});
 
-	blurShader	 = new ComputeShader(YGL_RELATIVE_PATH "./shaders/postProcessing/blur.comp");
-	filterShader = new ComputeShader(YGL_RELATIVE_PATH "./shaders/postProcessing/filter.comp");
-	filterShader->bind();
-	// filterShader->setUniform("img_input", 1);
-	// filterShader->setUniform("img_output", 0);
-	filterShader->unbind();
+	downsampleShader = new ComputeShader(YGL_RELATIVE_PATH "./shaders/postProcessing/bloomDownsample.comp");
+	upsampleShader	 = new ComputeShader(YGL_RELATIVE_PATH "./shaders/postProcessing/bloomUpsample.comp");
 
 	onScreen = new VFShader(YGL_RELATIVE_PATH "./shaders/ui/textureOnScreen.vs",
 							YGL_RELATIVE_PATH "./shaders/ui/textureOnScreen.fs");
@@ -127,13 +111,31 @@ ygl::BloomEffect::BloomEffect(Renderer *renderer) {
 }
 
 ygl::BloomEffect::~BloomEffect() {
-	delete tex1;
-	delete tex2;
-	delete blurShader;
-	delete filterShader;
+	deleteLevels();
+	delete downsampleShader;
+	delete upsampleShader;
 	delete onScreen;
 }
 
+void ygl::BloomEffect::createLevels(uint width, uint height) {
+	GLsizei levelWidth	= std::max(width / 2, 1u);
+	GLsizei levelHeight = std::max(height / 2, 1u);
+	// the smallest level is still a few texels, smaller ones would only add blocky blur
+	do {
+		Texture2d *texture = new Texture2d(levelWidth, levelHeight, TextureType::RGBA16F, nullptr);
+		levels.push_back({texture, levelWidth, levelHeight});
+		levelWidth	= std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	} while (levels.size() < MAX_LEVELS && levelWidth >= 8 && levelHeight >= 8);
+}
+
+void ygl::BloomEffect::deleteLevels() {
+	for (Level &level : levels) {
+		delete level.texture;
+	}
+	levels.clear();
+}
+
 void ygl::BloomEffect::apply(FrameBuffer *front, FrameBuffer *back) {
 	if (!enabled) {
 		if (back) {
@@ -145,34 +147,7 @@ void ygl::BloomEffect::apply(FrameBuffer *front, FrameBuffer *back) {
 
 		return;
 	}
-	uint blurSize = 5;
-	// first separate pixels that have to be blurred;
-	FrameBuffer::bindDefault();
-	front->getColor()->bindImage(1);
-	front->getColor()->unbind(GL_TEXTURE7);
-	tex1->bindImage(0);
-	Window *window = renderer->getWindow();
-
-	filterShader->bind();
-	if (filterShader->hasUniform("img_input")) filterShader->setUniform("img_input", 1);
-	filterShader->setUniform("img_output", 0);
-	glTextureBarrier();
-	Renderer::compute(filterShader, window->getWidth(), window->getHeight(), 1);
-	tex2->bindImage(1);
-
-	for (uint i = 0; i < blurSize; ++i) {
-		blurShader->bind();
-		blurShader->setUniform("img_input", 0);
-		blurShader->setUniform("img_output", 1);
-		blurShader->setUniform("blurDirection", 0);
-		Renderer::compute(blurShader, window->getWidth(), window->getHeight(), 1);
-
-		blurShader->bind();
-		blurShader->setUniform("img_input", 1);
-		blurShader->setUniform("img_output", 0);
-		blurShader->setUniform("blurDirection", 1);
-		Renderer::compute(blurShader, window->getWidth(), window->getHeight(), 1);
-	}
+	blur(front);
 
 	if (back) {
 		back->bind();
@@ -180,16 +155,58 @@ void ygl::BloomEffect::apply(FrameBuffer *front, FrameBuffer *back) {
 		back->clear();
 	} else FrameBuffer::bindDefault();
 
-	glBlendFunc(GL_ONE, GL_ONE);
-
+	GLState::blendFunc(GL_ONE, GL_ONE);
 	front->getColor()->bind(GL_TEXTURE7);
 	Renderer::drawObject(onScreen, renderer->getScreenQuad());
-	tex1->bind(GL_TEXTURE7);
 
+	// the top level holds the sum of all levels
+	float weight = intensity / levels.size();
+	glBlendColor(weight, weight, weight, weight);
+	GLState::blendFunc(GL_CONSTANT_COLOR, GL_ONE);
+	levels[0].texture->bind(GL_TEXTURE7);
 	Renderer::drawObject(onScreen, renderer->getScreenQuad());
-	tex1->unbind(GL_TEXTURE7);
+	levels[0].texture->unbind(GL_TEXTURE7);
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void ygl::BloomEffect::blur(FrameBuffer *front) {
+	FrameBuffer::bindDefault();
+
+	// down the chain, every level is filtered from the one above it. Each pass samples what the previous one wrote as
+	// an image, hence the texture fetch barriers.
+	downsampleShader->bind();
+	thresholdUniform.set(downsampleShader, threshold);
+	for (std::size_t i = 0; i < levels.size(); ++i) {
+		Texture2d *source = i == 0 ? front->getColor() : levels[i - 1].texture;
+		source->bind(GL_TEXTURE7);
+		levels[i].texture->bindImage(0);
+		firstLevelUniform.set(downsampleShader, i == 0);
+		Renderer::compute(downsampleShader, levels[i].width, levels[i].height, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	// and back up, every level gets the blurred sum of all levels below it
+	upsampleShader->bind();
+	for (std::size_t i = levels.size() - 1; i > 0; --i) {
+		levels[i].texture->bind(GL_TEXTURE7);
+		levels[i - 1].texture->bindImage(0);
+		Renderer::compute(upsampleShader, levels[i - 1].width, levels[i - 1].height, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+	upsampleShader->unbind();
+	levels[0].texture->unbindImage(0);
+}
+
+void ygl::BloomEffect::setFusedUniforms(Shader *shader) {
+	levels[0].texture->bind(GL_TEXTURE8);
+	weightUniform.set(shader, intensity / levels.size());
+}
+
+void ygl::IScreenEffect::applyFused(FrameBuffer *front, FrameBuffer *back) {
+	IScreenEffect *self = this;
+	if (enabled) prepareFused(front);
+	renderer->fusedPass(&self, 1, front, back);
 }
 
 ygl::RendererComponent::RendererComponent(unsigned int shaderIndex, unsigned int meshIndex, unsigned int materialIndex,
@@ -229,17 +246,22 @@ void ygl::Renderer::init() {
 	}
 
 	uint16_t width = window->getWidth(), height = window->getHeight();
-	frontFrameBuffer =
-		new FrameBuffer(new Texture2d(width, height, TextureType::RGBA16F, nullptr), GL_COLOR_ATTACHMENT0,
-						new RenderBuffer(width, height, TextureType::DEPTH_STENCIL_32F_8), GL_DEPTH_STENCIL_ATTACHMENT,
-						"Front frameBuffer");
-	backFrameBuffer = new FrameBuffer(new Texture2d(width, height, TextureType::RGBA16F, nullptr), GL_COLOR_ATTACHMENT0,
-									  new RenderBuffer(width, height, TextureType::DEPTH_STENCIL_32F_8),
-									  GL_DEPTH_STENCIL_ATTACHMENT, "Back frameBuffer");
-	shadowFrameBuffer = new FrameBuffer(nullptr, GL_COLOR_ATTACHMENT0,
-										new Texture2d(shadowMapSize, shadowMapSize, TextureType::DEPTH_24, nullptr),
-										GL_DEPTH_ATTACHMENT, "Shadow Framebuffer");
-	dbLog(ygl::LOG_DEBUG, "shadow texture: ", shadowFrameBuffer->getDepthStencil()->getID());
+
+	auto createDepth = [&]() -> FrameBufferAttachable * {
+#ifndef YGL_NO_COMPUTE_SHADERS
+		// the depth pyramid is built from it
+		return new Texture2d(width, height, TextureType::DEPTH_STENCIL_32F_8, nullptr);
+#else
+		return new RenderBuffer(width, height, TextureType::DEPTH_STENCIL_32F_8);
+#endif
+	};
+	frontFrameBuffer = new FrameBuffer(new Texture2d(width, height, TextureType::RGBA16F, nullptr),
+									   GL_COLOR_ATTACHMENT0, createDepth(), GL_DEPTH_STENCIL_ATTACHMENT,
+									   "Front frameBuffer");
+	backFrameBuffer	 = new FrameBuffer(new Texture2d(width, height, TextureType::RGBA16F, nullptr),
+									   GL_COLOR_ATTACHMENT0, createDepth(), GL_DEPTH_STENCIL_ATTACHMENT,
+									   "Back frameBuffer");
+	createShadowMaps();
 
 	window->addResizeCallback([this](GLFWwindow *window, int width, int height) {
 		(void)window;
@@ -250,11 +272,20 @@ void ygl::Renderer::init() {
 	scene->registerComponentIfCan<RendererComponent>();
 	scene->registerComponentIfCan<Transformation>();
 	scene->setSystemSignature<Renderer, Transformation, RendererComponent>();
+	// access is not declared since draw functions may read any component
 
 	scene->registerSystemIfCan<ygl::AssetManager>();
 	asman = scene->getSystem<AssetManager>();
 
 	brdfTexture = asman->addTexture(createBRDFTexture(), "brdf_Texture", false);
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+	GLsizeiptr clusters = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	clusterShader		= new ComputeShader(YGL_RELATIVE_PATH "./shaders/culling/lightClusters.comp");
+	clusterLightsCounts = MutableBuffer(GL_SHADER_STORAGE_BUFFER, clusters * sizeof(GLuint), GL_DYNAMIC_COPY);
+	clusterLights =
+		MutableBuffer(GL_SHADER_STORAGE_BUFFER, clusters * MAX_LIGHTS_PER_CLUSTER * sizeof(GLuint), GL_DYNAMIC_COPY);
+#endif
 }
 
 ygl::Shader *ygl::Renderer::getShader(RendererComponent &comp) { return getShader(comp.shaderIndex); }
@@ -274,7 +305,7 @@ ygl::IMesh *ygl::Renderer::getMesh(uint index) { return asman->getMesh(index); }
 
 ygl::Mesh *ygl::Renderer::getScreenQuad() { return screenQuad; }
 
-void ygl::Renderer::bindTexturesForMaterial(unsigned int materialIndex, Shader *sh) {
+void ygl::Renderer::bindMaterialTextures(unsigned int materialIndex) {
 	if (materials[materialIndex].use_albedo_map)
 		asman->getTexture(materials[materialIndex].albedo_map)->bind(ygl::TexIndex::COLOR);
 	if (materials[materialIndex].use_normal_map)
@@ -289,6 +320,9 @@ void ygl::Renderer::bindTexturesForMaterial(unsigned int materialIndex, Shader *
 		asman->getTexture(materials[materialIndex].metallic_map)->bind(ygl::TexIndex::METALLIC);
 	if (materials[materialIndex].use_transparency_map)
 		asman->getTexture(materials[materialIndex].transparency_map)->bind(ygl::TexIndex::OPACITY);
+}
+
+void ygl::Renderer::bindSceneTextures(Shader *sh) {
 	if (skyboxTexture != 0) asman->getTexture(skyboxTexture)->bind(ygl::TexIndex::SKYBOX);
 
 	if (irradianceTexture != 0) asman->getTexture(irradianceTexture)->bind(ygl::TexIndex::IRRADIANCE_MAP);
@@ -296,15 +330,19 @@ void ygl::Renderer::bindTexturesForMaterial(unsigned int materialIndex, Shader *
 	if (prefilterTexture != 0) asman->getTexture(prefilterTexture)->bind(ygl::TexIndex::PREFILTER_MAP);
 	else defaultCubemap.bind(ygl::TexIndex::PREFILTER_MAP);
 
-	if (sh->hasUniform("use_skybox")) { sh->setUniform("use_skybox", this->hasSkybox()); }
-	if (sh->hasUniform("renderMode")) { sh->setUniform("renderMode", renderMode); }
+	useSkyboxUniform.set(sh, this->hasSkybox());
+	renderModeUniform.set(sh, renderMode);
 
 	asman->getTexture(brdfTexture)->bind(ygl::TexIndex::BDRF_MAP);
 
-	if (sh->hasUniform("use_shadow")) { sh->setUniform<GLboolean>("use_shadow", shadow); }
-	if (shadow) shadowFrameBuffer->getDepthStencil()->bind(ygl::TexIndex::SHADOW_MAP);
+	useShadowUniform.set(sh, shadow);
+	if (shadow) shadowMaps->bind(ygl::TexIndex::SHADOW_MAP);
 }
 
+void ygl::Renderer::bindTexturesForMaterial(unsigned int materialIndex, Shader *sh) {
+	bindMaterialTextures(materialIndex);
+	bindSceneTextures(sh);
+}
 
 unsigned int ygl::Renderer::addMaterial(const Material &mat) {
 	materials.push_back(mat);
@@ -332,28 +370,92 @@ ygl::IScreenEffect *ygl::Renderer::getScreenEffect(uint index) {
 }
 
 void ygl::Renderer::loadData() {
-	// send material and light data to the GPU through UBOs
-	if (materialsBuffer == 0) { glGenBuffers(1, &materialsBuffer); }
-	glBindBuffer(GL_UNIFORM_BUFFER, materialsBuffer);
-	glBufferData(GL_UNIFORM_BUFFER, materials.size() * sizeof(Material), materials.data(), GL_DYNAMIC_DRAW);
+	// the draws of the frame that is being recorded may still read the current region
+	frameData.nextFrame();
+	reserveFrameData();
+	uploadMaterialsAndLights();
+}
 
-	Shader::setUBO(materialsBuffer, 1);
+uint ygl::Renderer::getDepthShader(const RenderQueue::Draw &draw, uint shadowShader) {
+	// the skybox and other meshes with their own depth test are drawn as usual
+	if (getMesh(draw.mesh)->getDepthFunc() != GL_LESS) return -1;
+	// cutouts discard where their opacity map is 0, the depth shader would write depth over the whole mesh
+	if (materials[draw.material].use_transparency_map != 0) return -1;
+	if (shadowShader == (uint)-1) shadowShader = defaultShadowShader;
+	if (shadowShader == (uint)-1) return -1;
+
+	// GL_EQUAL passes only when both passes compute the same positions, so all stages before the fragment shader have
+	// to be the same and declare gl_Position invariant like simple.vs
+	Shader *color = asman->getShader(draw.shader);
+	Shader *depth = asman->getShader(shadowShader);
+	uint	stages = color->getStagesCount();
+	if (depth->getStagesCount() != stages) return -1;
+	for (uint i = 0; i + 1 < stages; ++i) {
+		if (std::strcmp(color->getFileName(i), depth->getFileName(i)) != 0) return -1;
+	}
+	return shadowShader;
+}
 
-	if (lightsBuffer == 0) { glGenBuffers(1, &lightsBuffer); }
-	uint lightsCount = lights.size();
-	glBindBuffer(GL_UNIFORM_BUFFER, lightsBuffer);
-	glBufferData(GL_UNIFORM_BUFFER, 100 * sizeof(Light) + sizeof(uint), nullptr, GL_DYNAMIC_DRAW);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, lights.size() * sizeof(Light), lights.data());
-	glBufferSubData(GL_UNIFORM_BUFFER, 100 * sizeof(Light), sizeof(uint), &lightsCount);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+void ygl::Renderer::reserveFrameData() {
+	// every allocation can be padded by up to one alignment
+	GLsizeiptr alignment = RingBuffer::getRegionAlignment();
+	GLsizeiptr size = materials.size() * sizeof(Material) + sizeof(LightsHeader) +
+					  std::max<std::size_t>(lights.size(), 100) * sizeof(Light) + sizeof(uint) +
+					  renderQueue.size() * (sizeof(glm::mat4) + sizeof(GLuint)) + sizeof(ShadowCascades::Uniforms) +
+					  MAX_CASCADES * 3 * sizeof(glm::mat4) + (5 + MAX_CASCADES) * alignment;
+	if (size > frameData.getRegionSize()) frameData.reserve(std::max(size, 2 * frameData.getRegionSize()));
+}
 
-	if (lightsCount >= 1 && lights[0].type == Light::Type::DIRECTIONAL) {
-		Transformation x(lights[0].transform);
-		shadowCamera.transform = x;
-		shadowCamera.update();
-	}
+void ygl::Renderer::uploadMaterialsAndLights() {
+	// send material and light data to the GPU, the materials through a UBO
+	GLsizeiptr		  alignment		 = RingBuffer::getOffsetAlignment(GL_UNIFORM_BUFFER);
+	RingBuffer::Range materialsRange =
+		frameData.write(materials.data(), materials.size() * sizeof(Material), alignment);
+	frameData.bindRange(GL_UNIFORM_BUFFER, 1, materialsRange);
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+	// the lights go to an SSBO of any size, after the parameters of the clusters
+	bool			  clustered	  = lightClustering && clusterShader && mainCamera;
+	glm::vec2		  screenSize  = glm::vec2(window->getWidth(), window->getHeight());
+	LightsHeader	  header	  = makeLightsHeader(clustered ? mainCamera : nullptr, screenSize, lights.size());
+	GLsizeiptr		  size		  = sizeof(LightsHeader) + lights.size() * sizeof(Light);
+	RingBuffer::Range lightsRange = frameData.allocate(size, RingBuffer::getOffsetAlignment(GL_SHADER_STORAGE_BUFFER));
+	if (lightsRange.size == 0) return;
+	frameData.write(lightsRange, 0, &header, sizeof(LightsHeader));
+	frameData.write(lightsRange, sizeof(LightsHeader), lights.data(), lights.size() * sizeof(Light));
+	frameData.bindRange(GL_SHADER_STORAGE_BUFFER, 5, lightsRange);
+#else
+	// the shaders have room for 100 lights, the count follows them
+	uint			  lightsCount = std::min<std::size_t>(lights.size(), 100);
+	RingBuffer::Range lightsRange = frameData.allocate(100 * sizeof(Light) + sizeof(uint), alignment);
+	if (lightsRange.size == 0) return;
+	frameData.write(lightsRange, 0, lights.data(), lightsCount * sizeof(Light));
+	frameData.write(lightsRange, 100 * sizeof(Light), &lightsCount, sizeof(uint));
+	frameData.bindRange(GL_UNIFORM_BUFFER, 2, lightsRange);
+#endif
+}
 
-	Shader::setUBO(lightsBuffer, 2);
+ygl::LightsHeader ygl::Renderer::makeLightsHeader(Camera *camera, glm::vec2 screenSize, uint lightsCount) {
+	LightsHeader header{};
+	header.lightsCount = lightsCount;
+	header.screenSize  = screenSize;
+	if (!camera) return header;
+
+	// the near and far planes are found by unprojecting, so that any projection works
+	glm::mat4 inverseProjection = glm::inverse(camera->getProjectionMatrix());
+	glm::vec4 nearPoint			= inverseProjection * glm::vec4(0, 0, -1, 1);
+	glm::vec4 farPoint			= inverseProjection * glm::vec4(0, 0, 1, 1);
+	float	  zNear				= -nearPoint.z / nearPoint.w;
+	float	  zFar				= -farPoint.z / farPoint.w;
+	// depth slices are spaced exponentially, so that clusters far away are not much longer than they are wide
+	if (zNear <= 0 || zFar <= zNear) return header;
+
+	// slice = log(depth) * scale + bias
+	float scale				 = CLUSTERS_Z / std::log(zFar / zNear);
+	header.inverseProjection = inverseProjection;
+	header.clusterDepth		 = glm::vec4(zNear, zFar, scale, -std::log(zNear) * scale);
+	header.clusterCount		 = glm::uvec3(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z);
+	return header;
 }
 
 void ygl::Renderer::setDefaultShader(int defaultShader) { this->defaultShader = defaultShader; }
@@ -371,151 +473,476 @@ void ygl::Renderer::setClearColor(glm::vec4 color) {
 
 void ygl::Renderer::setShadow(bool shadow) { this->shadow = shadow; }
 
+void ygl::Renderer::setShadowCascades(uint count) {
+	if (count == shadowCascades.getCount()) return;
+	shadowCascades.setCount(count);
+	if (shadowFrameBuffer) createShadowMaps();
+}
+
+void ygl::Renderer::setShadowMapSize(uint size) {
+	if (size == shadowCascades.getResolution()) return;
+	shadowCascades.setResolution(size);
+	if (shadowFrameBuffer) createShadowMaps();
+}
+
+void ygl::Renderer::createShadowMaps() {
+	delete shadowFrameBuffer;
+	uint size		  = shadowCascades.getResolution();
+	shadowMaps		  = new Texture2dArray(size, size, shadowCascades.getCount(), TextureType::DEPTH_24);
+	shadowFrameBuffer = new FrameBuffer(nullptr, GL_COLOR_ATTACHMENT0, shadowMaps, GL_DEPTH_ATTACHMENT,
+										"Shadow Framebuffer");
+	dbLog(ygl::LOG_DEBUG, "shadow texture: ", shadowMaps->getID());
+	// the new layers hold nothing, so every cascade is drawn again
+	std::fill(std::begin(renderedHashes), std::end(renderedHashes), 0);
+}
+
+void ygl::Renderer::setGPUDriven(bool gpuDriven) {
+#ifndef YGL_NO_COMPUTE_SHADERS
+	this->gpuDriven = gpuDriven;
+	if (!gpuDriven || meshPool) return;
+
+	meshPool		  = new MeshPool();
+	cullShader		  = new ComputeShader(YGL_RELATIVE_PATH "./shaders/culling/frustumCull.comp");
+	commandsBuffer	  = MutableBuffer(GL_DRAW_INDIRECT_BUFFER, 1024 * sizeof(MeshPool::DrawCommand), GL_DYNAMIC_DRAW);
+	depthPyramid	  = new DepthPyramid();
+#else
+	if (gpuDriven) dbLog(ygl::LOG_WARNING, "GPU driven rendering needs compute shaders");
+#endif
+}
+
 void ygl::Renderer::swapFrameBuffers() { std::swap(frontFrameBuffer, backFrameBuffer); }
 
-void ygl::Renderer::drawScene() {
-	// bind default shader
-	uint prevShaderIndex;
-	if (defaultShader != (uint)-1) {
-		asman->getShader(defaultShader)->bind();
-		prevShaderIndex = defaultShader;
-	} else {
-		if (asman->getShadersCount()) asman->getShader(0)->bind();	   // there has to be at least one shader
-		prevShaderIndex = 0;
-	}
-
-	for (Entity e : entities) {
-		ygl::Transformation	   &transform = scene->getComponent<Transformation>(e);
-		ygl::RendererComponent &ecr		  = scene->getComponent<RendererComponent>(e);
-
-		Shader *sh;
-		// binds the object's own shader if present.
-		// Oherwise checks if the default shader has been bound by the previous object
-		// and binds it only if needed
-		if (ecr.shaderIndex != (uint)-1) {				  // if object has a shader
-			if (ecr.shaderIndex != prevShaderIndex) {	  // if its different from the previous one
-				asman->getShader(prevShaderIndex)->unbind();
-				sh				= asman->getShader(ecr.shaderIndex);
-				prevShaderIndex = ecr.shaderIndex;	   // the next previous is the current
-				sh->bind();
-			} else {
-				sh = asman->getShader(prevShaderIndex);		// set sh so that its not null
-			}
-		} else {
+glm::vec4 ygl::Renderer::getCullingSphere(glm::vec4 meshSphere, GLenum depthFunc, bool animated,
+										   const glm::mat4 &world) {
+	// skinned vertices can leave the bounds of the bind pose. Meshes with their own depth test, like the skybox, are
+	// drawn around the camera whatever their bounds are.
+	if (animated || depthFunc != GL_LESS) return glm::vec4(glm::vec3(world[3]), INFINITY);
+
+	float scale2 =
+		std::max({glm::dot(world[0], world[0]), glm::dot(world[1], world[1]), glm::dot(world[2], world[2])});
+	return glm::vec4(glm::vec3(world * glm::vec4(glm::vec3(meshSphere), 1)), meshSphere.w * std::sqrt(scale2));
+}
+
+void ygl::Renderer::collectDraws() {
+	Profiler::Scope scope(profiler, "collectDraws");
+	assert(mainCamera && "must have a main camera");
+	renderQueue.clear();
+	candidates.clear();
+	shadowShaders.clear();
+	boundingSpheres.clear();
+
+	scene->forEach<Transformation, RendererComponent>([&](Entity, Transformation &transform, RendererComponent &ecr) {
+		RenderQueue::Draw draw = {&transform, ecr.shaderIndex, ecr.materialIndex, ecr.meshIndex, ecr.isAnimated};
+		if (draw.shader == (uint)-1) {
 			assert(defaultShader != (uint)-1 && "cannot use default shader when it is not defined");
-			if (prevShaderIndex != defaultShader) {		// if the previous shader was different
-				asman->getShader(prevShaderIndex)->unbind();
-				sh				= asman->getShader(defaultShader);
-				prevShaderIndex = defaultShader;
-				sh->bind();
-			} else {
-				sh = asman->getShader(defaultShader);	  // set sh so its not null
+			draw.shader = defaultShader;
+		}
+		uint shadowShader = ecr.shadowShaderIndex;
+		if (shadow && shadowShader == (uint)-1) {
+			assert(defaultShadowShader != (uint)-1 && "cannot use default shader when it is not defined");
+			shadowShader = defaultShadowShader;
+		}
+
+		IMesh *mesh = getMesh(ecr);
+		candidates.push_back(draw);
+		shadowShaders.push_back(shadowShader);
+		boundingSpheres.push_back(getCullingSphere(mesh->getBoundingSphere(), mesh->getDepthFunc(), ecr.isAnimated,
+												   transform.getWorldMatrix()));
+	});
+
+	// all spheres are tested in one batch so that the SIMD path is used
+	colorVisible.assign(candidates.size(), 1);
+	if (frustumCulling) {
+		mainCamera->getFrustum().cullSpheres(boundingSpheres.data(), candidates.size(), colorVisible.data());
+	}
+
+	glm::vec3 eye = mainCamera->transform.position;
+	// wireframe lines would not cover the depth of the prepass
+	bool prepass = depthPrepass && renderMode != 6;
+	culledCount	 = 0;
+	for (std::size_t i = 0; i < candidates.size(); ++i) {
+		RenderQueue::Draw draw = candidates[i];
+		if (!colorVisible[i]) {
+			++culledCount;
+			continue;
+		}
+		float depth		  = glm::distance(eye, glm::vec3(draw.transform->getWorldMatrix()[3]));
+		uint  depthShader = prepass ? getDepthShader(draw, shadowShaders[i]) : -1;
+		draw.prepassed	  = depthShader != (uint)-1;
+		renderQueue.add(RenderQueue::makeKey(RenderQueue::COLOR_PASS, draw.shader, draw.material, draw.mesh, depth),
+						draw);
+		if (draw.prepassed) {
+			draw.shader = depthShader;
+			// no materials are used, like in the shadow pass
+			renderQueue.add(RenderQueue::makeKey(RenderQueue::DEPTH_PASS, draw.shader, 0, draw.mesh, depth), draw);
+		}
+	}
+	collectShadowDraws();
+
+	renderQueue.sort();
+	reserveFrameData();
+	uploadMaterialsAndLights();
+	if (shadow) uploadShadowCascades();
+	uploadInstanceMatrices();
+#ifndef YGL_NO_COMPUTE_SHADERS
+	if (gpuDriven) uploadDrawEntries();
+	else drawEntries.clear();
+#endif
+}
+
+void ygl::Renderer::collectShadowDraws() {
+	// the cascades follow the view frustum of the main camera, they need a directional light to point along
+	cascadesCount = 0;
+	if (!shadow || lights.empty() || lights[0].type != Light::Type::DIRECTIONAL) return;
+	shadowCascades.fit(mainCamera->getProjectionMatrix(), glm::inverse(mainCamera->getViewMatrix()),
+					   lights[0].transform, shadowDistance);
+	cascadesCount = shadowCascades.getCount();
+
+	shadowVisible.resize(candidates.size());
+	for (uint c = 0; c < cascadesCount; ++c) {
+		// culling also finds how far towards the light the cascade has to reach, so it is done even when disabled
+		shadowCascades.cull(c, boundingSpheres.data(), candidates.size(), shadowVisible.data());
+		if (!frustumCulling) shadowVisible.assign(candidates.size(), 1);
+		const ShadowCascades::Cascade &cascade = shadowCascades[c];
+
+		// the layer of a cascade is drawn again only when its bounds or one of its casters change. The pose of
+		// animated meshes is not known here, cascades with them are drawn every frame.
+		uint64_t hash	  = cache::hash(&cascade.projection, sizeof(glm::mat4));
+		hash			  = cache::hash(&cascade.view, sizeof(glm::mat4), hash);
+		bool	 animated = false;
+		for (std::size_t i = 0; i < candidates.size(); ++i) {
+			if (!shadowVisible[i]) {
+				++culledCount;
+				continue;
 			}
+			RenderQueue::Draw draw	= candidates[i];
+			const glm::mat4	 &world = draw.transform->getWorldMatrix();
+			draw.shader				= shadowShaders[i];
+			float depth				= -(cascade.view * world[3]).z - cascade.castersDepth;
+			// materials are not used when drawing shadows, so they are left out of the key
+			renderQueue.add(RenderQueue::makeKey(RenderQueue::SHADOW_PASS + c, draw.shader, 0, draw.mesh, depth), draw);
+
+			hash = cache::hash(&world, sizeof(glm::mat4), hash);
+			hash = cache::hash(&draw.shader, sizeof(draw.shader), hash);
+			hash = cache::hash(&draw.mesh, sizeof(draw.mesh), hash);
+			animated |= draw.animated;
 		}
-		// sh is never null and the current bound shader
+		cascadeHashes[c] = animated ? 0 : hash;
+	}
+}
 
+void ygl::Renderer::uploadShadowCascades() {
+	GLsizeiptr alignment = RingBuffer::getOffsetAlignment(GL_UNIFORM_BUFFER);
 
-		bindTexturesForMaterial(ecr.materialIndex, sh);
+	// each cascade is drawn with its own camera block at binding 0
+	for (uint c = 0; c < cascadesCount; ++c) {
+		glm::mat4 view		 = shadowCascades[c].view;
+		glm::mat4 matrices[] = {shadowCascades[c].projection, view, glm::inverse(view)};
+		cascadeCameras[c]	 = frameData.write(matrices, sizeof(matrices), alignment);
+	}
 
-		IMesh *mesh = getMesh(ecr.meshIndex);
-		mesh->bind();
-		// set uniforms
-		if (sh->hasUniform("worldMatrix")) sh->setUniform("worldMatrix", transform.getWorldMatrix());
-		if (sh->hasUniform("material_index")) sh->setUniform("material_index", (GLuint)ecr.materialIndex);
-		if (sh->hasUniform("animate")) sh->setUniform("animate", ecr.isAnimated);
+	ShadowCascades::Uniforms uniforms = shadowCascades.getUniforms();
+	uniforms.count					  = cascadesCount;
+	frameData.bindRange(GL_UNIFORM_BUFFER, 4, frameData.write(&uniforms, sizeof(uniforms), alignment));
+}
 
-		if (renderMode == 6) { glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); }
+void ygl::Renderer::uploadInstanceMatrices() {
+	instanceMatrices.resize(renderQueue.size());
+	for (std::size_t i = 0; i < renderQueue.size(); ++i) {
+		instanceMatrices[i] = renderQueue[i].transform->getWorldMatrix();
+	}
 
-		// draw
-		glDrawElements(mesh->getDrawMode(), mesh->getIndicesCount(), GL_UNSIGNED_INT, 0);
-		// clean up
-		mesh->unbind();
+	// the culling shader reads the matrices as an SSBO too
+#ifndef YGL_NO_COMPUTE_SHADERS
+	GLsizeiptr alignment = RingBuffer::getOffsetAlignment(GL_SHADER_STORAGE_BUFFER);
+#else
+	GLsizeiptr alignment = sizeof(glm::vec4);
+#endif
+	instanceRange = frameData.write(instanceMatrices.data(), instanceMatrices.size() * sizeof(glm::mat4), alignment);
+}
+
+void ygl::Renderer::enableInstanceMatrices(std::size_t first) {
+	// a mat4 attribute takes 4 consecutive locations, one for each column
+	GLState::bindBuffer(GL_ARRAY_BUFFER, frameData.getID());
+	for (GLuint i = 0; i < 4; ++i) {
+		GLuint location = INSTANCE_MATRIX_LOCATION + i;
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+							  (void *)(instanceRange.offset + (first * 4 + i) * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location, 1);
+		GLState::enableVertexAttribArray(location);
 	}
-	if (asman->getShadersCount() > prevShaderIndex)
-		asman->getShader(prevShaderIndex)->unbind();	 // unbind the last used shader
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void ygl::Renderer::shadowPass() {
-	shadowCamera.enable();
-	shadowFrameBuffer->bind();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glViewport(0, 0, shadowMapSize, shadowMapSize);
-	// drawScene();
-
-	// bind default shader
-	uint prevShaderIndex;
-	if (defaultShadowShader != (uint)-1) {
-		asman->getShader(defaultShadowShader)->bind();
-		prevShaderIndex = defaultShadowShader;
-	} else {
-		if (asman->getShadersCount()) asman->getShader(0)->bind();	   // there has to be at least one shader
-		prevShaderIndex = 0;
-	}
-
-	for (Entity e : entities) {
-		ygl::Transformation	   &transform = scene->getComponent<Transformation>(e);
-		ygl::RendererComponent &ecr		  = scene->getComponent<RendererComponent>(e);
-
-		Shader *sh;
-		// binds the object's own shader if present.
-		// Oherwise checks if the default shader has been bound by the previous object
-		// and binds it only if needed
-		if (ecr.shadowShaderIndex != (uint)-1) {				// if object has a shader
-			if (ecr.shadowShaderIndex != prevShaderIndex) {		// if its different from the previous one
-				asman->getShader(prevShaderIndex)->unbind();
-				sh				= asman->getShader(ecr.shadowShaderIndex);
-				prevShaderIndex = ecr.shadowShaderIndex;	 // the next previous is the current
-				sh->bind();
-			} else {
-				sh = asman->getShader(prevShaderIndex);		// set sh so that its not null
+void ygl::Renderer::disableInstanceMatrices() {
+	for (GLuint i = 0; i < 4; ++i) {
+		GLState::disableVertexAttribArray(INSTANCE_MATRIX_LOCATION + i);
+	}
+}
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+void ygl::Renderer::uploadDrawEntries() {
+	drawEntries.resize(renderQueue.size());
+
+	// draws are sorted by mesh within each material, so the pool entry is looked up only when the mesh changes
+	uint   meshIndex = -1;
+	GLuint entry	 = MeshPool::INVALID;
+	for (std::size_t i = 0; i < renderQueue.size(); ++i) {
+		const RenderQueue::Draw &draw = renderQueue[i];
+		if (draw.mesh != meshIndex) {
+			meshIndex	= draw.mesh;
+			IMesh *mesh = getMesh(meshIndex);
+			auto   it	= meshEntries.find(mesh);
+			if (it == meshEntries.end()) it = meshEntries.emplace(mesh, meshPool->add(mesh)).first;
+			entry = it->second;
+		}
+		// animated draws need the bone matrices of their own entity
+		drawEntries[i] = draw.animated ? MeshPool::INVALID : entry;
+	}
+
+	drawEntriesRange = frameData.write(drawEntries.data(), drawEntries.size() * sizeof(GLuint),
+									   RingBuffer::getOffsetAlignment(GL_SHADER_STORAGE_BUFFER));
+
+	GLsizeiptr commandsSize = drawEntries.size() * sizeof(MeshPool::DrawCommand);
+	if (commandsSize > commandsBuffer.getSize())
+		commandsBuffer.resize(std::max(commandsSize, 2 * commandsBuffer.getSize()));
+}
+
+void ygl::Renderer::cullDraws(std::size_t first, std::size_t last, bool occlusion) {
+	if (first == last) return;
+
+	frameData.bindRange(GL_SHADER_STORAGE_BUFFER, 1, instanceRange);
+	frameData.bindRange(GL_SHADER_STORAGE_BUFFER, 2, drawEntriesRange);
+	Shader::setSSBO(meshPool->getEntriesBuffer(), 3);
+	Shader::setSSBO(commandsBuffer.getID(), 4);
+
+	occlusion = occlusion && occlusionCulling && depthPyramid->isBuilt();
+	cullShader->bind();
+	cullShader->setUniform("first", (GLuint)first);
+	cullShader->setUniform("count", (GLuint)(last - first));
+	cullShader->setUniform("occlusion", (GLboolean)occlusion);
+	if (occlusion) {
+		depthPyramid->bind(GL_TEXTURE9);
+		cullShader->setUniform("pyramidViewProjection", depthPyramid->getViewProjection());
+	}
+	Renderer::compute(cullShader, last - first, 1, 1);
+	cullShader->unbind();
+	if (occlusion) depthPyramid->unbind(GL_TEXTURE9);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void ygl::Renderer::buildDepthPyramid() {
+	// without screen effects the scene is drawn to the default framebuffer, whose depth cannot be read
+	if (!gpuDriven || !occlusionCulling || effects.empty()) {
+		if (depthPyramid) depthPyramid->invalidate();
+		return;
+	}
+	Profiler::Scope scope(profiler, "depthPyramid");
+	depthPyramid->build(backFrameBuffer->getDepthStencil(), window->getWidth(), window->getHeight(),
+						mainCamera->getProjectionMatrix() * mainCamera->getViewMatrix());
+}
+
+void ygl::Renderer::buildLightClusters() {
+	// the clusters are in the space of the main camera, which has to be enabled. The header of the lights says if
+	// clusters were requested for this frame.
+	Shader::setSSBO(clusterLightsCounts.getID(), 6);
+	Shader::setSSBO(clusterLights.getID(), 7);
+	clusterShader->bind();
+	Renderer::compute(clusterShader, CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z, 1, 1);
+	clusterShader->unbind();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+#endif
+
+void ygl::Renderer::submitDraws(uint pass) {
+	auto [first, last] = renderQueue.getPassRange(pass);
+
+	Shader *sh	 = nullptr;
+	IMesh  *mesh = nullptr;
+
+	uint shaderIndex = -1, materialIndex = -1, meshIndex = -1;
+	bool instanced	 = false;
+
+	// draws that differ only in their transformation can be drawn with a single instanced call. Animated draws share
+	// the bone matrices, so they are always drawn one by one.
+	auto canInstance = [&](const RenderQueue::Draw &a, const RenderQueue::Draw &b) {
+		return a.shader == b.shader && a.mesh == b.mesh && !a.animated && !b.animated &&
+			   a.prepassed == b.prepassed && (pass != RenderQueue::COLOR_PASS || a.material == b.material);
+	};
+	auto setInstanced = [&](bool value) {
+		if (instanced == value) return;
+		instanced = value;
+		instancedUniform.set(sh, value);
+	};
+	// the depth of prepassed draws is already in the depth buffer, so only their visible fragments are shaded
+	auto setPrepassed = [&](bool prepassed, GLenum depthFunc) {
+		if (pass != RenderQueue::COLOR_PASS) return;
+		GLState::depthFunc(prepassed ? GL_EQUAL : depthFunc);
+		GLState::depthMask(!prepassed);
+	};
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+	// the GPU driven path may have been enabled after the draws were collected
+	bool indirect = gpuDriven && drawEntries.size() == renderQueue.size();
+	// the depth pyramid is seen from the main camera, the shadow passes are only frustum culled
+	if (indirect) {
+		cullDraws(first, last, pass == RenderQueue::COLOR_PASS || pass == RenderQueue::DEPTH_PASS);
+	}
+#endif
+
+	// the draws are sorted by shader, then material, then mesh, so state is changed only when it differs from the
+	// previous draw
+	for (std::size_t i = first; i < last; ++i) {
+		const RenderQueue::Draw &draw = renderQueue[i];
+
+		if (draw.shader != shaderIndex) {
+			if (sh) sh->unbind();
+			shaderIndex = draw.shader;
+			sh			= asman->getShader(shaderIndex);
+			sh->bind();
+
+			if (pass == RenderQueue::COLOR_PASS) bindSceneTextures(sh);
+			materialIndex = -1;		// uniforms are per program, so the material has to be set again
+			// the program keeps the value from the last time it was used
+			instanced = false;
+			instancedUniform.set(sh, false);
+		}
+
+		if (pass == RenderQueue::COLOR_PASS && draw.material != materialIndex) {
+			materialIndex = draw.material;
+			bindMaterialTextures(materialIndex);
+			materialIndexUniform.set(sh, materialIndex);
+		}
+
+#ifndef YGL_NO_COMPUTE_SHADERS
+		// pooled draws with the same shader and material are drawn with one indirect call, even with different meshes.
+		// The culling shader wrote a command for every draw and zero instances for the ones that are not visible.
+		if (indirect && instancedUniform.exists(sh) && drawEntries[i] != MeshPool::INVALID) {
+			std::size_t runEnd = i + 1;
+			while (runEnd < last && drawEntries[runEnd] != MeshPool::INVALID &&
+				   renderQueue[runEnd].shader == draw.shader && renderQueue[runEnd].prepassed == draw.prepassed &&
+				   (pass != RenderQueue::COLOR_PASS || renderQueue[runEnd].material == draw.material)) {
+				++runEnd;
 			}
-		} else {
-			assert(defaultShadowShader != (uint)-1 && "cannot use default shader when it is not defined");
-			if (prevShaderIndex != defaultShadowShader) {	  // if the previous shader was different
-				asman->getShader(prevShaderIndex)->unbind();
-				sh				= asman->getShader(defaultShadowShader);
-				prevShaderIndex = defaultShadowShader;
-				sh->bind();
-			} else {
-				sh = asman->getShader(defaultShadowShader);		// set sh so its not null
+
+			if (mesh) mesh->unbind();
+			mesh	  = nullptr;
+			meshIndex = -1;
+
+			animateUniform.set(sh, false);
+			setInstanced(true);
+			meshPool->bind();
+			setPrepassed(draw.prepassed, GL_LESS);
+			if (pass == RenderQueue::COLOR_PASS && renderMode == 6) { GLState::polygonMode(GL_LINE); }
+			// each command has its draw index as base instance, so the instance attributes start at the first matrix
+			enableInstanceMatrices(0);
+
+			GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsBuffer.getID());
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(i * sizeof(MeshPool::DrawCommand)),
+										runEnd - i, 0);
+			GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+			disableInstanceMatrices();
+			meshPool->unbind();
+			i = runEnd - 1;
+			continue;
+		}
+#endif
+
+		if (draw.mesh != meshIndex) {
+			if (mesh) mesh->unbind();
+			meshIndex = draw.mesh;
+			mesh	  = getMesh(meshIndex);
+			mesh->bind();
+			if (pass == RenderQueue::COLOR_PASS && renderMode == 6) { GLState::polygonMode(GL_LINE); }
+		}
+		setPrepassed(draw.prepassed, mesh->getDepthFunc());
+
+		std::size_t runEnd = i + 1;
+		if (instancedUniform.exists(sh)) {
+			while (runEnd < last && canInstance(draw, renderQueue[runEnd])) {
+				++runEnd;
 			}
 		}
-		// sh is never null and the current bound shader
 
-		IMesh *mesh = getMesh(ecr.meshIndex);
-		mesh->bind();
-		// set uniforms
-		if (sh->hasUniform("worldMatrix")) sh->setUniform("worldMatrix", transform.getWorldMatrix());
-		if (sh->hasUniform("animate")) sh->setUniform("animate", ecr.isAnimated);
+		animateUniform.set(sh, draw.animated);
+
+		if (runEnd - i > 1) {
+			setInstanced(true);
+			enableInstanceMatrices(i);
+			glDrawElementsInstanced(mesh->getDrawMode(), mesh->getIndicesCount(), GL_UNSIGNED_INT, 0, runEnd - i);
+			disableInstanceMatrices();
+			i = runEnd - 1;
+			continue;
+		}
+
+		if (instancedUniform.exists(sh)) setInstanced(false);
+		worldMatrixUniform.set(sh, draw.transform->getWorldMatrix());
 
-		// draw
 		glDrawElements(mesh->getDrawMode(), mesh->getIndicesCount(), GL_UNSIGNED_INT, 0);
-		// clean up
-		mesh->unbind();
 	}
-	if (asman->getShadersCount() > prevShaderIndex)
-		asman->getShader(prevShaderIndex)->unbind();	 // unbind the last used shader
+
+	if (mesh) mesh->unbind();
+	if (sh) sh->unbind();
+}
+
+void ygl::Renderer::drawScene() { submitDraws(RenderQueue::COLOR_PASS); }
+
+void ygl::Renderer::shadowPass() {
+	Profiler::Scope scope(profiler, "shadowPass");
+	renderedCascades = 0;
+	shadowFrameBuffer->bind();
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::depthMask(true);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glViewport(0, 0, shadowCascades.getResolution(), shadowCascades.getResolution());
+
+	for (uint c = 0; c < cascadesCount; ++c) {
+		// the layer still holds the same casters seen from the same place
+		if (cascadeHashes[c] != 0 && cascadeHashes[c] == renderedHashes[c]) continue;
+
+		shadowMaps->BindToFrameBuffer(*shadowFrameBuffer, GL_DEPTH_ATTACHMENT, c, 0);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		// the main camera is enabled again by the color pass
+		frameData.bindRange(GL_UNIFORM_BUFFER, 0, cascadeCameras[c]);
+		submitDraws(RenderQueue::SHADOW_PASS + c);
+
+		renderedHashes[c] = cascadeHashes[c];
+		++renderedCascades;
+	}
 
 	shadowFrameBuffer->unbind();
 }
 
+void ygl::Renderer::depthPass() {
+	Profiler::Scope scope(profiler, "depthPass");
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	GLState::depthMask(true);
+	submitDraws(RenderQueue::DEPTH_PASS);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
 void ygl::Renderer::colorPass() {
+	Profiler::Scope scope(profiler, "colorPass");
 	assert(mainCamera && "must have a main camera");
 	mainCamera->enable();
-	if (shadow) shadowCamera.enable(4);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	if (lightClustering && clusterShader) buildLightClusters();
+#endif
 	if (this->effects.size()) backFrameBuffer->bind();
 	else FrameBuffer::bindDefault();
 
 	glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
 	backFrameBuffer->clear();
-	glEnable(GL_DEPTH_TEST);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glViewport(0, 0, window->getWidth(), window->getHeight());
 
-	// draw all entities
+	// draw all entities, the prepass is empty when it is disabled
+	depthPass();
 	drawScene();
+	GLState::depthMask(true);
+	GLState::depthFunc(GL_LESS);
 
 	// run draw calls from other systems
 	for (auto f : drawFunctions) {
@@ -523,33 +950,109 @@ void ygl::Renderer::colorPass() {
 	}
 
 	backFrameBuffer->unbind();
+#ifndef YGL_NO_COMPUTE_SHADERS
+	// the next frame is tested against the depth of this one
+	buildDepthPyramid();
+#endif
 	swapFrameBuffers();
 }
 
 void ygl::Renderer::effectsPass() {
-	glDisable(GL_DEPTH_TEST);
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	int effectsCount = effects.size();
-	for (int i = 0; i < effectsCount; ++i) {
-		auto effect = effects[i];
-		if (i == effectsCount - 1) {
-			effect->apply(frontFrameBuffer, 0);
+	Profiler::Scope scope(profiler, "effectsPass");
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::polygonMode(GL_FILL);
+	GLState::enable(GL_BLEND);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	std::size_t effectsCount = effects.size();
+	for (std::size_t i = 0; i < effectsCount;) {
+		std::size_t end = i + 1;
+		if (effects[i]->getFusedStage() != IScreenEffect::NOT_FUSED) {
+			// a run of fused effects ends at one that the fused shader applies earlier than the ones before it
+			while (end < effectsCount && effects[end]->getFusedStage() > effects[end - 1]->getFusedStage()) {
+				++end;
+			}
+		}
+		FrameBuffer *target = end == effectsCount ? nullptr : backFrameBuffer;
+
+		if (effects[i]->getFusedStage() == IScreenEffect::NOT_FUSED) {
+			effects[i]->apply(frontFrameBuffer, target);
 		} else {
-			effect->apply(frontFrameBuffer, backFrameBuffer);
-			swapFrameBuffers();
+			bool anyEnabled = std::any_of(effects.begin() + i, effects.begin() + end,
+										  [](IScreenEffect *effect) { return effect->enabled; });
+			// a run that does nothing is skipped, unless it has to draw the result to the screen
+			if (!anyEnabled && target) {
+				i = end;
+				continue;
+			}
+			for (std::size_t j = i; j < end; ++j) {
+				if (effects[j]->enabled) effects[j]->prepareFused(frontFrameBuffer);
+			}
+			fusedPass(effects.data() + i, end - i, frontFrameBuffer, target);
 		}
+
+		if (target) swapFrameBuffers();
+		i = end;
 	}
 	FrameBuffer::bindDefault();
 }
 
+void ygl::Renderer::fusedPass(IScreenEffect *const *effects, std::size_t count, FrameBuffer *source,
+							  FrameBuffer *target) {
+	uint stages = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		if (effects[i]->enabled) stages |= 1u << effects[i]->getFusedStage();
+	}
+
+	if (target) target->bind();
+	else FrameBuffer::bindDefault();
+
+	VFShader *shader = getFusedShader(stages);
+	shader->bind();
+	source->getColor()->bind(GL_TEXTURE7);
+	for (std::size_t i = 0; i < count; ++i) {
+		if (effects[i]->enabled) effects[i]->setFusedUniforms(shader);
+	}
+	Renderer::drawObject(shader, screenQuad);
+	source->getColor()->unbind(GL_TEXTURE7);
+}
+
+ygl::VFShader *ygl::Renderer::getFusedShader(uint stages) {
+	auto found = fusedShaders.find(stages);
+	if (found != fusedShaders.end()) return found->second;
+
+	static const char *stageDefines[IScreenEffect::FUSED_STAGES_COUNT] = {nullptr, "FUSE_BLOOM", "FUSE_VIGNETTE",
+																		   "FUSE_TONEMAP"};
+	std::vector<std::string> defines;
+	for (uint stage = IScreenEffect::BLOOM; stage < IScreenEffect::FUSED_STAGES_COUNT; ++stage) {
+		if (stages & (1u << stage)) defines.push_back(stageDefines[stage]);
+	}
+	VFShader *shader = new VFShader(YGL_RELATIVE_PATH "./shaders/ui/textureOnScreen.vs",
+									YGL_RELATIVE_PATH "./shaders/postProcessing/fused.fs", defines);
+	fusedShaders.emplace(stages, shader);
+	return shader;
+}
+
 void ygl::Renderer::doWork() {
+	glStats = GLState::getStats();
+	GLState::resetStats();
+
+	// captures of earlier frames that the GPU has finished go to the encoder
+	frameCapture.poll();
+
+	frameData.nextFrame();
+	collectDraws();
 	if (shadow) shadowPass();
 	colorPass();
 	effectsPass();
+	if (isRecording()) {
+		char number[16];
+		snprintf(number, sizeof(number), "%06u", recordedFrames++);
+		frameCapture.capture(0, 0, window->getWidth(), window->getHeight(),
+							 recordingPrefix + number + recordingExtension);
+	}
 	defaultTexture.bind(GL_TEXTURE0);	  // some things break when nothing is bound to texture0
+	profiler.endFrame();
 }
 
 ygl::Renderer::~Renderer() {
@@ -559,7 +1062,16 @@ ygl::Renderer::~Renderer() {
 	delete frontFrameBuffer;
 	delete backFrameBuffer;
 	delete shadowFrameBuffer;
+	for (auto &[stages, shader] : fusedShaders) {
+		delete shader;
+	}
 	delete screenQuad;
+#ifndef YGL_NO_COMPUTE_SHADERS
+	delete meshPool;
+	delete depthPyramid;
+#endif
+	delete cullShader;
+	delete clusterShader;
 }
 
 void ygl::Renderer::addDrawFunction(const std::function<void()> &func) { drawFunctions.push_back(func); }
@@ -568,8 +1080,10 @@ void ygl::Renderer::drawObject(Transformation &transform, Shader *sh, Mesh *mesh
 	sh->bind();
 
 	mesh->bind();
-	if (sh->hasUniform("worldMatrix")) sh->setUniform("worldMatrix", transform.getWorldMatrix());
-	if (sh->hasUniform("material_index")) sh->setUniform("material_index", materialIndex);
+	static Uniform<glm::mat4> worldMatrixUniform("worldMatrix");
+	static Uniform<GLuint>	  materialIndexUniform("material_index");
+	worldMatrixUniform.set(sh, transform.getWorldMatrix());
+	materialIndexUniform.set(sh, materialIndex);
 
 	glDrawElements(mesh->getDrawMode(), mesh->getIndicesCount(), GL_UNSIGNED_INT, 0);
 	mesh->unbind();
@@ -603,23 +1117,35 @@ void ygl::Renderer::compute(ComputeShader *shader, int domainX, int domainY, int
 GLuint ygl::Renderer::loadMaterials(int count, Material *materials) {
 	GLuint materialsBuffer;
 	glGenBuffers(1, &materialsBuffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, materialsBuffer);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, materialsBuffer);
 	glBufferData(GL_UNIFORM_BUFFER, count * sizeof(Material), materials, GL_DYNAMIC_DRAW);
 	Shader::setUBO(materialsBuffer, 1);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
 	return materialsBuffer;
 }
 
 GLuint ygl::Renderer::loadLights(int count, Light *lights) {
 	GLuint lightsBuffer;
 	glGenBuffers(1, &lightsBuffer);
-	glBindBuffer(GL_UNIFORM_BUFFER, lightsBuffer);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	// without clusters every fragment loops over all lights
+	LightsHeader header = makeLightsHeader(nullptr, glm::vec2(0), count);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, lightsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(LightsHeader) + count * sizeof(Light), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(LightsHeader), &header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(LightsHeader), count * sizeof(Light), lights);
+	Shader::setSSBO(lightsBuffer, 5);
+	GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return lightsBuffer;
+#else
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, lightsBuffer);
 	glBufferData(GL_UNIFORM_BUFFER, 100 * sizeof(Light) + sizeof(uint), nullptr, GL_DYNAMIC_DRAW);
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(Light), lights);
 	glBufferSubData(GL_UNIFORM_BUFFER, 100 * sizeof(Light), sizeof(uint), &count);
 	Shader::setUBO(lightsBuffer, 2);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
 	return lightsBuffer;
+#endif
 }
 
 bool ygl::Renderer::hasSkybox() { return skyboxTexture && irradianceTexture && prefilterTexture; }
@@ -630,6 +1156,19 @@ void ygl::Renderer::drawGUI() {
 	ImGui::Begin("Renderer Settings");
 
 	ImGui::InputInt("Render Mode", (int *)&renderMode);
+#ifndef YGL_NO_COMPUTE_SHADERS
+	bool gpuDriven = this->gpuDriven;
+	if (ImGui::Checkbox("GPU Driven", &gpuDriven)) setGPUDriven(gpuDriven);
+	ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+#endif
+	ImGui::Checkbox("Frustum Culling", &frustumCulling);
+	ImGui::Checkbox("Depth Prepass", &depthPrepass);
+	ImGui::Checkbox("Light Clustering", &lightClustering);
+	ImGui::Text("Culled draws: %zu", culledCount);
+	ImGui::Text("Captures in flight: %zu", frameCapture.getPendingCount());
+	if (shadow) ImGui::Text("Shadow cascades drawn: %u of %u", renderedCascades, cascadesCount);
+	ImGui::Text("GL calls: %llu issued, %llu skipped", (unsigned long long)glStats.issued,
+				(unsigned long long)glStats.skipped);
 	ImGui::SeparatorText("Screen Effects");
 	for (uint i = 0; i < effects.size(); ++i) {
 		ImGui::Checkbox(("Effect" + std::to_string(i)).c_str(), &(effects[i]->enabled));
@@ -641,6 +1180,8 @@ void ygl::Renderer::drawGUI() {
 	ImGui::Image(textureViewIndex, ImVec2(256, 256));
 
 	ImGui::End();
+
+	profiler.drawGui();
 }
 
 bool ygl::Renderer::drawMaterialEditor() {
@@ -660,29 +1201,16 @@ bool ygl::Renderer::drawMaterialEditor() {
 	return res;
 }
 
-#include <stb_image_write.h>
 void ygl::Renderer::screenShot(const std::string &filename) {
 	GLint viewport[4];
 	glGetIntegerv(GL_VIEWPORT, viewport);
-	int width  = viewport[2];
-	int height = viewport[3];
-
-	std::vector<uint8_t> pixels(width * height * 4);
-	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
-
-	// Flip the image vertically
-	for (int y = 0; y < height / 2; ++y) {
-		for (int x = 0; x < width; ++x) {
-			int topIndex	= (y * width + x) * 4;
-			int bottomIndex = ((height - y - 1) * width + x) * 4;
-			std::swap_ranges(pixels.begin() + topIndex, pixels.begin() + topIndex + 4, pixels.begin() + bottomIndex);
-		}
-	}
+	frameCapture.capture(0, 0, viewport[2], viewport[3], filename);
+}
 
-	stbi_set_flip_vertically_on_load(true);
-	stbi_write_png(filename.c_str(), width, height, 4, pixels.data(), width * 4);
-	stbi_write_jpg(filename.c_str(), width, height, 4, pixels.data(), 75);
-	dbLog(ygl::LOG_DEBUG, "Screenshot saved to: ", filename);
+void ygl::Renderer::startRecording(const std::string &prefix, const std::string &extension) {
+	recordingPrefix	   = prefix;
+	recordingExtension = extension;
+	recordedFrames	   = 0;
 }
 
 void ygl::Renderer::write(std::ostream &out) {
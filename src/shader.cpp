@@ -1,12 +1,15 @@
 #include <shader.h>
 
 #include <yoghurtgl.h>
+#include <gl_state.h>
+#include <file_cache.h>
 #include <assert.h>
+#include <fstream>
 
 ygl::Shader::~Shader() {
 	if (shaders != nullptr) { deleteShaders(); }
 	if (program != 0) {
-		glDeleteProgram(program);
+		GLState::deleteProgram(program);
 		program = 0;
 	}
 	for (uint i = 0; i < shadersCount; ++i) {
@@ -23,7 +26,8 @@ void ygl::Shader::deleteShaders() {
 }
 
 void ygl::Shader::detachShaders() {
-	for (uint i = 0; i < shadersCount; ++i) {
+	for (uint i = 0; i < sources.size(); ++i) {
+		if (shaders[i] == 0) continue;
 		glDetachShader(program, shaders[i]);
 		glDeleteShader(shaders[i]);
 		shaders[i] = 0;
@@ -32,8 +36,10 @@ void ygl::Shader::detachShaders() {
 
 void ygl::Shader::init(std::vector<std::string> files) {
 	shadersCount = files.size();
-	shaders		 = new GLuint[shadersCount];
+	shaders		 = new GLuint[shadersCount]();
 	fileNames	 = new const char *[shadersCount];
+	sources.resize(shadersCount);
+	types.resize(shadersCount);
 
 	for (uint i = 0; i < shadersCount; ++i) {
 		fileNames[i] = new char[files[i].size() + 1];
@@ -68,24 +74,114 @@ void ygl::Shader::createShader(GLenum type, GLuint target, const char *file) {
 	std::ifstream in(file);
 	if (in.fail()) { std::cerr << "Error: failed opening file: " << file << std::endl; }
 
-	int	  sh = glCreateShader(type);
 	char *source;
 	int	  length;
 	loadSource(file, type, source, length);
 
-	glShaderSource(sh, 1, &source, &length);
-
+	sources[target].assign(source, length);
+	types[target] = type;
 	delete[] source;
-	glCompileShader(sh);
-	shaders[target] = sh;
+}
+
+void ygl::Shader::compileShaders() {
+	for (uint i = 0; i < sources.size(); ++i) {
+		const char *source = sources[i].c_str();
+		GLint		length = sources[i].size();
+
+		GLuint sh = glCreateShader(types[i]);
+		glShaderSource(sh, 1, &source, &length);
+		glCompileShader(sh);
+		shaders[i] = sh;
+	}
 }
 
 void ygl::Shader::attachShaders() {
-	for (uint i = 0; i < shadersCount; ++i) {
+	for (uint i = 0; i < sources.size(); ++i) {
 		glAttachShader(program, shaders[i]);
 	}
 }
 
+uint64_t ygl::Shader::getBinaryCacheKey() {
+	// a binary is only valid for the driver that produced it
+	static const std::string driver = [] {
+		std::string result;
+		for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+			const char *str = (const char *)glGetString(name);
+			result += str ? str : "";
+			result += '\n';
+		}
+		return result;
+	}();
+
+	// the sources already contain the #version line and the defines for each stage
+	uint64_t key = cache::hash(driver);
+	for (uint i = 0; i < shadersCount; ++i) {
+		key = cache::hash(&types[i], sizeof(types[i]), key);
+		key = cache::hash(sources[i], key);
+	}
+	return key;
+}
+
+// cache entry layout: magic, key, binary format, binary length, binary
+static constexpr uint32_t PROGRAM_CACHE_MAGIC = 0x504c4759;	 // "YGLP"
+
+bool ygl::Shader::loadProgramBinary(const std::string &cacheFile, uint64_t key) {
+#ifdef __EMSCRIPTEN__
+	return false;
+#else
+	std::ifstream in(cacheFile, std::ios::binary);
+	if (!in) return false;
+
+	uint32_t magic	 = 0, length = 0;
+	uint64_t fileKey = 0;
+	GLenum	 format	 = 0;
+	in.read((char *)&magic, sizeof(magic));
+	in.read((char *)&fileKey, sizeof(fileKey));
+	in.read((char *)&format, sizeof(format));
+	in.read((char *)&length, sizeof(length));
+	if (!in || magic != PROGRAM_CACHE_MAGIC || fileKey != key) return false;
+
+	std::vector<char> binary(length);
+	in.read(binary.data(), length);
+	if (!in) return false;
+
+	glProgramBinary(program, format, binary.data(), length);
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	// drivers reject binaries after an update, then the program is compiled again and the entry is overwritten
+	return status == GL_TRUE;
+#endif
+}
+
+void ygl::Shader::saveProgramBinary(const std::string &cacheFile, uint64_t key) {
+#ifndef __EMSCRIPTEN__
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum			  format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+	if (length <= 0) return;
+
+	std::string	  tempFile = cacheFile + ".tmp";
+	std::ofstream out(tempFile, std::ios::binary);
+	uint32_t	  magic = PROGRAM_CACHE_MAGIC, size = length;
+	out.write((char *)&magic, sizeof(magic));
+	out.write((char *)&key, sizeof(key));
+	out.write((char *)&format, sizeof(format));
+	out.write((char *)&size, sizeof(size));
+	out.write(binary.data(), size);
+	out.close();
+	if (!out) {
+		dbLog(ygl::LOG_WARNING, "cannot write program cache file ", tempFile);
+		std::remove(tempFile.c_str());
+		return;
+	}
+	cache::commitFile(tempFile, cacheFile);
+#endif
+}
+
 bool ygl::Shader::checkLinkStatus() {
 	glLinkProgram(program);
 	GLint status;
@@ -132,7 +228,8 @@ bool ygl::Shader::checkCompileStatus(int target) {
 		char *shaderLog = new char[shaderLogLength + 1];
 		glGetShaderInfoLog(shader, shaderLogLength, NULL, shaderLog);
 
-		std::cerr << "Error: Shader Compilation - " << fileNames[target] << " :\n " << shaderLog << std::endl;
+		const char *file = errorShader ? "error shader" : fileNames[target];
+		std::cerr << "Error: Shader Compilation - " << file << " :\n " << shaderLog << std::endl;
 
 		delete[] shaderLog;
 		return false;
@@ -153,6 +250,9 @@ void ygl::Shader::loadSource(const char *file, GLenum type, const char *includeD
 		case GL_TESS_EVALUATION_SHADER: lines.push_back("#define TESS_EVALUATION_SHADER"); break;
 		case GL_MESH_SHADER_NV: lines.push_back("#define MESH_SHADER"); break;
 	}
+	for (const std::string &define : defines) {
+		lines.push_back("#define " + define);
+	}
 	loadSourceRecursively(lines, file, includeDir, strlen(includeDir));
 
 	length = 0;
@@ -204,19 +304,37 @@ void ygl::Shader::loadSourceRecursively(std::vector<std::string> &lines, const c
 }
 
 void ygl::Shader::finishProgramCreation() {
-	attachShaders();
-
-	bool success = true;
-	for (uint target = 0; target < shadersCount; ++target)
-		success &= checkCompileStatus(target);
-	if (success) {
-		success &= checkLinkStatus();
-		success &= checkValidateStatus();
+	uint64_t	key		  = getBinaryCacheKey();
+	std::string cacheFile = cache::getFilePath("shaders", key, ".bin");
+
+	bool success = !cacheFile.empty() && loadProgramBinary(cacheFile, key);
+	if (!success) {
+		compileShaders();
+		attachShaders();
+
+		success = true;
+		for (uint target = 0; target < sources.size(); ++target)
+			success &= checkCompileStatus(target);
+		if (success) {
+#ifndef __EMSCRIPTEN__
+			if (!cacheFile.empty()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+			success &= checkLinkStatus();
+			success &= checkValidateStatus();
+		}
+		if (success && !cacheFile.empty()) saveProgramBinary(cacheFile, key);
 	}
 	if (!success) {
 		dbLog(ygl::LOG_ERROR, "Shader failed to link");
 		detachShaders();
-		if (strcmp(fileNames[0], "./shaders/error/error.vs")) {
+		assert(!errorShader && "the error shader failed to link");
+		if (!errorShader) {
+			// the error shader replaces all stages, the ones it does not have would fail again
+			errorShader = true;
+			sources.resize(2);
+			types.resize(2);
+			delete[] shaders;
+			shaders = new GLuint[2]();
 			createShader(GL_VERTEX_SHADER, 0, YGL_RELATIVE_PATH "./shaders/error/error.vs");
 			createShader(GL_FRAGMENT_SHADER, 1, YGL_RELATIVE_PATH "./shaders/error/error.fs");
 			finishProgramCreation();
@@ -226,6 +344,7 @@ void ygl::Shader::finishProgramCreation() {
 		return;
 	}
 	deleteShaders();
+	sources.assign(sources.size(), std::string());
 	detectUniforms();
 #ifndef YGL_NO_COMPUTE_SHADERS
 	detectBlockUniforms();
@@ -235,12 +354,12 @@ void ygl::Shader::finishProgramCreation() {
 
 void ygl::Shader::bind() {
 	bound = true;
-	glUseProgram(program);
+	GLState::useProgram(program);
 }
 
 void ygl::Shader::unbind() {
 	bound = false;
-	glUseProgram(0);
+	GLState::useProgram(0);
 }
 
 void ygl::Shader::createUniform(const char *uniformName) {
@@ -349,6 +468,11 @@ GLuint ygl::Shader::getUniformLocation(const std::string &uniformName) {
 
 bool ygl::Shader::hasUniform(const std::string &uniformName) { return uniforms.find(uniformName) != uniforms.end(); }
 
+GLint ygl::Shader::findUniformLocation(const std::string &uniformName) {
+	auto res = uniforms.find(uniformName);
+	return res == uniforms.end() ? -1 : res->second;
+}
+
 
 #ifndef YGL_NO_COMPUTE_SHADERS
 void ygl::Shader::createSSBO(const std::string &name, GLuint binding) {
@@ -375,13 +499,13 @@ void ygl::Shader::createUBO(const std::string &name, GLuint binding) {
 void ygl::Shader::setSSBO(const std::string &name, GLuint bufferId) {
 	// https://www.geeks3d.com/20140704/tutorial-introduction-to-opengl-4-3-shader-storage-buffers-objects-ssbo-demo/
 	GLuint binding_point_index = getSSBOBinding(name);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_point_index, bufferId);
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_point_index, bufferId);
 }
 #endif
 
 void ygl::Shader::setUBO(const std::string &name, GLuint bufferId) {
 	GLuint binding_point_index = getUBOBinding(name);
-	glBindBufferBase(GL_UNIFORM_BUFFER, binding_point_index, bufferId);
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, binding_point_index, bufferId);
 }
 
 #ifndef YGL_NO_COMPUTE_SHADERS
@@ -408,11 +532,13 @@ bool ygl::Shader::isBound() { return bound; }
 
 #ifndef YGL_NO_COMPUTE_SHADERS
 void ygl::Shader::setSSBO(GLuint bufferId, GLuint binding) {
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bufferId);
+	GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bufferId);
 }
 #endif
 
-void ygl::Shader::setUBO(GLuint bufferId, GLuint binding) { glBindBufferBase(GL_UNIFORM_BUFFER, binding, bufferId); }
+void ygl::Shader::setUBO(GLuint bufferId, GLuint binding) {
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, binding, bufferId);
+}
 
 const char *ygl::VFShader::name = "ygl::VFShader";
 
@@ -423,6 +549,15 @@ ygl::VFShader::VFShader(const char *vertex, const char *fragment) : Shader({vert
 	finishProgramCreation();
 }
 
+ygl::VFShader::VFShader(const char *vertex, const char *fragment, const std::vector<std::string> &defines)
+	: Shader({vertex, fragment}) {
+	this->defines = defines;
+	createShader(GL_VERTEX_SHADER, 0);
+	createShader(GL_FRAGMENT_SHADER, 1);
+
+	finishProgramCreation();
+}
+
 ygl::VFShader::VFShader(std::istream &in) : Shader(in) {
 	createShader(GL_VERTEX_SHADER, 0);
 	createShader(GL_FRAGMENT_SHADER, 1);
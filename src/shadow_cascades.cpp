@@ -0,0 +1,118 @@
+#include <shadow_cascades.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+// the point at a view space depth on the ray through a point on the screen, for any projection
+glm::vec3 unproject(const glm::mat4 &inverseProjection, glm::vec2 ndc, float depth) {
+	glm::vec4 nearPoint = inverseProjection * glm::vec4(ndc, -1, 1);
+	glm::vec4 farPoint	= inverseProjection * glm::vec4(ndc, 1, 1);
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+	return glm::mix(glm::vec3(nearPoint), glm::vec3(farPoint), (depth + nearPoint.z) / (nearPoint.z - farPoint.z));
+}
+}	  // namespace
+
+ygl::ShadowCascades::ShadowCascades(uint count, uint resolution) : resolution(resolution) { setCount(count); }
+
+void ygl::ShadowCascades::setCount(uint count) {
+	assert(count >= 1 && count <= MAX_CASCADES && "invalid number of cascades");
+	this->count = count;
+}
+
+void ygl::ShadowCascades::fit(const glm::mat4 &cameraProjection, const glm::mat4 &cameraWorld,
+							  const glm::mat4 &lightTransform, float distance) {
+	// only the direction of the light matters, the cascades are placed by their bounds
+	glm::mat3 rotation(glm::normalize(glm::vec3(lightTransform[0])), glm::normalize(glm::vec3(lightTransform[1])),
+					   glm::normalize(glm::vec3(lightTransform[2])));
+	glm::mat4 view = glm::mat4(glm::transpose(rotation));
+
+	glm::mat4 inverseProjection = glm::inverse(cameraProjection);
+	glm::vec4 nearPoint			= inverseProjection * glm::vec4(0, 0, -1, 1);
+	glm::vec4 farPoint			= inverseProjection * glm::vec4(0, 0, 1, 1);
+	float	  zNear				= -nearPoint.z / nearPoint.w;
+	float	  zFar				= std::min(-farPoint.z / farPoint.w, distance);
+	zNear						= std::max(zNear, 1e-3f);
+	zFar						= std::max(zFar, zNear * 2);
+
+	glm::mat4 cameraToLight = view * cameraWorld;
+	float	  sliceNear		= zNear;
+	for (uint i = 0; i < count; ++i) {
+		Cascade &cascade = cascades[i];
+		float	 part	 = float(i + 1) / count;
+		// logarithmic splits keep the texel density even, uniform ones keep far cascades from getting too long
+		float logSplit		= zNear * std::pow(zFar / zNear, part);
+		float uniformSplit	= zNear + (zFar - zNear) * part;
+		float sliceFar		= i + 1 == count ? zFar : glm::mix(uniformSplit, logSplit, splitLambda);
+		cascade.splitDepth	= sliceFar;
+		cascade.view		= view;
+
+		glm::vec3 corners[8];
+		glm::vec3 center(0);
+		for (int j = 0; j < 8; ++j) {
+			glm::vec2 ndc((j & 1) ? 1 : -1, (j & 2) ? 1 : -1);
+			glm::vec3 corner = unproject(inverseProjection, ndc, (j & 4) ? sliceFar : sliceNear);
+			corners[j]		 = glm::vec3(cameraToLight * glm::vec4(corner, 1));
+			center += corners[j] / 8.f;
+		}
+		float radius = 0;
+		for (const glm::vec3 &corner : corners) {
+			radius = std::max(radius, glm::distance(center, corner));
+		}
+		sliceNear = sliceFar;
+
+		// the radius does not change when the camera turns, rounding it hides the floating point error
+		radius = std::ceil(radius * 16) / 16;
+		// moving the center in whole texels keeps the texels in the same place in the world. The cascade is a texel
+		// wider on each side than the sphere, so the slice stays inside after the move.
+		float texel	 = 2 * radius / (resolution - 2);
+		float extent = radius + texel;
+		center		 = glm::floor(center / texel) * texel;
+
+		cascade.min				  = glm::vec2(center) - extent;
+		cascade.max				  = glm::vec2(center) + extent;
+		cascade.receiversDepth[0] = -center.z - extent;
+		cascade.receiversDepth[1] = -center.z + extent;
+		cascade.castersDepth	  = cascade.receiversDepth[0];
+		cascade.projection		  = glm::ortho(cascade.min.x, cascade.max.x, cascade.min.y, cascade.max.y,
+											   cascade.receiversDepth[0], cascade.receiversDepth[1]);
+	}
+}
+
+void ygl::ShadowCascades::cull(uint index, const glm::vec4 *spheres, std::size_t sphereCount, uint8_t *casters) {
+	assert(index < count && "invalid cascade");
+	Cascade &cascade = cascades[index];
+
+	// the light looks along -z, so depth is -z. Casters can be anywhere between the light and the far end of the
+	// cascade, the near plane is moved to the nearest of them.
+	cascade.castersDepth = cascade.receiversDepth[0];
+	for (std::size_t i = 0; i < sphereCount; ++i) {
+		float radius = spheres[i].w;
+		if (std::isinf(radius)) {
+			casters[i] = 1;
+			continue;
+		}
+		glm::vec3 center = glm::vec3(cascade.view * glm::vec4(glm::vec3(spheres[i]), 1));
+		float	  depth	 = -center.z;
+		casters[i]		 = center.x + radius >= cascade.min.x && center.x - radius <= cascade.max.x &&
+					 center.y + radius >= cascade.min.y && center.y - radius <= cascade.max.y &&
+					 depth - radius <= cascade.receiversDepth[1];
+		if (casters[i]) cascade.castersDepth = std::min(cascade.castersDepth, depth - radius);
+	}
+
+	cascade.projection = glm::ortho(cascade.min.x, cascade.max.x, cascade.min.y, cascade.max.y, cascade.castersDepth,
+									cascade.receiversDepth[1]);
+}
+
+ygl::ShadowCascades::Uniforms ygl::ShadowCascades::getUniforms() const {
+	Uniforms uniforms{};
+	for (uint i = 0; i < count; ++i) {
+		uniforms.matrices[i] = cascades[i].projection * cascades[i].view;
+		uniforms.splits[i]	 = cascades[i].splitDepth;
+	}
+	uniforms.count = count;
+	return uniforms;
+}
@@ -3,8 +3,10 @@
 #include <shader.h>
 #include <istream>
 #include <cstring>
+#include <algorithm>
 #include "yoghurtgl.h"
 #include <renderer.h>
+#include <gl_state.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -125,6 +127,14 @@ void ygl::getTypeParameters(TextureType type, GLint &internalFormat, GLenum &for
 			_type		   = GL_UNSIGNED_INT;
 			break;
 		}
+		case ygl::TextureType::RGBA8: {
+			internalFormat = GL_RGBA8;
+			format		   = GL_RGBA;
+			pixelSize	   = 4;
+			components	   = 4;
+			_type		   = GL_UNSIGNED_BYTE;
+			break;
+		}
 		default: {
 			dbLog(ygl::LOG_WARNING, "unknown texture type ", type, ". default texture type will be RGBA32f");
 			internalFormat = GL_RGBA32F;
@@ -192,8 +202,8 @@ void ygl::Texture2d::init(GLsizei width, GLsizei height, GLint internalFormat, G
 	this->internalFormat = internalFormat;
 
 	glGenTextures(1, &id);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, id);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, id);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -204,10 +214,11 @@ void ygl::Texture2d::init(GLsizei width, GLsizei height, GLint internalFormat, G
 	if (data != nullptr) { glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data); }
 
 #ifndef YGL_NO_COMPUTE_SHADERS
-	if (format != GL_STENCIL_INDEX)
+	// depth buffers are read one texel at a time and cannot have mipmaps generated
+	if (format != GL_STENCIL_INDEX && format != GL_DEPTH_STENCIL)
 #endif
 		glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
 }
 
 void ygl::Texture2d::init(GLsizei width, GLsizei height, TextureType type, void *data) {
@@ -326,31 +337,30 @@ void ygl::Texture2d::resize(uint width, uint height) {
 void ygl::Texture2d::save(std::string fileName) {
 	uint8_t *buff = new uint8_t[width * height * pixelSize];
 
-	glBindTexture(GL_TEXTURE_2D, id);
+	bind();
 	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, buff);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	unbind();
 
-	stbi_flip_vertically_on_write(true);
+	// flipped by hand, the flag of stbi_flip_vertically_on_write() is also read by the encoder threads of FrameCapture
+	std::size_t rowSize = 4 * width;
+	for (int y = 0; y < height / 2; ++y) {
+		std::swap_ranges(buff + y * rowSize, buff + (y + 1) * rowSize, buff + (height - 1 - y) * rowSize);
+	}
 
 	stbi_write_png(fileName.c_str(), width, height, 4, buff, 4 * width);
 	delete[] buff;
 }
 #endif
 
-void ygl::Texture2d::bind(int textureUnit) const {
-	glActiveTexture(textureUnit);
-	glBindTexture(GL_TEXTURE_2D, id);
-	glActiveTexture(GL_TEXTURE0);
-}
-
-void ygl::Texture2d::bind() const { bind(GL_TEXTURE0); }
+void ygl::Texture2d::bind(int textureUnit) const { GLState::bindTexture(textureUnit, GL_TEXTURE_2D, id); }
 
-void ygl::Texture2d::unbind(int textureUnit) const {
-	glActiveTexture(textureUnit);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glActiveTexture(GL_TEXTURE0);
+void ygl::Texture2d::bind() const {
+	GLState::activeTexture(GL_TEXTURE0);
+	bind(GL_TEXTURE0);
 }
 
+void ygl::Texture2d::unbind(int textureUnit) const { GLState::bindTexture(textureUnit, GL_TEXTURE_2D, 0); }
+
 void ygl::Texture2d::unbind() const { unbind(GL_TEXTURE0); }
 
 #ifndef YGL_NO_COMPUTE_SHADERS
@@ -362,7 +372,7 @@ void ygl::Texture2d::unbindImage(int unit) {
 }
 #endif
 int ygl::Texture2d::getID() { return id; }
-ygl::Texture2d::~Texture2d() { glDeleteTextures(1, &id); }
+ygl::Texture2d::~Texture2d() { GLState::deleteTexture(id); }
 
 void ygl::Texture3d::init(const glm::ivec3 &dim, GLint internalFormat, GLenum format, uint8_t pixelSize,
 						  uint8_t components, GLenum type, void *data) {
@@ -373,7 +383,8 @@ void ygl::Texture3d::init(const glm::ivec3 &dim, GLint internalFormat, GLenum fo
 	this->dimensions	 = dim;
 
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_3D, id);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_3D, id);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -397,13 +408,54 @@ ygl::Texture3d::Texture3d(const glm::ivec3 &dim, TextureType type, void *data) :
 	init(dim, internalFormat, format, pixelSize, components, _type, data);
 }
 
+ygl::Texture2dArray::Texture2dArray(GLsizei width, GLsizei height, GLsizei layers, TextureType type)
+	: width(width), height(height), layers(layers), type(type) {
+	init();
+}
+
+void ygl::Texture2dArray::init() {
+	GLenum	format	   = 0;
+	uint8_t pixelSize  = 0;
+	uint8_t components = 0;
+	GLenum	_type	   = 0;
+	getTypeParameters(type, internalFormat, format, pixelSize, components, _type);
+
+	glGenTextures(1, &id);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D_ARRAY, id);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internalFormat, width, height, layers);
+
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D_ARRAY, 0);
+}
+
+ygl::Texture2dArray::~Texture2dArray() { GLState::deleteTexture(id); }
+
+void ygl::Texture2dArray::BindToFrameBuffer(const FrameBuffer &fb, GLenum attachment, uint image, uint level) {
+	fb.bind();
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment, id, level, image);
+}
+
+void ygl::Texture2dArray::resize(uint width, uint height) {
+	// storage is immutable, so the texture is created again
+	GLState::deleteTexture(id);
+	this->width	 = width;
+	this->height = height;
+	init();
+}
+
 ygl::TextureCubemap::TextureCubemap(uint32_t width, uint32_t height) : width(width), height(height) {
 	loadEmptyCubemap();
 }
 
 void ygl::TextureCubemap::loadEmptyCubemap() {
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, id);
 
 	for (int i = 0; i < 6; i++) {
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE,
@@ -419,12 +471,13 @@ void ygl::TextureCubemap::loadEmptyCubemap() {
 
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, 0);
 }
 
 void ygl::TextureCubemap::loadCubemap() {
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, id);
 
 	bool success = true;
 	for (int i = 0; i < 6; i++) {
@@ -460,7 +513,7 @@ void ygl::TextureCubemap::loadCubemap() {
 
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, 0);
 }
 
 void ygl::TextureCubemap::init() {
@@ -502,16 +555,15 @@ void ygl::TextureCubemap::save(std::string) {
 	// TODO: implement this
 }
 
-void ygl::TextureCubemap::bind(int textureUnit) const {
-	glActiveTexture(textureUnit);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, id);
-}
+void ygl::TextureCubemap::bind(int textureUnit) const { GLState::bindTexture(textureUnit, GL_TEXTURE_CUBE_MAP, id); }
 
-void ygl::TextureCubemap::bind() const { bind(GL_TEXTURE0); }
+void ygl::TextureCubemap::bind() const {
+	GLState::activeTexture(GL_TEXTURE0);
+	bind(GL_TEXTURE0);
+}
 
 void ygl::TextureCubemap::unbind(int textureUnit) const {
-	glActiveTexture(textureUnit);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLState::bindTexture(textureUnit, GL_TEXTURE_CUBE_MAP, 0);
 }
 
 void ygl::TextureCubemap::unbind() const { unbind(GL_TEXTURE0); }
@@ -527,7 +579,7 @@ void ygl::TextureCubemap::unbindImage(int textureUnit) {
 #endif
 
 int ygl::TextureCubemap::getID() { return id; }
-ygl::TextureCubemap::~TextureCubemap() { glDeleteTextures(1, &id); }
+ygl::TextureCubemap::~TextureCubemap() { GLState::deleteTexture(id); }
 
 const char *ygl::Texture2d::name	  = "ygl::Texture2d";
 const char *ygl::TextureCubemap::name = "ygl::TextureCubemap";
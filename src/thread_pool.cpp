@@ -0,0 +1,62 @@
+#include <thread_pool.h>
+
+ygl::ThreadPool::ThreadPool(std::size_t threadsCount) {
+	for (std::size_t i = 0; i < threadsCount; ++i) {
+		workers.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+ygl::ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
+
+ygl::ThreadPool &ygl::ThreadPool::getDefault() {
+#ifdef __EMSCRIPTEN__
+	static ThreadPool pool(0);
+#else
+	unsigned int	  hardwareThreads = std::thread::hardware_concurrency();
+	static ThreadPool pool(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+#endif
+	return pool;
+}
+
+void ygl::ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (tasks.empty()) return;	   // stopping and nothing left to do
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void ygl::ThreadPool::enqueue(std::function<void()> task) {
+	{
+		std::lock_guard lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+bool ygl::ThreadPool::runPendingTask() {
+	std::function<void()> task;
+	{
+		std::lock_guard lock(mutex);
+		if (tasks.empty()) return false;
+		task = std::move(tasks.front());
+		tasks.pop_front();
+	}
+	task();
+	return true;
+}
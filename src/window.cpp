@@ -1,6 +1,9 @@
 #include <window.h>
 #include <yoghurtgl.h>
 #include <input.h>
+#include <renderer.h>
+#include <texture.h>
+#include <gl_state.h>
 
 #include <iostream>
 #include <iomanip>
@@ -15,16 +18,23 @@
 
 ygl::Window::Window(int width, int height, const char *name, bool vsync, bool resizable, GLFWmonitor *monitor)
 	: width(width), height(height) {
-	assert(glfwGetPrimaryMonitor() != NULL);
+	if (ygl::headless) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		// Mesa only exposes newer versions through core profile contexts
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		monitor = NULL;
+	} else {
+		assert(glfwGetPrimaryMonitor() != NULL);
 
-	const GLFWvidmode *mode = glfwGetVideoMode(monitor ? monitor : glfwGetPrimaryMonitor());
+		const GLFWvidmode *mode = glfwGetVideoMode(monitor ? monitor : glfwGetPrimaryMonitor());
 
-	glfwWindowHint(GLFW_RED_BITS, mode->redBits);
-	glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
-	glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
-	glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
+		glfwWindowHint(GLFW_RED_BITS, mode->redBits);
+		glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
+		glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
+		glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
 
-	glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER, GL_TRUE);
+		glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER, GL_TRUE);
+	}
 #ifndef YGL_NDEBUG
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 #endif
@@ -36,7 +46,19 @@ ygl::Window::Window(int width, int height, const char *name, bool vsync, bool re
 	if (resizable) glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	else glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-	window = glfwCreateWindow(width, height, name, monitor, NULL);
+	if (ygl::headless) {
+#if !defined(__EMSCRIPTEN__) && (GLFW_VERSION_MAJOR > 3 || GLFW_VERSION_MINOR >= 4)
+		// EGL can give a surfaceless context on the GPU or on llvmpipe. OSMesa is the fallback when there is no EGL.
+		for (int api : {GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API}) {
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+			window = glfwCreateWindow(width, height, name, NULL, NULL);
+			if (window) break;
+		}
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+#endif
+	} else {
+		window = glfwCreateWindow(width, height, name, monitor, NULL);
+	}
 	if (!window) {
 		std::cerr << "glfwCreateWindow failed." << std::endl;
 		glfwTerminate();
@@ -53,18 +75,10 @@ ygl::Window::Window(int width, int height, const char *name, bool vsync, bool re
 #ifndef YGL_NDEBUG
 		else if (key == GLFW_KEY_R && action == GLFW_RELEASE) {
 			shade = !shade;
-			if (shade) {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			} else {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			}
+			GLState::polygonMode(shade ? GL_FILL : GL_LINE);
 		} else if (key == GLFW_KEY_F && action == GLFW_RELEASE) {
 			cullFace = !cullFace;
-			if (cullFace) {
-				glEnable(GL_CULL_FACE);
-			} else {
-				glDisable(GL_CULL_FACE);
-			}
+			GLState::setCapability(GL_CULL_FACE, cullFace);
 		}
 #endif
 	});
@@ -80,7 +94,12 @@ ygl::Window::Window(int width, int height, const char *name, bool vsync, bool re
 
 	glfwSwapInterval(vsync);
 #ifndef __EMSCRIPTEN__
-	if (glewInit() != GLEW_OK) {
+	GLenum glewStatus = glewInit();
+	#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW still loads the GL functions when there is no X display, only the GLX ones are missing
+	if (ygl::headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) glewStatus = GLEW_OK;
+	#endif
+	if (glewStatus != GLEW_OK) {
 		std::cerr << "glewInit failed." << std::endl;
 		this->~Window();
 		THROW_RUNTIME_ERR("GLEW_INIT FAILED");
@@ -91,21 +110,25 @@ ygl::Window::Window(int width, int height, const char *name, bool vsync, bool re
 	ygl::initDebug();
 #endif
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_STENCIL_TEST);
+	// a new context starts with the default state, whatever was cached belongs to the previous one
+	GLState::invalidate();
+	GLState::enable(GL_BLEND);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::enable(GL_CULL_FACE);
+	GLState::enable(GL_STENCIL_TEST);
 #ifndef YGL_NO_COMPUTE_SHADERS
-	glEnable(GL_PROGRAM_POINT_SIZE);
-	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	GLState::enable(GL_PROGRAM_POINT_SIZE);
+	GLState::enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 #endif
 
 	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 	glStencilFunc(GL_ALWAYS, 1, 0xFF);
 	glStencilMask(0xFF);
 
-	glDepthFunc(GL_LEQUAL);
+	GLState::depthFunc(GL_LEQUAL);
+
+	if (ygl::headless) createOffscreenFrameBuffer();
 
 #ifndef __EMSCRIPTEN__
 	// Setup Dear ImGui context
@@ -134,6 +157,21 @@ ygl::Window::Window(int width, int height, const char *name, bool vsync) : Windo
 
 ygl::Window::Window(int width, int height, const char *name) : Window(width, height, name, true) {}
 
+void ygl::Window::createOffscreenFrameBuffer() {
+	// stands in for the default framebuffer, so it has the same 8-bit color format
+	offscreenFrameBuffer =
+		new FrameBuffer(new Texture2d(width, height, TextureType::RGBA8, nullptr), GL_COLOR_ATTACHMENT0,
+						new RenderBuffer(width, height, TextureType::DEPTH_STENCIL_32F_8), GL_DEPTH_STENCIL_ATTACHMENT,
+						"Offscreen frameBuffer");
+	FrameBuffer::setDefault(offscreenFrameBuffer);
+	FrameBuffer::bindDefault();
+
+	addResizeCallback([this](GLFWwindow *window, int width, int height) {
+		if (window != getHandle()) return;
+		offscreenFrameBuffer->resize(width, height);
+	});
+}
+
 int ygl::Window::getWidth() { return width; }
 int ygl::Window::getHeight() { return height; }
 
@@ -145,6 +183,12 @@ glm::ivec2 ygl::Window::getPos() {
 
 GLFWwindow *ygl::Window::getHandle() { return window; }
 
+bool ygl::Window::isHeadless() { return offscreenFrameBuffer != nullptr; }
+
+ygl::FrameBuffer *ygl::Window::getOffscreenFrameBuffer() { return offscreenFrameBuffer; }
+
+void ygl::Window::setSize(int width, int height) { glfwSetWindowSize(window, width, height); }
+
 bool ygl::Window::shouldClose() { return glfwWindowShouldClose(window); }
 
 void ygl::Window::setShouldClose(bool b) { glfwSetWindowShouldClose(window, b); }
@@ -201,6 +245,7 @@ void ygl::Window::swapBuffers() {
 void ygl::Window::beginFrame() {
 	glfwPollEvents();
 
+	if (offscreenFrameBuffer != nullptr) offscreenFrameBuffer->bind();
 	glViewport(0, 0, width, height);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
@@ -227,6 +272,11 @@ ygl::Window::~Window() {
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
 #endif
+		if (offscreenFrameBuffer != nullptr) {
+			FrameBuffer::setDefault(nullptr);
+			delete offscreenFrameBuffer;
+			offscreenFrameBuffer = nullptr;
+		}
 
 		glfwDestroyWindow(window);
 		ygl::gl_init = false;
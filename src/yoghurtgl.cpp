@@ -3,10 +3,13 @@
 #include <mesh.h>
 #include <serializable.h>
 #include <assert.h>
+#include <cstdlib>
+#include <cstring>
 
 bool ygl::gl_init		= false;
 bool ygl::glfw_init		= false;
 bool ygl::gl_debug_init = false;
+bool ygl::headless		= false;
 
 
 #ifdef __cplusplus
@@ -25,12 +28,25 @@ int AmdPowerXpressRequestHighPerformance = 1;
 }
 #endif
 
-int ygl::init() {
+int ygl::init(bool headless) {
 	if (ygl::glfw_init) return 0;
 	ygl::glfw_init = true;
 
+	const char *headlessEnv = std::getenv("YGL_HEADLESS");
+	ygl::headless			= headless || (headlessEnv != nullptr && std::strcmp(headlessEnv, "0") != 0);
+
 	glfwSetErrorCallback(ygl::glfwErrorCallback);
 
+	if (ygl::headless) {
+#if !defined(__EMSCRIPTEN__) && (GLFW_VERSION_MAJOR > 3 || GLFW_VERSION_MINOR >= 4)
+		// the null platform does not connect to a display server
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+		std::cerr << "headless mode requires GLFW 3.4 or newer";
+		return 1;
+#endif
+	}
+
 	if (!glfwInit()) {
 		std::cerr << "glfwInit failed.";
 		return 1;
@@ -120,4 +136,5 @@ void ygl::terminate() {
 	ygl::gl_debug_init = false;
 	ygl::gl_init	   = false;
 	ygl::glfw_init	   = false;
+	ygl::headless	   = false;
 }
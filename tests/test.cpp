@@ -2,6 +2,10 @@
 #include <ecs.h>
 #include <renderer.h>
 #include <transformation.h>
+#include <bvh.h>
+#include <render_queue.h>
+#include <shadow_cascades.h>
+#include <profiler.h>
 #include <sstream>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
@@ -49,6 +53,94 @@ TEST_CASE("Test Scene creation") {
 		CHECK_FALSE(scene.hasComponent<ygl::Transformation>(e));
 		CHECK_THROWS(scene.getComponent<ygl::Transformation>(e));
 	}
+
+	SUBCASE("Remove Component") {
+		scene.registerComponent<ygl::Transformation>();
+
+		ygl::Entity entities[4];
+		for (int i = 0; i < 4; ++i) {
+			entities[i] = scene.createEntity();
+			scene.addComponent(entities[i], ygl::Transformation(glm::vec3(i)));
+		}
+
+		// the last component is moved into the freed slot
+		scene.removeComponent<ygl::Transformation>(entities[1]);
+		CHECK_FALSE(scene.hasComponent<ygl::Transformation>(entities[1]));
+		CHECK(scene.getComponent<ygl::Transformation>(entities[0]).position == glm::vec3(0));
+		CHECK(scene.getComponent<ygl::Transformation>(entities[2]).position == glm::vec3(2));
+		CHECK(scene.getComponent<ygl::Transformation>(entities[3]).position == glm::vec3(3));
+
+		scene.addComponent(entities[1], ygl::Transformation(glm::vec3(5)));
+		CHECK(scene.getComponent<ygl::Transformation>(entities[1]).position == glm::vec3(5));
+		CHECK(scene.getComponentArray<ygl::Transformation>()->count() == 4);
+	}
+}
+
+TEST_CASE("Archetype storage") {
+	ygl::Scene scene(ygl::ComponentStorage::ARCHETYPES);
+	scene.registerComponent<ygl::Transformation>();
+	scene.registerComponent<ygl::RendererComponent>();
+
+	ygl::Entity a = scene.createEntity();
+	ygl::Entity b = scene.createEntity();
+	scene.addComponent(a, ygl::Transformation(glm::vec3(1.)));
+	scene.addComponent(b, ygl::Transformation(glm::vec3(2.)));
+	scene.addComponent(b, ygl::RendererComponent(1, 2, 3));
+
+	SUBCASE("Move between archetypes") {
+		scene.addComponent(a, ygl::RendererComponent(4, 5, 6));
+		CHECK(scene.getComponent<ygl::Transformation>(a).position == glm::vec3(1.));
+		CHECK(scene.getComponent<ygl::RendererComponent>(a) == ygl::RendererComponent(4, 5, 6));
+
+		scene.removeComponent<ygl::RendererComponent>(b);
+		CHECK_FALSE(scene.hasComponent<ygl::RendererComponent>(b));
+		CHECK(scene.getComponent<ygl::Transformation>(b).position == glm::vec3(2.));
+	}
+
+	SUBCASE("Iterate") {
+		int count = 0;
+		scene.forEach<ygl::Transformation, ygl::RendererComponent>(
+			[&](ygl::Entity e, ygl::Transformation &t, ygl::RendererComponent &r) {
+				CHECK(e == b);
+				CHECK(t.position == glm::vec3(2.));
+				CHECK(r == ygl::RendererComponent(1, 2, 3));
+				++count;
+			});
+		CHECK(count == 1);
+	}
+
+	SUBCASE("Destroy Entity") {
+		scene.destroyEntity(b);
+		CHECK_FALSE(scene.hasComponent<ygl::Transformation>(b));
+		CHECK(scene.getComponent<ygl::Transformation>(a).position == glm::vec3(1.));
+	}
+}
+
+TEST_CASE("Scene View") {
+	ygl::Scene scene;
+	scene.registerComponent<ygl::Transformation>();
+	scene.registerComponent<ygl::RendererComponent>();
+
+	ygl::Entity a = scene.createEntity();
+	ygl::Entity b = scene.createEntity();
+	scene.addComponent(a, ygl::Transformation(glm::vec3(1.)));
+	scene.addComponent(b, ygl::Transformation(glm::vec3(2.)));
+	scene.addComponent(b, ygl::RendererComponent(1, 2, 3));
+
+	auto view = scene.view<ygl::Transformation>(ygl::exclude<ygl::RendererComponent>);
+	CHECK(view.size() == 1);
+	for (auto [e, t] : view) {
+		CHECK(e == a);
+		t.position = glm::vec3(3.);
+	}
+	CHECK(scene.getComponent<ygl::Transformation>(a).position == glm::vec3(3.));
+
+	// the cached view follows component changes
+	scene.removeComponent<ygl::RendererComponent>(b);
+	CHECK(scene.view<ygl::Transformation>(ygl::exclude<ygl::RendererComponent>).size() == 2);
+	scene.destroyEntity(a);
+	CHECK(scene.view<ygl::Transformation>(ygl::exclude<ygl::RendererComponent>).size() == 1);
+	CHECK((scene.view<ygl::Transformation, ygl::RendererComponent>().size() == 0));
 }
 
 class Translator : public ygl::ISystem {
@@ -100,6 +192,98 @@ TEST_CASE("Scene System") {
 	}
 }
 
+class Scaler : public ygl::ISystem {
+   public:
+	static const char *name;
+
+	using ygl::ISystem::ISystem;
+
+	void init() override {
+		this->scene->setSystemSignature<Scaler, ygl::Transformation>();
+		writes<ygl::Transformation>();
+		runOnWorkerThreads();
+	}
+
+	void doWork() override {
+		for (ygl::Entity e : this->entities) {
+			this->scene->getComponent<ygl::Transformation>(e).scale *= 2.;
+		}
+	}
+
+	void write(std::ostream &) override {}
+	void read(std::istream &) override {}
+};
+const char *Scaler::name = "ygl::Scaler";
+
+class MeshCounter : public ygl::ISystem {
+   public:
+	static const char *name;
+
+	std::size_t count = 0;
+
+	using ygl::ISystem::ISystem;
+
+	void init() override {
+		this->scene->registerComponentIfCan<ygl::RendererComponent>();
+		this->scene->setSystemSignature<MeshCounter, ygl::RendererComponent>();
+		reads<ygl::RendererComponent>();
+		runOnWorkerThreads();
+	}
+
+	void doWork() override { count += this->entities.size(); }
+
+	void write(std::ostream &) override {}
+	void read(std::istream &) override {}
+};
+const char *MeshCounter::name = "ygl::MeshCounter";
+
+class CountReader : public ygl::ISystem {
+   public:
+	static const char *name;
+
+	std::size_t count = 0;
+
+	using ygl::ISystem::ISystem;
+
+	void init() override {
+		reads<MeshCounter>();
+		runOnWorkerThreads();
+	}
+
+	void doWork() override { count = this->scene->getSystem<MeshCounter>()->count; }
+
+	void write(std::ostream &) override {}
+	void read(std::istream &) override {}
+};
+const char *CountReader::name = "ygl::CountReader";
+
+TEST_CASE("Parallel Systems") {
+	ygl::Scene scene;
+	scene.registerComponent<ygl::Transformation>();
+	scene.registerSystem<Scaler>();
+	scene.registerSystem<MeshCounter>();
+	scene.registerSystem<CountReader>();
+	scene.registerSystem<Translator>();		// undeclared access, runs after the others
+
+	ygl::Entity e = scene.createEntity();
+	scene.addComponent(e, ygl::Transformation());
+	scene.addComponent(e, ygl::RendererComponent());
+
+	CHECK_FALSE(scene.getSystem<Scaler>()->conflictsWith(scene.getSystem<MeshCounter>()));
+	CHECK(scene.getSystem<Scaler>()->conflictsWith(scene.getSystem<Translator>()));
+	CHECK(scene.getSystem<CountReader>()->conflictsWith(scene.getSystem<MeshCounter>()));
+	CHECK_FALSE(scene.getSystem<CountReader>()->conflictsWith(scene.getSystem<Scaler>()));
+
+	for (int i = 0; i < 3; ++i) {
+		scene.doWork();
+	}
+	ygl::Transformation &t = scene.getComponent<ygl::Transformation>(e);
+	CHECK(t.scale == glm::vec3(8.));
+	CHECK(t.position == glm::vec3(3.));
+	CHECK(scene.getSystem<MeshCounter>()->count == 3);
+	CHECK(scene.getSystem<CountReader>()->count == 3);
+}
+
 TEST_CASE("Serialization") {
 	SUBCASE("Basic Serializable") {
 		ygl::Transformation t(glm::vec3(2.));
@@ -151,3 +335,299 @@ TEST_CASE("Serialization") {
 		CHECK(other.getSystem<Translator>()->dummyData == 42);
 	}
 }
+
+TEST_CASE("BVH traversal") {
+	using namespace ygl::bvh;
+	BVHTree tree;
+	tree.setUploadToGPU(false);
+
+	// a grid of triangles facing -z at z = 1 + x, a sphere and a box in front of them
+	std::vector<Intersectable *> primitives;
+	for (int x = 0; x < 10; ++x) {
+		for (int y = 0; y < 10; ++y) {
+			glm::vec3 a(x, y, 1 + x);
+			primitives.push_back(new Triangle(0, 1, 2, a, a + glm::vec3(1, 0, 0), a + glm::vec3(0, 1, 0), 0));
+		}
+	}
+	primitives.push_back(new SpherePrimitive(glm::vec3(2.5, 2.5, 0), 0.5, 0));
+	primitives.push_back(new BoxPrimitive(glm::vec3(6, 6, -1), glm::vec3(7, 7, 0), 0));
+	for (Intersectable *p : primitives) {
+		tree.addPrimitive(p);
+	}
+	tree.build();
+	CHECK(tree.getSAHCost() > 0);
+
+	Intersection hit;
+	SUBCASE("Closest hit") {
+		CHECK(tree.intersect(Ray(glm::vec3(3.2, 4.2, -5), glm::vec3(0, 0, 1)), hit));
+		CHECK(hit.t == doctest::Approx(9));
+		CHECK(hit.primitive == primitives[34]);
+
+		CHECK(tree.intersect(Ray(glm::vec3(2.5, 2.5, -5), glm::vec3(0, 0, 1)), hit));
+		CHECK(hit.t == doctest::Approx(4.5));
+		CHECK(hit.primitive == primitives[100]);
+
+		CHECK(tree.intersect(Ray(glm::vec3(6.5, 6.5, -5), glm::vec3(0, 0, 1)), hit));
+		CHECK(hit.t == doctest::Approx(4));
+		CHECK(hit.normal == glm::vec3(0, 0, -1));
+	}
+
+	SUBCASE("Miss") {
+		CHECK_FALSE(tree.intersect(Ray(glm::vec3(-1, -1, -5), glm::vec3(0, 0, 1)), hit));
+		CHECK_FALSE(tree.intersect(Ray(glm::vec3(3.2, 4.2, -5), glm::vec3(0, 0, -1)), hit));
+	}
+
+	SUBCASE("Occlusion") {
+		CHECK(tree.occluded(Ray(glm::vec3(3.2, 4.2, -5), glm::vec3(0, 0, 1))));
+		CHECK_FALSE(tree.occluded(Ray(glm::vec3(3.2, 4.2, -5), glm::vec3(0, 0, 1)), 0, 8));
+	}
+}
+
+TEST_CASE("Render queue") {
+	using ygl::RenderQueue;
+	RenderQueue queue;
+
+	// shader, material, mesh and depth of each draw in the order they are added
+	ygl::Transformation transforms[6];
+	uint				draws[][3] = {{2, 0, 1}, {1, 3, 0}, {1, 3, 0}, {1, 0, 5}, {2, 0, 0}, {1, 3, 0}};
+	float				depths[]   = {1, 20, 5, 3, 300, 5};
+	for (uint i = 0; i < 6; ++i) {
+		RenderQueue::Draw draw = {&transforms[i], draws[i][0], draws[i][1], draws[i][2], false};
+		queue.add(RenderQueue::makeKey(RenderQueue::COLOR_PASS, draw.shader, draw.material, draw.mesh, depths[i]),
+				  draw);
+		queue.add(RenderQueue::makeKey(RenderQueue::SHADOW_PASS, draw.shader, 0, draw.mesh, depths[i]), draw);
+	}
+	queue.sort();
+	REQUIRE(queue.size() == 12);
+
+	for (std::size_t i = 1; i < queue.size(); ++i) {
+		CHECK(queue.getKey(i - 1) <= queue.getKey(i));
+	}
+
+	SUBCASE("Pass ranges") {
+		CHECK(queue.getPassRange(RenderQueue::SHADOW_PASS) == std::pair<std::size_t, std::size_t>(0, 6));
+		CHECK(queue.getPassRange(RenderQueue::COLOR_PASS) == std::pair<std::size_t, std::size_t>(6, 12));
+		CHECK(queue.getPassRange(5) == std::pair<std::size_t, std::size_t>(12, 12));
+	}
+
+	SUBCASE("Order within a pass") {
+		uint expected[][3] = {{1, 0, 5}, {1, 3, 0}, {1, 3, 0}, {1, 3, 0}, {2, 0, 0}, {2, 0, 1}};
+		for (uint i = 0; i < 6; ++i) {
+			const RenderQueue::Draw &draw = queue[6 + i];
+			CHECK(draw.shader == expected[i][0]);
+			CHECK(draw.material == expected[i][1]);
+			CHECK(draw.mesh == expected[i][2]);
+		}
+		// draws with the same state are sorted front to back and equal keys keep their order
+		CHECK(queue[7].transform == &transforms[2]);
+		CHECK(queue[8].transform == &transforms[5]);
+		CHECK(queue[9].transform == &transforms[1]);
+	}
+}
+
+TEST_CASE("Ring buffer ranges") {
+	using ygl::RingBuffer;
+	// a region alignment of 256 bytes, common for uniform buffers
+	const GLsizeiptr regionAlignment = 256;
+
+	SUBCASE("Region sizes") {
+		CHECK(RingBuffer::alignSize(3 * 64, regionAlignment) == 256);
+		CHECK(RingBuffer::alignSize(512, regionAlignment) == 512);
+		CHECK(RingBuffer::alignSize(513, regionAlignment) == 768);
+	}
+
+	SUBCASE("Every range is aligned") {
+		// the camera matrices and a mix of uniform and storage data, in all regions of the buffer
+		GLsizeiptr regionSizes[] = {RingBuffer::alignSize(3 * 64, regionAlignment),
+									RingBuffer::alignSize(1000, regionAlignment)};
+		GLsizeiptr sizes[]		 = {192, 4, 100, 36, 16};
+		GLsizeiptr alignments[]	 = {256, 16, 64, 256, 32};
+		for (GLsizeiptr regionSize : regionSizes) {
+			for (uint region = 0; region < 8; ++region) {
+				GLsizeiptr head = 0;
+				for (int i = 0; i < 5; ++i) {
+					GLintptr offset = RingBuffer::place(region, regionSize, head, sizes[i], alignments[i]);
+					if (offset < 0) break;
+					CHECK(offset % alignments[i] == 0);
+					CHECK(offset + sizes[i] <= (GLintptr)((region + 1) * regionSize));
+				}
+			}
+		}
+	}
+
+	SUBCASE("Full region") {
+		GLsizeiptr head = 0;
+		CHECK(RingBuffer::place(2, 256, head, 200, 16) == 512);
+		CHECK(RingBuffer::place(2, 256, head, 100, 16) == -1);
+		CHECK(head == 200);
+	}
+}
+
+TEST_CASE("Frustum culling") {
+	// the identity view-projection leaves the clip space cube as the frustum
+	ygl::Frustum frustum(glm::mat4(1));
+
+	glm::vec4 spheres[] = {glm::vec4(0, 0, 0, 0.5),	 glm::vec4(3, 0, 0, 1),	  glm::vec4(1.5, 0, 0, 1),
+						   glm::vec4(0, 0, -5, 1),	 glm::vec4(0, 2.5, 0, 1), glm::vec4(-1.9, 1.9, 0, 1),
+						   glm::vec4(0, 0, 1.5, 0.4)};
+	bool	  expected[] = {true, false, true, false, false, true, false};
+
+	uint8_t visible[7];
+	frustum.cullSpheres(spheres, 7, visible);
+	for (uint i = 0; i < 7; ++i) {
+		CHECK(frustum.intersectsSphere(spheres[i]) == expected[i]);
+		CHECK((bool)visible[i] == expected[i]);
+	}
+
+	CHECK(frustum.intersectsBox(glm::vec3(-0.5), glm::vec3(0.5)));
+	CHECK(frustum.intersectsBox(glm::vec3(0.5), glm::vec3(3)));
+	CHECK_FALSE(frustum.intersectsBox(glm::vec3(2), glm::vec3(3)));
+
+	SUBCASE("Scaled projection") {
+		glm::mat4 projection(1);
+		projection[0][0] = 0.1;
+		frustum			 = ygl::Frustum(projection);
+		CHECK(frustum.intersectsSphere(glm::vec4(5, 0, 0, 1)));
+		CHECK_FALSE(frustum.intersectsSphere(glm::vec4(12, 0, 0, 1)));
+	}
+
+	SUBCASE("Culling spheres") {
+		// the unit cube of the skybox at the origin, with the frustum far away from it
+		glm::vec4 cube	= glm::vec4(0, 0, 0, std::sqrt(3.f) / 2);
+		glm::mat4 world = glm::scale(glm::translate(glm::mat4(1), glm::vec3(1, 2, 3)), glm::vec3(2));
+		glm::vec4 moved = ygl::Renderer::getCullingSphere(cube, GL_LESS, false, world);
+		CHECK(moved.x == doctest::Approx(1));
+		CHECK(moved.y == doctest::Approx(2));
+		CHECK(moved.z == doctest::Approx(3));
+		CHECK(moved.w == doctest::Approx(std::sqrt(3.f)));
+
+		frustum = ygl::Frustum(glm::translate(glm::mat4(1), glm::vec3(100, 0, 0)));
+
+		glm::vec4 spheres[] = {ygl::Renderer::getCullingSphere(cube, GL_LESS, false, glm::mat4(1)),
+							   ygl::Renderer::getCullingSphere(cube, GL_LEQUAL, false, glm::mat4(1)),
+							   ygl::Renderer::getCullingSphere(cube, GL_LESS, true, glm::mat4(1))};
+		uint8_t	  visible[3];
+		frustum.cullSpheres(spheres, 3, visible);
+		CHECK_FALSE(visible[0]);
+		CHECK(visible[1]);
+		CHECK(visible[2]);
+	}
+}
+
+TEST_CASE("Shadow cascades") {
+	// the camera looks along -z from the origin and the light shines down along -y
+	glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 1000.f);
+	glm::mat4 light		 = glm::rotate(glm::mat4(1), glm::radians(-90.f), glm::vec3(1, 0, 0));
+
+	ygl::ShadowCascades cascades(3, 1024);
+	cascades.fit(projection, glm::mat4(1), light, 100);
+	for (uint i = 0; i < 3; ++i) {
+		cascades.cull(i, nullptr, 0, nullptr);
+	}
+	ygl::ShadowCascades::Uniforms uniforms = cascades.getUniforms();
+	REQUIRE(uniforms.count == 3);
+
+	SUBCASE("Splits") {
+		CHECK(uniforms.splits[0] > 0.1f);
+		CHECK(uniforms.splits[0] < uniforms.splits[1]);
+		CHECK(uniforms.splits[1] < uniforms.splits[2]);
+		CHECK(uniforms.splits[2] == doctest::Approx(100));
+	}
+
+	SUBCASE("Each cascade covers its slice") {
+		float sliceNear = 0.1;
+		for (uint i = 0; i < 3; ++i) {
+			for (float t : {0.f, 0.5f, 1.f}) {
+				// a corner of the view frustum at a depth in the slice
+				glm::vec4 point	 = glm::inverse(projection) * glm::vec4(1, 1, 0, 1);
+				glm::vec3 corner = glm::vec3(point) / point.w;
+				corner *= glm::mix(sliceNear, uniforms.splits[i], t) / -corner.z;
+				glm::vec4 clip = uniforms.matrices[i] * glm::vec4(corner, 1);
+				CHECK(std::abs(clip.x) <= 1);
+				CHECK(std::abs(clip.y) <= 1);
+				CHECK(std::abs(clip.z) <= 1);
+			}
+			sliceNear = uniforms.splits[i];
+		}
+	}
+
+	SUBCASE("Bounds do not change when the camera turns") {
+		glm::vec2 sizes[3];
+		for (uint i = 0; i < 3; ++i) {
+			sizes[i] = cascades[i].max - cascades[i].min;
+		}
+		cascades.fit(projection, glm::rotate(glm::mat4(1), 0.7f, glm::vec3(0, 1, 0)), light, 100);
+		for (uint i = 0; i < 3; ++i) {
+			glm::vec2 size = cascades[i].max - cascades[i].min;
+			CHECK(size.x == doctest::Approx(sizes[i].x));
+			CHECK(size.y == doctest::Approx(sizes[i].y));
+		}
+	}
+
+	SUBCASE("Casters") {
+		// above the first slice, far to the side, under the ground and an animated mesh without bounds
+		glm::vec4 spheres[] = {glm::vec4(0, 50, -2, 1), glm::vec4(500, 0, -2, 1), glm::vec4(0, -500, -2, 1),
+							   glm::vec4(0, 0, 0, INFINITY)};
+		uint8_t	  casters[4];
+		float	  receiversNear = cascades[0].receiversDepth[0];
+		cascades.cull(0, spheres, 4, casters);
+		CHECK(casters[0]);
+		CHECK_FALSE(casters[1]);
+		CHECK_FALSE(casters[2]);
+		CHECK(casters[3]);
+		// the cascade reaches up to the caster above it
+		CHECK(cascades[0].castersDepth == doctest::Approx(-51));
+		CHECK(cascades[0].castersDepth < receiversNear);
+	}
+}
+
+TEST_CASE("Profiler") {
+	// without GPU timers a frame is collected as soon as it ends
+	ygl::Profiler profiler(false, 2);
+	for (int frame = 0; frame < 3; ++frame) {
+		ygl::Profiler::Scope scope(profiler, "frame");
+		for (int i = 0; i < 2; ++i) {
+			ygl::Profiler::Scope inner(profiler, "inner");
+		}
+	}
+	// the scopes have ended before the frame does
+	profiler.endFrame();
+
+	SUBCASE("Statistics") {
+		REQUIRE(profiler.getStats().size() == 2);
+		CHECK(profiler.getStats()[0].name == "frame");
+		CHECK(profiler.getStats("unknown") == nullptr);
+
+		const ygl::Profiler::Stats *inner = profiler.getStats("inner");
+		REQUIRE(inner != nullptr);
+		CHECK(inner->depth == 1);
+		// all scopes were in one frame, the ones with the same name are added together
+		CHECK(inner->count == 1);
+		CHECK(profiler.getStats("frame")->count == 1);
+		CHECK(inner->getCpuMax() >= inner->getCpuAverage());
+		CHECK(inner->getGpuAverage() == 0);
+
+		for (int frame = 0; frame < 5; ++frame) {
+			profiler.begin("inner");
+			profiler.end();
+			profiler.endFrame();
+		}
+		CHECK(inner->count == 6);
+	}
+
+	SUBCASE("Trace") {
+		profiler.startTrace();
+		profiler.begin("say \"hi\"");
+		profiler.end();
+		profiler.endFrame();
+		profiler.stopTrace();
+
+		std::stringstream out;
+		profiler.writeTrace(out);
+		std::string trace = out.str();
+		CHECK(trace.find("\"name\":\"say \\\"hi\\\"\",\"ph\":\"X\",\"pid\":1,\"tid\":1") != std::string::npos);
+		// no GPU events without GPU timers and nothing from before the trace started
+		CHECK(trace.find("\"tid\":2,\"ts\"") == std::string::npos);
+		CHECK(trace.find("\"frame\"") == std::string::npos);
+	}
+}